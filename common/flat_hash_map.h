@@ -0,0 +1,429 @@
+/**
+ * @file
+ *
+ * Open-addressing hash map and multimap with flat storage.
+ *
+ * Unlike std::unordered_map, which allocates a node per element, these keep
+ * all entries in a single power-of-two array probed linearly, with a parallel
+ * array of one-byte control words holding a fingerprint of each hash. Lookups
+ * therefore touch one or two cache lines in the common case, and reserving for
+ * a known element count performs a single allocation.
+ *
+ * Keys and mapped values must be default constructible and copyable. Any
+ * insertion may rehash, which invalidates iterators and references.
+ */
+
+#ifndef UTS_COMMON_FLAT_HASH_MAP_H
+#define UTS_COMMON_FLAT_HASH_MAP_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include "debug_vector.h"
+
+namespace uts
+{
+
+/**
+ * Default hash for the flat containers. The standard library hashes integers
+ * by the identity, which clusters badly under linear probing into a
+ * power-of-two table, so integer keys are specialised to a cheap bit mixer.
+ */
+template<typename Key, typename Enable = void>
+struct flat_hash
+{
+    std::size_t operator()(const Key &key) const
+    {
+        return std::hash<Key>()(key);
+    }
+};
+
+/// Integer keys are mixed with the 64-bit finaliser of MurmurHash3
+template<typename Key>
+struct flat_hash<Key, typename std::enable_if<std::is_integral<Key>::value>::type>
+{
+    std::size_t operator()(Key key) const
+    {
+        std::uint64_t x = static_cast<std::uint64_t>(key);
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+        return static_cast<std::size_t>(x);
+    }
+};
+
+namespace detail
+{
+
+/**
+ * Linear probing table shared by @ref flat_hash_map and @ref flat_hash_multimap.
+ * With @a Multi set, insertion never looks for an existing equal key.
+ */
+template<typename Key, typename T, typename Hash, typename KeyEqual, bool Multi>
+class flat_hash_table
+{
+public:
+    typedef Key key_type;
+    typedef T mapped_type;
+    typedef std::pair<Key, T> value_type;
+    typedef std::size_t size_type;
+
+private:
+    enum { EMPTY = 0, FULL = 0x80 };   ///< control byte is 0 or 0x80 plus a 7-bit fingerprint of the top hash bits
+
+    uts::vector<std::uint8_t> ctrl;    ///< control byte per slot
+    uts::vector<value_type> slots;     ///< entries, valid where the control byte is not EMPTY
+    size_type count;                   ///< number of entries
+    size_type mask;                    ///< slot count minus one, or 0 when unallocated
+    Hash hasher;
+    KeyEqual equal;
+
+    /// The slot index comes from the low bits of the hash, so the fingerprint is taken from the top seven
+    static std::uint8_t fingerprint(std::size_t h)
+    {
+        return static_cast<std::uint8_t>(FULL | (static_cast<std::uint64_t>(h) >> 57));
+    }
+
+    /// Slot count needed to hold @a n entries within the maximum load factor of 3/4
+    static size_type capacityFor(size_type n)
+    {
+        size_type cap = 16;
+        while (cap - cap / 4 < n)
+            cap *= 2;
+        return cap;
+    }
+
+    /// Re-insert every entry into a table of @a cap slots
+    void rehash(size_type cap)
+    {
+        uts::vector<std::uint8_t> oldctrl(cap, static_cast<std::uint8_t>(EMPTY));
+        uts::vector<value_type> oldslots(cap);
+        oldctrl.swap(ctrl);
+        oldslots.swap(slots);
+        mask = cap - 1;
+        for (size_type i = 0; i < oldctrl.size(); i++)
+            if (oldctrl[i] != EMPTY)
+            {
+                size_type s = hasher(oldslots[i].first) & mask;
+                while (ctrl[s] != EMPTY)
+                    s = (s + 1) & mask;
+                ctrl[s] = oldctrl[i];
+                slots[s] = std::move(oldslots[i]);
+            }
+    }
+
+    /// Slot holding @a key, or the size of the table if absent
+    size_type findSlot(const Key &key) const
+    {
+        if (count == 0)
+            return slots.size();
+        std::size_t h = hasher(key);
+        std::uint8_t fp = fingerprint(h);
+        for (size_type s = h & mask; ctrl[s] != EMPTY; s = (s + 1) & mask)
+            if (ctrl[s] == fp && equal(slots[s].first, key))
+                return s;
+        return slots.size();
+    }
+
+public:
+    /// Forward iterator over occupied slots
+    template<typename V, typename Table>
+    class basic_iterator
+    {
+    private:
+        Table *table;
+        size_type pos;
+
+        void skip()
+        {
+            while (pos < table->slots.size() && table->ctrl[pos] == EMPTY)
+                pos++;
+        }
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef V value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef V *pointer;
+        typedef V &reference;
+
+        basic_iterator() : table(nullptr), pos(0) {}
+        basic_iterator(Table *table, size_type pos, bool skipEmpty = true) : table(table), pos(pos)
+        {
+            if (skipEmpty)
+                skip();
+        }
+
+        /// Allow conversion from a mutable to a const iterator
+        template<typename V2, typename Table2>
+        basic_iterator(const basic_iterator<V2, Table2> &other) : table(other.table), pos(other.pos) {}
+
+        reference operator*() const { return table->slots[pos]; }
+        pointer operator->() const { return &table->slots[pos]; }
+        basic_iterator &operator++() { pos++; skip(); return *this; }
+        basic_iterator operator++(int) { basic_iterator old = *this; ++*this; return old; }
+        bool operator==(const basic_iterator &other) const { return pos == other.pos; }
+        bool operator!=(const basic_iterator &other) const { return pos != other.pos; }
+
+        template<typename, typename> friend class basic_iterator;
+        friend class flat_hash_table;
+    };
+
+    /**
+     * Iterator over the entries with one particular key, following the probe
+     * sequence from the home slot of the key to the next empty slot.
+     */
+    template<typename V, typename Table>
+    class basic_key_iterator
+    {
+    private:
+        Table *table;
+        size_type pos;      ///< current slot, or the table size at the end
+        std::uint8_t fp;    ///< fingerprint of the key
+
+        /// Advance until an entry with @a key, or the end of the probe sequence
+        void seek(const Key &key)
+        {
+            while (table->ctrl[pos] != EMPTY)
+            {
+                if (table->ctrl[pos] == fp && table->equal(table->slots[pos].first, key))
+                    return;
+                pos = (pos + 1) & table->mask;
+            }
+            pos = table->slots.size();
+        }
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef V value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef V *pointer;
+        typedef V &reference;
+
+        basic_key_iterator() : table(nullptr), pos(0), fp(0) {}
+
+        basic_key_iterator(Table *table, size_type pos) : table(table), pos(pos), fp(0) {}
+
+        basic_key_iterator(Table *table, const Key &key) : table(table), pos(table->slots.size()), fp(0)
+        {
+            if (table->count != 0)
+            {
+                std::size_t h = table->hasher(key);
+                fp = fingerprint(h);
+                pos = h & table->mask;
+                seek(key);
+            }
+        }
+
+        reference operator*() const { return table->slots[pos]; }
+        pointer operator->() const { return &table->slots[pos]; }
+
+        basic_key_iterator &operator++()
+        {
+            Key key = table->slots[pos].first;
+            pos = (pos + 1) & table->mask;
+            seek(key);
+            return *this;
+        }
+
+        basic_key_iterator operator++(int) { basic_key_iterator old = *this; ++*this; return old; }
+        bool operator==(const basic_key_iterator &other) const { return pos == other.pos; }
+        bool operator!=(const basic_key_iterator &other) const { return pos != other.pos; }
+    };
+
+    typedef basic_iterator<value_type, flat_hash_table> iterator;
+    typedef basic_iterator<const value_type, const flat_hash_table> const_iterator;
+    typedef basic_key_iterator<value_type, flat_hash_table> key_iterator;
+    typedef basic_key_iterator<const value_type, const flat_hash_table> const_key_iterator;
+
+    explicit flat_hash_table(size_type n = 0, const Hash &hash = Hash(), const KeyEqual &eq = KeyEqual())
+        : count(0), mask(0), hasher(hash), equal(eq)
+    {
+        if (n > 0)
+            reserve(n);
+    }
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, slots.size(), false); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, slots.size(), false); }
+
+    size_type size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    /// Number of slots, including empty ones
+    size_type bucket_count() const { return slots.size(); }
+
+    /// Remove all entries but keep the allocated slots
+    void clear()
+    {
+        std::fill(ctrl.begin(), ctrl.end(), static_cast<std::uint8_t>(EMPTY));
+        count = 0;
+    }
+
+    /// Make room for at least @a n entries without further rehashing
+    void reserve(size_type n)
+    {
+        size_type cap = capacityFor(n);
+        if (cap > slots.size())
+            rehash(cap);
+    }
+
+    /**
+     * Insert an entry. For the map, nothing is inserted if the key is already present.
+     * @retval first   iterator to the inserted entry, or to the existing one with the same key
+     * @retval second  whether an entry was inserted
+     */
+    std::pair<iterator, bool> emplace(const Key &key, const T &value)
+    {
+        if (count + 1 > slots.size() - slots.size() / 4)
+            rehash(capacityFor(count + 1));
+
+        std::size_t h = hasher(key);
+        std::uint8_t fp = fingerprint(h);
+        size_type s = h & mask;
+        while (ctrl[s] != EMPTY)
+        {
+            if (!Multi && ctrl[s] == fp && equal(slots[s].first, key))
+                return std::make_pair(iterator(this, s, false), false);
+            s = (s + 1) & mask;
+        }
+        ctrl[s] = fp;
+        slots[s].first = key;
+        slots[s].second = value;
+        count++;
+        return std::make_pair(iterator(this, s, false), true);
+    }
+
+    std::pair<iterator, bool> insert(const value_type &value) { return emplace(value.first, value.second); }
+
+    iterator find(const Key &key) { return iterator(this, findSlot(key), false); }
+    const_iterator find(const Key &key) const { return const_iterator(this, findSlot(key), false); }
+
+    /// Number of entries with @a key
+    size_type count_key(const Key &key) const
+    {
+        size_type n = 0;
+        for (const_key_iterator it(this, key), e(this, slots.size()); it != e; ++it)
+            n++;
+        return n;
+    }
+
+    /// Range over all entries with @a key, in probe order
+    std::pair<key_iterator, key_iterator> equal_range(const Key &key)
+    {
+        return std::make_pair(key_iterator(this, key), key_iterator(this, slots.size()));
+    }
+
+    std::pair<const_key_iterator, const_key_iterator> equal_range(const Key &key) const
+    {
+        return std::make_pair(const_key_iterator(this, key), const_key_iterator(this, slots.size()));
+    }
+
+    /**
+     * Remove the entry at @a it, shifting later entries of the probe sequence
+     * back so that no tombstones are needed. Because entries move, all
+     * iterators are invalidated.
+     */
+    void erase(iterator it)
+    {
+        size_type hole = it.pos, s = hole;
+        for (;;)
+        {
+            s = (s + 1) & mask;
+            if (ctrl[s] == EMPTY)
+                break;
+            // an entry may fill the hole only if its home slot does not lie cyclically in (hole, s]
+            size_type home = hasher(slots[s].first) & mask;
+            if (((s - home) & mask) >= ((s - hole) & mask))
+            {
+                ctrl[hole] = ctrl[s];
+                slots[hole] = std::move(slots[s]);
+                hole = s;
+            }
+        }
+        ctrl[hole] = EMPTY;
+        count--;
+    }
+
+    /// Remove every entry with @a key
+    size_type erase(const Key &key)
+    {
+        size_type n = 0, s;
+        while ((s = findSlot(key)) != slots.size())
+        {
+            erase(iterator(this, s, false));
+            n++;
+        }
+        return n;
+    }
+};
+
+} // namespace detail
+
+/**
+ * Open-addressing replacement for std::unordered_map. Iteration yields
+ * std::pair<Key, T> entries whose key must not be modified.
+ */
+template<
+    typename Key,
+    typename T,
+    typename Hash = flat_hash<Key>,
+    typename KeyEqual = std::equal_to<Key> >
+class flat_hash_map : public detail::flat_hash_table<Key, T, Hash, KeyEqual, false>
+{
+private:
+    typedef detail::flat_hash_table<Key, T, Hash, KeyEqual, false> base;
+
+public:
+    explicit flat_hash_map(typename base::size_type n = 0, const Hash &hash = Hash(), const KeyEqual &eq = KeyEqual())
+        : base(n, hash, eq) {}
+
+    /// Number of entries with @a key, 0 or 1
+    typename base::size_type count(const Key &key) const
+    {
+        return this->find(key) != this->end() ? 1 : 0;
+    }
+
+    /// Mapped value for @a key, default constructed and inserted if absent
+    T &operator[](const Key &key)
+    {
+        return this->emplace(key, T()).first->second;
+    }
+};
+
+/**
+ * Open-addressing replacement for std::unordered_multimap. Entries with equal
+ * keys are reached through @ref equal_range, which follows the probe sequence
+ * of the key rather than a contiguous range of the table.
+ */
+template<
+    typename Key,
+    typename T,
+    typename Hash = flat_hash<Key>,
+    typename KeyEqual = std::equal_to<Key> >
+class flat_hash_multimap : public detail::flat_hash_table<Key, T, Hash, KeyEqual, true>
+{
+private:
+    typedef detail::flat_hash_table<Key, T, Hash, KeyEqual, true> base;
+
+public:
+    explicit flat_hash_multimap(typename base::size_type n = 0, const Hash &hash = Hash(), const KeyEqual &eq = KeyEqual())
+        : base(n, hash, eq) {}
+
+    /// Number of entries with @a key
+    typename base::size_type count(const Key &key) const
+    {
+        return this->count_key(key);
+    }
+};
+
+} // namespace uts
+
+#endif /* !UTS_COMMON_FLAT_HASH_MAP_H */
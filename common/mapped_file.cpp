@@ -0,0 +1,60 @@
+/**
+ * @file
+ *
+ * Memory mapping of whole files.
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "mapped_file.h"
+
+MappedFile::MappedFile()
+    : fd(-1), base(nullptr), length(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const uts::string &filename)
+{
+    struct stat results;
+
+    close();
+    fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    // only regular files have a meaningful size to map
+    if (fstat(fd, &results) != 0 || !S_ISREG(results.st_mode) || results.st_size <= 0)
+    {
+        close();
+        return false;
+    }
+
+    length = results.st_size;
+    base = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (base == MAP_FAILED)
+    {
+        base = nullptr;
+        close();
+        return false;
+    }
+    madvise(base, length, MADV_SEQUENTIAL);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (base != nullptr)
+        munmap(base, length);
+    if (fd >= 0)
+        ::close(fd);
+    fd = -1;
+    base = nullptr;
+    length = 0;
+}
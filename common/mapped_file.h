@@ -0,0 +1,57 @@
+/**
+ * @file
+ *
+ * Memory mapping of whole files.
+ */
+
+#ifndef UTS_COMMON_MAPPED_FILE_H
+#define UTS_COMMON_MAPPED_FILE_H
+
+#include <cstddef>
+#include "debug_string.h"
+
+/**
+ * RAII wrapper around a read-only memory mapping of an entire regular file.
+ * Only regular files can be mapped; pipes, sockets and terminals are rejected
+ * by @ref open so that the caller can fall back to stream I/O.
+ */
+class MappedFile
+{
+private:
+    int fd;                 ///< file descriptor backing the mapping, or -1
+    void *base;             ///< start of the mapping, or @c nullptr
+    std::size_t length;     ///< number of mapped bytes
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+public:
+    /// Construct without a mapping
+    MappedFile();
+
+    /// Unmaps the file if it is open
+    ~MappedFile();
+
+    /**
+     * Map a file into memory for reading, replacing any existing mapping.
+     * The mapping is advised for sequential access.
+     * @param filename  name of the file to map
+     * @retval true  if the file is a regular file that was mapped successfully,
+     * @retval false otherwise (including for empty files).
+     */
+    bool open(const uts::string &filename);
+
+    /// Release the mapping and the file descriptor
+    void close();
+
+    /// Whether a file is currently mapped
+    bool isOpen() const { return base != nullptr; }
+
+    /// Start of the mapped bytes
+    const char *data() const { return static_cast<const char *>(base); }
+
+    /// Number of mapped bytes
+    std::size_t size() const { return length; }
+};
+
+#endif /* !UTS_COMMON_MAPPED_FILE_H */
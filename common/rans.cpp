@@ -0,0 +1,245 @@
+/**
+ * @file
+ *
+ * Order-0 byte-wise rANS entropy coding.
+ *
+ * Stream layout: raw length (8 bytes), coded length (8 bytes), 256 16-bit symbol frequencies
+ * summing to 2<sup>probBits</sup>, then the coded bytes. Two interleaved coder states are used
+ * so that decoding has two independent dependency chains.
+ */
+
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include "rans.h"
+
+namespace
+{
+
+const int probBits = 12;                    ///< precision of the scaled frequencies
+const std::uint32_t probScale = 1u << probBits;
+const std::uint32_t ransLow = 1u << 23;     ///< lower bound of the normalised coder state
+const std::size_t headerSize = 8 + 8 + 256 * 2;
+
+/// Scale symbol counts to frequencies summing to @ref probScale, keeping every present symbol representable
+void normaliseFreqs(const std::uint64_t counts[256], std::uint64_t total, std::uint32_t freqs[256])
+{
+    std::uint32_t sum = 0;
+    for (int s = 0; s < 256; s++)
+    {
+        freqs[s] = 0;
+        if (counts[s] > 0)
+            freqs[s] = std::max<std::uint32_t>(1, (std::uint32_t) (counts[s] * probScale / total));
+        sum += freqs[s];
+    }
+
+    // fix rounding by adjusting the most frequent symbols, which costs least in coding efficiency
+    while (sum != probScale)
+    {
+        int best = std::max_element(freqs, freqs + 256) - freqs;
+        if (sum > probScale)
+        {
+            freqs[best]--;
+            sum--;
+        }
+        else
+        {
+            freqs[best]++;
+            sum++;
+        }
+    }
+}
+
+inline void encPut(std::uint32_t &x, std::uint8_t *&ptr, std::uint32_t start, std::uint32_t freq)
+{
+    std::uint32_t xmax = ((ransLow >> probBits) << 8) * freq;
+    while (x >= xmax)
+    {
+        *--ptr = (std::uint8_t) (x & 0xff);
+        x >>= 8;
+    }
+    x = ((x / freq) << probBits) + (x % freq) + start;
+}
+
+inline void encFlush(std::uint32_t x, std::uint8_t *&ptr)
+{
+    ptr -= 4;
+    ptr[0] = (std::uint8_t) (x >> 0);
+    ptr[1] = (std::uint8_t) (x >> 8);
+    ptr[2] = (std::uint8_t) (x >> 16);
+    ptr[3] = (std::uint8_t) (x >> 24);
+}
+
+/// Decoding information for one of the @ref probScale slots of the cumulative frequency range
+struct DecodeSlot
+{
+    std::uint16_t freq;     ///< frequency of the symbol owning the slot
+    std::uint16_t bias;     ///< offset of the slot from the start of the symbol's range
+    std::uint8_t sym;       ///< symbol owning the slot
+};
+
+/// Refill a decoder state from the stream. With 12-bit probabilities at most two bytes are needed.
+inline bool decRenorm(std::uint32_t &x, const std::uint8_t *&ptr, const std::uint8_t *end)
+{
+    while (x < ransLow)
+    {
+        if (ptr == end)
+            return false;
+        x = (x << 8) | *ptr++;
+    }
+    return true;
+}
+
+/// Refill a decoder state without bounds checks, for when at least two bytes of input remain
+inline void decRenormFast(std::uint32_t &x, const std::uint8_t *&ptr)
+{
+    for (int k = 0; k < 2; k++)
+    {
+        std::uint32_t n = x < ransLow;
+        x = (x << (n * 8)) | (*ptr & (0u - n));
+        ptr += n;
+    }
+}
+
+} // anonymous namespace
+
+void ransEncode(const std::uint8_t *in, std::size_t len, uts::vector<std::uint8_t> &out)
+{
+    std::uint64_t counts[256] = {0};
+    std::uint32_t freqs[256], starts[256];
+    std::uint64_t rawlen = len, codedlen;
+    std::size_t base = out.size();
+
+    for (std::size_t i = 0; i < len; i++)
+        counts[in[i]]++;
+    if (len > 0)
+        normaliseFreqs(counts, len, freqs);
+    else
+        std::fill(freqs, freqs + 256, 0);
+    starts[0] = 0;
+    for (int s = 1; s < 256; s++)
+        starts[s] = starts[s - 1] + freqs[s - 1];
+
+    // the coder emits bytes back to front, so work in a scratch buffer that is large enough for any input:
+    // no symbol costs more than probBits bits, plus the two flushed states
+    uts::vector<std::uint8_t> scratch(len + len / 2 + 16);
+    std::uint8_t *end = scratch.data() + scratch.size(), *ptr = end;
+    std::uint32_t x0 = ransLow, x1 = ransLow;
+    if (len > 0)
+    {
+        // symbols alternate between the two states; encode in reverse so that decoding runs forwards
+        std::size_t i = len;
+        if (len & 1)
+        {
+            i--;
+            encPut(x0, ptr, starts[in[i]], freqs[in[i]]);
+        }
+        while (i > 0)
+        {
+            encPut(x1, ptr, starts[in[i - 1]], freqs[in[i - 1]]);
+            encPut(x0, ptr, starts[in[i - 2]], freqs[in[i - 2]]);
+            i -= 2;
+        }
+        encFlush(x1, ptr);
+        encFlush(x0, ptr);
+    }
+    codedlen = end - ptr;
+
+    out.resize(base + headerSize + codedlen);
+    std::uint8_t *dst = out.data() + base;
+    std::memcpy(dst, &rawlen, 8);
+    std::memcpy(dst + 8, &codedlen, 8);
+    for (int s = 0; s < 256; s++)
+    {
+        std::uint16_t f = (std::uint16_t) freqs[s];
+        std::memcpy(dst + 16 + s * 2, &f, 2);
+    }
+    std::memcpy(dst + headerSize, ptr, codedlen);
+}
+
+bool ransDecode(const std::uint8_t *in, std::size_t len, uts::vector<std::uint8_t> &out, std::size_t &used,
+                std::uint64_t maxlen)
+{
+    std::uint64_t rawlen, codedlen;
+    std::uint32_t freqs[256], starts[256], sum = 0, maxfreq = 0;
+    DecodeSlot lookup[probScale];
+
+    if (len < headerSize)
+        return false;
+    std::memcpy(&rawlen, in, 8);
+    std::memcpy(&codedlen, in + 8, 8);
+    if (codedlen > len - headerSize)
+        return false;
+    for (int s = 0; s < 256; s++)
+    {
+        std::uint16_t f;
+        std::memcpy(&f, in + 16 + s * 2, 2);
+        freqs[s] = f;
+        starts[s] = sum;
+        sum += f;
+        maxfreq = std::max(maxfreq, freqs[s]);
+    }
+    used = headerSize + codedlen;
+    if (rawlen == 0)
+    {
+        out.clear();
+        return true;
+    }
+
+    // validate the header before allocating: every symbol costs at least log2(probScale / maxfreq) bits of
+    // the coded bytes, so a corrupt length cannot ask for more output than the stream could describe
+    if (sum != probScale || codedlen < 8 || rawlen > maxlen)
+        return false;
+    if (maxfreq < probScale && (double) rawlen * std::log2((double) probScale / maxfreq) > 8.0 * (double) codedlen + 64.0)
+        return false;
+    out.resize(rawlen);
+    for (int s = 0; s < 256; s++)
+        for (std::uint32_t slot = starts[s]; slot < starts[s] + freqs[s]; slot++)
+        {
+            lookup[slot].sym = (std::uint8_t) s;
+            lookup[slot].freq = (std::uint16_t) freqs[s];
+            lookup[slot].bias = (std::uint16_t) (slot - starts[s]);
+        }
+
+    const std::uint8_t *ptr = in + headerSize, *end = ptr + codedlen;
+    std::uint32_t x0, x1;
+    std::memcpy(&x0, ptr, 4);
+    std::memcpy(&x1, ptr + 4, 4);
+    ptr += 8;
+
+    // symbols alternate between the two states exactly as the encoder did
+    std::uint8_t *dst = out.data();
+    std::uint64_t i = 0;
+    for (; i + 1 < rawlen && end - ptr >= 4; i += 2)
+    {
+        // fast path: enough input remains for the worst case, so refill without bounds checks or branches
+        const DecodeSlot &d0 = lookup[x0 & (probScale - 1)];
+        const DecodeSlot &d1 = lookup[x1 & (probScale - 1)];
+        dst[i] = d0.sym;
+        dst[i + 1] = d1.sym;
+        x0 = d0.freq * (x0 >> probBits) + d0.bias;
+        x1 = d1.freq * (x1 >> probBits) + d1.bias;
+        decRenormFast(x0, ptr);
+        decRenormFast(x1, ptr);
+    }
+    for (; i + 1 < rawlen; i += 2)
+    {
+        const DecodeSlot &d0 = lookup[x0 & (probScale - 1)];
+        const DecodeSlot &d1 = lookup[x1 & (probScale - 1)];
+        dst[i] = d0.sym;
+        dst[i + 1] = d1.sym;
+        x0 = d0.freq * (x0 >> probBits) + d0.bias;
+        x1 = d1.freq * (x1 >> probBits) + d1.bias;
+        if (!decRenorm(x0, ptr, end) || !decRenorm(x1, ptr, end))
+            return false;
+    }
+    if (i < rawlen)
+    {
+        const DecodeSlot &d0 = lookup[x0 & (probScale - 1)];
+        dst[i] = d0.sym;
+        x0 = d0.freq * (x0 >> probBits) + d0.bias;
+        if (!decRenorm(x0, ptr, end))
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,37 @@
+/**
+ * @file
+ *
+ * Order-0 byte-wise rANS entropy coding.
+ */
+
+#ifndef UTS_COMMON_RANS_H
+#define UTS_COMMON_RANS_H
+
+#include <cstddef>
+#include <cstdint>
+#include "debug_vector.h"
+
+/**
+ * Entropy code a byte stream with a static order-0 model. The output is self-contained: it holds the
+ * symbol frequencies and the length of the original stream as well as the coded bytes.
+ * @param in        bytes to compress
+ * @param len       number of bytes in @a in
+ * @param[out] out  compressed bytes are appended
+ */
+void ransEncode(const std::uint8_t *in, std::size_t len, uts::vector<std::uint8_t> &out);
+
+/**
+ * Decode a stream produced by @ref ransEncode.
+ * @param in        start of the compressed stream
+ * @param len       number of bytes available at @a in
+ * @param[out] out  replaced by the decompressed bytes
+ * @param[out] used number of bytes of @a in consumed by the stream
+ * @param maxlen    largest decompressed length the caller accepts. Streams claiming more, or more than their
+ *                  coded bytes could hold under their frequency table, are rejected before any allocation.
+ * @retval true  if the stream is well formed,
+ * @retval false if it is truncated or corrupt.
+ */
+bool ransDecode(const std::uint8_t *in, std::size_t len, uts::vector<std::uint8_t> &out, std::size_t &used,
+                std::uint64_t maxlen = UINT64_MAX);
+
+#endif /* !UTS_COMMON_RANS_H */
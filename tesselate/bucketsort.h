@@ -0,0 +1,81 @@
+#ifndef _BUCKETSORT
+#define _BUCKETSORT
+/**
+ * @file
+ *
+ * Parallel counting sort of items into integer buckets, producing compressed sparse row offsets.
+ */
+
+#include <vector>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/**
+ * Stable parallel counting sort of the items 0 to n-1 by a bucket key. Each thread counts a contiguous range of items
+ * into its own histogram, and the histograms are turned into thread-minor offsets within each bucket, so the items of
+ * a bucket come out in increasing order without atomics and regardless of the number of threads.
+ * @param nbuckets      number of buckets, keys must lie in [0, nbuckets)
+ * @param n             number of items
+ * @param key           callable key(i) giving the bucket of item i
+ * @param[out] start    nbuckets + 1 offsets, with bucket b held in [start[b], start[b+1]) of @a items
+ * @param[out] items    item indices grouped by bucket
+ */
+template<typename KeyFn> void bucketSort(int nbuckets, int n, KeyFn key, std::vector<int> & start, std::vector<int> & items)
+{
+    int nthreads = 1;
+
+#ifdef _OPENMP
+    // a histogram per thread costs memory in proportion to the buckets, so only split large inputs
+    nthreads = std::max(1, std::min(omp_get_max_threads(), n / 65536));
+#endif
+    std::vector<int> counts((size_t) nthreads * nbuckets, 0);
+
+    start.assign(nbuckets + 1, 0);
+    items.resize(n);
+    #pragma omp parallel num_threads(nthreads)
+    {
+        int th = 0, team = 1, i, b;
+#ifdef _OPENMP
+        th = omp_get_thread_num();
+        team = omp_get_num_threads(); // may be fewer than requested
+#endif
+        int i0 = (int) ((long) n * th / team), i1 = (int) ((long) n * (th+1) / team);
+        int * cnt = &counts[(size_t) th * nbuckets];
+
+        for(i = i0; i < i1; i++)
+            cnt[key(i)]++;
+        #pragma omp barrier
+
+        #pragma omp for
+        for(b = 0; b < nbuckets; b++)
+        {
+            int total = 0;
+            for(int t = 0; t < team; t++)
+                total += counts[(size_t) t * nbuckets + b];
+            start[b+1] = total;
+        }
+
+        #pragma omp single
+        for(b = 0; b < nbuckets; b++)
+            start[b+1] += start[b];
+
+        #pragma omp for
+        for(b = 0; b < nbuckets; b++)
+        {
+            int off = start[b];
+            for(int t = 0; t < team; t++)
+            {
+                int c = counts[(size_t) t * nbuckets + b];
+                counts[(size_t) t * nbuckets + b] = off;
+                off += c;
+            }
+        }
+
+        for(i = i0; i < i1; i++)
+            items[cnt[key(i)]++] = i;
+    }
+}
+
+#endif
@@ -0,0 +1,357 @@
+//
+// TriangleBVH
+//
+
+#include "bvh.h"
+#include "simd.h"
+#include "mesh.h"
+#include "pointarray.h"
+#include <math.h>
+#include <limits>
+#include <algorithm>
+
+using namespace std;
+
+#ifdef SIMD_WIDTH
+static const int bvhgroup = SIMD_WIDTH;  // triangles tested together, one per lane
+#else
+static const int bvhgroup = 4;
+#endif
+static const int bvhstride = 9 * bvhgroup;  // floats per packed group: first vertex and two edges
+static const int bvhbins = 16;              // candidate split planes per axis are the boundaries between bins
+static const int bvhmaxleaf = 4 * bvhgroup; // largest leaf kept when no split pays off
+static const float bvhtraversal = 1.0f;     // cost of visiting a node, relative to testing one group
+static const int bvhtopdepth = 6;           // levels split serially before subtrees are handed to threads
+static const int bvhtopmin = 4096;          // ranges smaller than this are left whole to a single thread
+
+/// Number of groups needed to hold n triangles
+static inline int groups(int n)
+{
+    return (n + bvhgroup - 1) / bvhgroup;
+}
+
+/// Half the surface area of a box
+static inline float halfArea(const float * lo, const float * hi)
+{
+    float dx = hi[0] - lo[0], dy = hi[1] - lo[1], dz = hi[2] - lo[2];
+    return dx * dy + dy * dz + dz * dx;
+}
+
+/// Grow a box to enclose another
+static inline void expand(float * lo, float * hi, const float * blo, const float * bhi)
+{
+    for(int a = 0; a < 3; a++)
+    {
+        lo[a] = min(lo[a], blo[a]);
+        hi[a] = max(hi[a], bhi[a]);
+    }
+}
+
+/// Set a box to be empty, ready to grow
+static inline void empty(float * lo, float * hi)
+{
+    for(int a = 0; a < 3; a++)
+    {
+        lo[a] = HUGE_VALF;
+        hi[a] = -HUGE_VALF;
+    }
+}
+
+/**
+ * Count the triangles of packed groups crossed by the ray from a point along +x. This is the Moller-Trumbore test of
+ * glm::intersectRayTriangle with the ray direction fixed at (1,0,0), so the terms it zeroes are dropped, and the
+ * same comparisons are made with the same rounding. Padding triangles are degenerate and never counted.
+ */
+static int groupCrossings(const float * g, int ngroups, cgp::Point o)
+{
+    const float eps = numeric_limits<float>::epsilon();
+    int hits = 0;
+
+    for(; ngroups > 0; ngroups--, g += bvhstride)
+    {
+        const float * v0x = g, * v0y = g + bvhgroup, * v0z = g + 2 * bvhgroup;
+        const float * e1x = g + 3 * bvhgroup, * e1y = g + 4 * bvhgroup, * e1z = g + 5 * bvhgroup;
+        const float * e2x = g + 6 * bvhgroup, * e2y = g + 7 * bvhgroup, * e2z = g + 8 * bvhgroup;
+#ifdef SIMD_WIDTH
+        const vfloat zero = vset(0.0f), veps = vset(eps), vneps = vset(-eps);
+        vfloat sx = vsub(vset(o.x), vload(v0x)), sy = vsub(vset(o.y), vload(v0y)), sz = vsub(vset(o.z), vload(v0z));
+        vfloat ax = vload(e1x), ay = vload(e1y), az = vload(e1z), bx = vload(e2x), by = vload(e2y), bz = vload(e2z);
+        vfloat det = vsub(vmul(az, by), vmul(ay, bz));
+        vfloat u = vsub(vmul(sz, by), vmul(sy, bz));
+        vfloat qx = vsub(vmul(sy, az), vmul(ay, sz)), qy = vsub(vmul(sz, ax), vmul(az, sx)), qz = vsub(vmul(sx, ay), vmul(ax, sy));
+        vfloat uv = vadd(u, qx);
+        vfloat front = vand(vgt(det, veps), vand(vand(vge(u, zero), vge(det, u)), vand(vge(qx, zero), vge(det, uv))));
+        vfloat back = vand(vgt(vneps, det), vand(vand(vge(zero, u), vge(u, det)), vand(vge(zero, qx), vge(uv, det))));
+        vfloat dist = vmul(vadd(vadd(vmul(bx, qx), vmul(by, qy)), vmul(bz, qz)), vdiv(vset(1.0f), det));
+        for(int m = vmask(vand(vor(front, back), vgt(dist, zero))); m; m &= m - 1)
+            hits++;
+#else
+        for(int l = 0; l < bvhgroup; l++)
+        {
+            float sx = o.x - v0x[l], sy = o.y - v0y[l], sz = o.z - v0z[l];
+            float det = e1z[l] * e2y[l] - e1y[l] * e2z[l], u = sz * e2y[l] - sy * e2z[l];
+            float qx = sy * e1z[l] - e1y[l] * sz, qy = sz * e1x[l] - e1z[l] * sx, qz = sx * e1y[l] - e1x[l] * sy;
+            bool front = det > eps && u >= 0.0f && det >= u && qx >= 0.0f && det >= u + qx;
+            bool back = -eps > det && 0.0f >= u && u >= det && 0.0f >= qx && u + qx >= det;
+            if((front || back) && (e2x[l] * qx + e2y[l] * qy + e2z[l] * qz) * (1.0f / det) > 0.0f)
+                hits++;
+        }
+#endif
+    }
+    return hits;
+}
+
+void TriangleBVH::fitNode(int begin, int end, BVHNode & node)
+{
+    empty(node.lo, node.hi);
+    for(int i = begin; i < end; i++)
+    {
+        const float * b = &bounds[6 * order[i]];
+        expand(node.lo, node.hi, b, b + 3);
+    }
+    node.skip = node.first = node.count = 0;
+}
+
+int TriangleBVH::split(int begin, int end, const BVHNode & node)
+{
+    int n = end - begin, i, a, b, best = -1, bestaxis = -1, count;
+    float cmin[3], cmax[3], scale[3], lo[3], hi[3], parea, cost, bestcost = HUGE_VALF;
+    int bincount[bvhbins], rightcount[bvhbins];
+    float binlo[bvhbins][3], binhi[bvhbins][3], rightarea[bvhbins];
+
+    empty(cmin, cmax);
+    for(i = begin; i < end; i++)
+        expand(cmin, cmax, &centroids[3 * order[i]], &centroids[3 * order[i]]);
+    parea = halfArea(node.lo, node.hi);
+    if(!(parea > 0.0f))
+        parea = 1.0f;
+
+    for(a = 0; a < 3; a++)
+    {
+        if(!(cmax[a] > cmin[a]))
+            continue;
+        scale[a] = (float) bvhbins / (cmax[a] - cmin[a]);
+        for(b = 0; b < bvhbins; b++)
+        {
+            bincount[b] = 0;
+            empty(binlo[b], binhi[b]);
+        }
+        for(i = begin; i < end; i++)
+        {
+            int t = order[i];
+            b = min(bvhbins - 1, (int) ((centroids[3 * t + a] - cmin[a]) * scale[a]));
+            bincount[b]++;
+            expand(binlo[b], binhi[b], &bounds[6 * t], &bounds[6 * t + 3]);
+        }
+
+        // sweep from the right recording what lies beyond each plane, then from the left pricing each plane
+        empty(lo, hi);
+        count = 0;
+        for(b = bvhbins - 1; b > 0; b--)
+        {
+            expand(lo, hi, binlo[b], binhi[b]);
+            count += bincount[b];
+            rightcount[b] = count;
+            rightarea[b] = count > 0 ? halfArea(lo, hi) : 0.0f;
+        }
+        empty(lo, hi);
+        count = 0;
+        for(b = 0; b < bvhbins - 1; b++)
+        {
+            expand(lo, hi, binlo[b], binhi[b]);
+            count += bincount[b];
+            if(count == 0 || rightcount[b+1] == 0)
+                continue;
+            cost = bvhtraversal + ((float) groups(count) * halfArea(lo, hi) + (float) groups(rightcount[b+1]) * rightarea[b+1]) / parea;
+            if(cost < bestcost)
+            {
+                bestcost = cost;
+                best = b;
+                bestaxis = a;
+            }
+        }
+    }
+
+    if(bestaxis < 0) // every centroid coincides, so only an arbitrary split can shrink an oversized leaf
+        return n <= bvhmaxleaf ? -1 : begin + n / 2;
+    if(bestcost >= (float) groups(n) && n <= bvhmaxleaf)
+        return -1;
+
+    a = bestaxis;
+    float base = cmin[a], s = scale[a];
+    const float * cen = &centroids[0];
+    int mid = (int) (std::partition(order.begin() + begin, order.begin() + end, [cen, a, base, s, best](int t)
+                     { return min(bvhbins - 1, (int) ((cen[3 * t + a] - base) * s)) <= best; }) - order.begin());
+    if(mid == begin || mid == end)
+        mid = begin + n / 2;
+    return mid;
+}
+
+void TriangleBVH::buildSubtree(int begin, int end, std::vector<BVHNode> & out)
+{
+    int idx = (int) out.size(), mid;
+    BVHNode node;
+
+    fitNode(begin, end, node);
+    mid = split(begin, end, node);
+    if(mid < 0)
+    {
+        node.first = begin; // position in order until the triangles are packed
+        node.count = end - begin;
+        node.skip = idx + 1;
+        out.push_back(node);
+        return;
+    }
+    out.push_back(node);
+    buildSubtree(begin, mid, out);
+    buildSubtree(mid, end, out);
+    out[idx].skip = (int) out.size();
+}
+
+void TriangleBVH::buildTop(int begin, int end, int depth, std::vector<BVHNode> & top, std::vector<int> & tasks)
+{
+    int idx = (int) top.size(), mid = -1;
+    BVHNode node;
+
+    fitNode(begin, end, node);
+    if(depth > 0 && end - begin >= bvhtopmin)
+        mid = split(begin, end, node);
+    if(mid < 0)
+    {
+        tasks.push_back(begin);
+        tasks.push_back(end);
+        tasks.push_back(idx);
+        node.skip = idx + 1;
+        top.push_back(node);
+        return;
+    }
+    top.push_back(node);
+    buildTop(begin, mid, depth - 1, top, tasks);
+    buildTop(mid, end, depth - 1, top, tasks);
+    top[idx].skip = (int) top.size();
+}
+
+void TriangleBVH::build(const PointArray & pnts, const std::vector<Triangle> & tris)
+{
+    int nt = (int) tris.size(), t, i, k, ntasks, ngroups, nleaves, at;
+    std::vector<BVHNode> top;
+    std::vector<int> tasks, pos, leaves, begins;
+
+    nodes.clear();
+    packed.clear();
+    if(nt == 0)
+    {
+        valid.store(true, std::memory_order_release);
+        return;
+    }
+
+    bounds.resize(6 * nt);
+    centroids.resize(3 * nt);
+    order.resize(nt);
+    #pragma omp parallel for if(nt > 65536)
+    for(t = 0; t < nt; t++)
+    {
+        float * b = &bounds[6 * t];
+        empty(b, b + 3);
+        for(int p = 0; p < 3; p++)
+        {
+            int v = tris[t].v[p];
+            float c[3] = {pnts.x[v], pnts.y[v], pnts.z[v]};
+            expand(b, b + 3, c, c);
+        }
+        for(int a = 0; a < 3; a++)
+            centroids[3 * t + a] = 0.5f * (b[a] + b[a + 3]);
+        order[t] = t;
+    }
+
+    // upper levels serially, then the subtrees below them in parallel, each into its own node list
+    buildTop(0, nt, bvhtopdepth, top, tasks);
+    ntasks = (int) tasks.size() / 3;
+    std::vector<std::vector<BVHNode>> sub(ntasks);
+    #pragma omp parallel for if(nt > 65536) schedule(dynamic)
+    for(k = 0; k < ntasks; k++)
+        buildSubtree(tasks[3 * k], tasks[3 * k + 1], sub[k]);
+
+    // splice each subtree in place of its placeholder, shifting indices to their final positions
+    pos.resize(top.size() + 1);
+    for(i = 0, k = 0, at = 0; i < (int) top.size(); i++)
+    {
+        pos[i] = at;
+        if(k < ntasks && tasks[3 * k + 2] == i)
+            at += (int) sub[k++].size();
+        else
+            at++;
+    }
+    pos[top.size()] = at;
+    nodes.resize(at);
+    for(i = 0, k = 0; i < (int) top.size(); i++)
+    {
+        if(k < ntasks && tasks[3 * k + 2] == i)
+        {
+            for(const BVHNode & s : sub[k])
+            {
+                nodes[pos[i] + (&s - &sub[k][0])] = s;
+                nodes[pos[i] + (&s - &sub[k][0])].skip += pos[i];
+            }
+            k++;
+        }
+        else
+        {
+            nodes[pos[i]] = top[i];
+            nodes[pos[i]].skip = pos[top[i].skip];
+        }
+    }
+
+    // copy the triangles of each leaf into consecutive groups, numbered in depth-first order
+    ngroups = 0;
+    for(i = 0; i < (int) nodes.size(); i++)
+        if(nodes[i].count > 0)
+        {
+            leaves.push_back(i);
+            begins.push_back(nodes[i].first);
+            nodes[i].first = ngroups;
+            ngroups += groups(nodes[i].count);
+        }
+    nleaves = (int) leaves.size();
+    packed.assign((long) ngroups * bvhstride, 0.0f);
+    #pragma omp parallel for if(nt > 65536)
+    for(i = 0; i < nleaves; i++)
+    {
+        const BVHNode & leaf = nodes[leaves[i]];
+        for(int j = 0; j < leaf.count; j++)
+        {
+            const Triangle & tri = tris[order[begins[i] + j]];
+            float * g = &packed[(long) (leaf.first + j / bvhgroup) * bvhstride + j % bvhgroup];
+            int v0 = tri.v[0], v1 = tri.v[1], v2 = tri.v[2];
+            g[0] = pnts.x[v0]; g[bvhgroup] = pnts.y[v0]; g[2 * bvhgroup] = pnts.z[v0];
+            g[3 * bvhgroup] = pnts.x[v1] - pnts.x[v0]; g[4 * bvhgroup] = pnts.y[v1] - pnts.y[v0]; g[5 * bvhgroup] = pnts.z[v1] - pnts.z[v0];
+            g[6 * bvhgroup] = pnts.x[v2] - pnts.x[v0]; g[7 * bvhgroup] = pnts.y[v2] - pnts.y[v0]; g[8 * bvhgroup] = pnts.z[v2] - pnts.z[v0];
+        }
+    }
+
+    // the build arrays are not needed by queries
+    std::vector<int>().swap(order);
+    std::vector<float>().swap(bounds);
+    std::vector<float>().swap(centroids);
+    valid.store(true, std::memory_order_release);
+}
+
+int TriangleBVH::crossings(cgp::Point origin) const
+{
+    int i = 0, n = (int) nodes.size(), hits = 0;
+
+    // the ray runs along +x, so it meets a box when its y and z lie within it and the box extends ahead of it
+    while(i < n)
+    {
+        const BVHNode & node = nodes[i];
+        if(origin.y < node.lo[1] || origin.y > node.hi[1] || origin.z < node.lo[2] || origin.z > node.hi[2] || origin.x > node.hi[0])
+        {
+            i = node.skip;
+            continue;
+        }
+        if(node.count > 0)
+            hits += groupCrossings(&packed[(long) node.first * bvhstride], groups(node.count), origin);
+        i++;
+    }
+    return hits;
+}
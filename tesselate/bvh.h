@@ -0,0 +1,125 @@
+#ifndef _BVH
+#define _BVH
+/**
+ * @file
+ *
+ * Bounding volume hierarchy over the triangles of a mesh, for ray parity point containment queries.
+ */
+
+#include <vector>
+#include <atomic>
+#include "vecpnt.h"
+
+struct Triangle;
+class PointArray;
+
+/// Node of a @ref TriangleBVH, stored in depth-first order
+struct BVHNode
+{
+    float lo[3];    ///< minimum corner of the bounds of the subtree
+    float hi[3];    ///< maximum corner of the bounds of the subtree
+    int skip;       ///< index of the first node after this subtree, where traversal resumes when the ray misses it
+    int first;      ///< first triangle group of a leaf
+    int count;      ///< number of triangles in a leaf, 0 for an interior node
+};
+
+/**
+ * Bounding volume hierarchy built top-down by binned surface area heuristic splits. Nodes are laid out depth-first
+ * with a skip index on each, so a traversal walks forward through the array without a stack, jumping over subtrees the
+ * ray misses. Leaf triangles are copied into groups of SIMD width in structure-of-arrays form, and each group is
+ * tested against the ray at once. The split cost counts groups rather than triangles to match. The upper levels are
+ * split serially and the subtrees below them built in parallel, with the same result for any number of threads.
+ * A completed build is published through a flag that threads can check without a lock before querying.
+ */
+class TriangleBVH
+{
+private:
+    std::vector<BVHNode> nodes;     ///< hierarchy in depth-first order
+    std::vector<float> packed;      ///< leaf triangles by group: first vertex, then first and second edges, per coordinate per lane
+    std::vector<int> order;         ///< triangle indices, grouped by leaf during the build
+    std::vector<float> bounds;      ///< per triangle during the build, minimum and maximum corners
+    std::vector<float> centroids;   ///< per triangle during the build, centre of its bounds
+    std::atomic<bool> valid;        ///< set with release once a build completes, cleared by invalidate
+
+    /**
+     * Set the bounds of a node over a range of the triangle order
+     * @param begin, end    range [begin, end) of order
+     * @param[out] node     node whose bounds are set
+     */
+    void fitNode(int begin, int end, BVHNode & node);
+
+    /**
+     * Choose a split of a range of triangles by the surface area heuristic, evaluated at bin boundaries along each
+     * axis, and partition the range about it
+     * @param begin, end    range [begin, end) of order, already fitted by node
+     * @param node          bounds of the range
+     * @returns start of the second part, or -1 if the range is better kept as a leaf
+     */
+    int split(int begin, int end, const BVHNode & node);
+
+    /**
+     * Build a subtree by recursive splitting, appending its nodes in depth-first order
+     * @param begin, end    range [begin, end) of order
+     * @param[out] out      nodes, with skip indices relative to the start of the vector
+     */
+    void buildSubtree(int begin, int end, std::vector<BVHNode> & out);
+
+    /**
+     * Split the upper levels of the hierarchy, leaving a placeholder node for each subtree below them
+     * @param begin, end    range [begin, end) of order
+     * @param depth         number of levels still to split
+     * @param[out] top      upper nodes in depth-first order, with skip indices into top
+     * @param[out] tasks    begin, end and placeholder index of each subtree still to build
+     */
+    void buildTop(int begin, int end, int depth, std::vector<BVHNode> & top, std::vector<int> & tasks);
+
+public:
+
+    /// Default constructor, for an empty hierarchy that is not ready
+    TriangleBVH() : valid(false) {}
+
+    /// Copy constructor, which copies the hierarchy along with whether it is ready
+    TriangleBVH(const TriangleBVH & other) : nodes(other.nodes), packed(other.packed), valid(other.ready()) {}
+
+    /// Assignment, which copies the hierarchy along with whether it is ready
+    TriangleBVH & operator=(const TriangleBVH & other)
+    {
+        nodes = other.nodes;
+        packed = other.packed;
+        valid.store(other.ready());
+        return * this;
+    }
+
+    /// Number of nodes in the hierarchy
+    int numNodes() const { return (int) nodes.size(); }
+
+    /// Remove the hierarchy
+    void clear(){ valid.store(false); nodes.clear(); packed.clear(); }
+
+    /**
+     * Test without locking whether a build has completed since the hierarchy was last invalidated. When it has,
+     * the hierarchy built is visible to the calling thread and may be queried at once.
+     */
+    bool ready() const { return valid.load(std::memory_order_acquire); }
+
+    /// Mark the hierarchy as stale, after the triangles it was built over have changed
+    void invalidate(){ valid.store(false); }
+
+    /**
+     * Build the hierarchy over a set of triangles, replacing any previous one, and mark it ready. Not to be called
+     * while other threads query it.
+     * @param pnts  vertex positions, in the space in which queries will be made
+     * @param tris  triangles indexing them
+     */
+    void build(const PointArray & pnts, const std::vector<Triangle> & tris);
+
+    /**
+     * Count the triangles crossed by the ray from a point along +x, testing triangles in either winding, as
+     * Mesh::pointContainment does
+     * @param origin    start of the ray
+     * @returns number of crossings strictly ahead of the origin, odd when the origin is inside a closed mesh
+     */
+    int crossings(cgp::Point origin) const;
+};
+
+#endif
@@ -3,6 +3,7 @@
 //
 
 #include "csg.h"
+#include "slabvox.h"
 #define GLM_ENABLE_EXPERIMENTAL
 #include <stdio.h>
 #include <math.h>
@@ -279,6 +280,7 @@ void Scene::voxWalk(SceneNode *root, VoxelVolume *voxels)
     VoxelVolume * rightvoxels;
     ShapeNode * shapenode;
     OpNode * opnode;
+    Mesh * mesh;
     int dx, dy, dz;
     cgp::Point o;
     cgp::Vector d;
@@ -286,21 +288,31 @@ void Scene::voxWalk(SceneNode *root, VoxelVolume *voxels)
     if(dynamic_cast<ShapeNode*>( root )) // SceneNode
     {
         shapenode = dynamic_cast<ShapeNode*>( root );
-        // needs to be improved by only considering bounding box area
+        mesh = dynamic_cast<Mesh*>( shapenode->shape );
         voxels->getDim(dx, dy, dz);
 
-        cerr << "xdim = " << dx << endl;
-        for(int x = 0; x < dx; x++)
+        if(mesh) // one ray per voxel column, crossing only the triangles binned to its row, rather than one per voxel
         {
-            #pragma omp parallel for
-            for(int y = 0; y < dy; y++)
-                for(int z = 0; z < dz; z++)
-                    voxels->set(x,y,z, shapenode->shape->pointContainment(voxels->getVoxelPos(x,y,z)));
-            int temp = ((float) x/dx)*100;
-            if (temp > percentDone && (temp%10==0))
+            vector<float> tris;
+            mesh->getWorldTriangles(tris);
+            voxels->fill(false);
+            scanConvertTriangles(tris, voxels, 0, dz);
+        }
+        else // needs to be improved by only considering bounding box area
+        {
+            cerr << "xdim = " << dx << endl;
+            for(int x = 0; x < dx; x++)
             {
-                percentDone = temp;
-                cerr << "Percent Complete: " << percentDone << "%" << endl;
+                #pragma omp parallel for
+                for(int y = 0; y < dy; y++)
+                    for(int z = 0; z < dz; z++)
+                        voxels->set(x,y,z, shapenode->shape->pointContainment(voxels->getVoxelPos(x,y,z)));
+                int temp = ((float) x/dx)*100;
+                if (temp > percentDone && (temp%10==0))
+                {
+                    percentDone = temp;
+                    cerr << "Percent Complete: " << percentDone << "%" << endl;
+                }
             }
         }
     }
@@ -372,6 +384,19 @@ void Scene::voxelise(float voxlen)
     rep = SceneRep::VOXELS;
 }
 
+bool Scene::voxeliseSTL(string filename, float voxlen)
+{
+    SlabVoxeliser slabber;
+
+    // triangles are streamed through on-disk slabs, so only the voxel volume itself needs to be resident
+    voxsidelen = voxlen;
+    if(!slabber.voxelise(filename, voxlen, &vox))
+        return false;
+
+    rep = SceneRep::VOXELS;
+    return true;
+}
+
 void Scene::isoextract()
 {
     voxmesh.marchingCubes(&vox);
@@ -432,7 +457,7 @@ void Scene::loadSTLScene(string filename)
 {
     ShapeNode * mesh = new ShapeNode();
     Mesh * object = new Mesh();
-    object->readSTL(filename);
+    object->readSTLCached(filename);
     object->boxFit(30.0f);
     mesh->shape = object;
     csgroot = mesh;
@@ -458,7 +483,7 @@ void Scene::expensiveScene(string filename)
 
     ShapeNode * mesh = new ShapeNode();
     Mesh * loadedModel = new Mesh();
-    loadedModel->readSTL(filename);
+    loadedModel->readSTLCached(filename);
     loadedModel->boxFit(10.0f);
     mesh->shape = loadedModel;
 
@@ -506,16 +531,14 @@ void Scene::displayVoxelScene(string filename)
     /// load grid
     readGridVV(filename, 32);
 
-    /// load cube mesh
-    ShapeNode * mesh = new ShapeNode();
-    Mesh * loadedModel = new Mesh();
+    /// load cube mesh once and share it between all the voxels
+    std::shared_ptr<Mesh> loadedModel = std::make_shared<Mesh>();
     loadedModel->readSTL("meshes/triangle/cube5mm.stl");
     loadedModel->boxFit(2.0f);
 
     OpNode * combine = new OpNode();
     combine->op = SetOp::UNION;
 
-    vector<Mesh*> loadedModels;
     vector<OpNode*> shapeList;
     vector<ShapeNode*> shapeNodes;
 
@@ -531,17 +554,14 @@ void Scene::displayVoxelScene(string filename)
             for (int x = 0; x < length; ++x) {
                 pos = cgp::Vector(pos.i + offset, pos.j, pos.k); // update x position
                 if (vox.get(z, y, x) == 1) { // voxel found, so render cube based on pos
-                    loadedModels.push_back(new Mesh());
-                    *loadedModels[entryCount] = *loadedModel; // copy cube mesh
-                    loadedModels[entryCount]->setTranslation(pos); // place cube at new pos
+                    MeshInstance * cube = new MeshInstance(loadedModel);
+                    cube->setTranslation(pos); // place cube at new pos
                     shapeNodes.push_back(new ShapeNode());
-                    shapeNodes[entryCount]->shape = loadedModels[entryCount];
+                    shapeNodes[entryCount]->shape = cube;
 
                     if (entryCount == 0) {
-                        loadedModel->setTranslation(cgp::Vector(pos.i, pos.j, pos.k));
-                        mesh->shape = loadedModel;
-                        combine->left = mesh;
-                        combine->right = mesh;
+                        combine->left = shapeNodes[entryCount];
+                        combine->right = shapeNodes[entryCount];
                         shapeList.push_back(combine);
                     } else {
                         shapeList.push_back(new OpNode());
@@ -723,6 +743,7 @@ void Scene::newTestScene(string filename)
     ShapeNode * finalMesh = new ShapeNode();
     Mesh * accCube = new Mesh();
     accCube->readSTL("meshes/triangle/10mm_test_cube.stl");
+    Mesh cube(* accCube); // copied for every further voxel rather than read again
 
     int entryCount = 0, length = 32;
     cgp::Point pointToAdd = cgp::Point(0.0f, 0.0f, 0.0f);
@@ -743,18 +764,17 @@ void Scene::newTestScene(string filename)
                             (*i).add(pointToAdd);
                         }
                     } else {
-                        Mesh * newCube = new Mesh();
-                        newCube->readSTL("meshes/triangle/10mm_test_cube.stl");
+                        Mesh newCube(cube);
 
                         /// translate vertices of new cube
-                        vector<cgp::Point> * vts = newCube->getVerts();
+                        vector<cgp::Point> * vts = newCube.getVerts();
 
                         for (std::vector<cgp::Point>::iterator i = vts->begin() ; i != vts->end(); ++i) {
                             (*i).add(pointToAdd);
                         }
 
                         /// change triangle indices in new cube
-                        vector<Triangle> * trs = newCube->getCubeTriangles();
+                        vector<Triangle> * trs = newCube.getCubeTriangles();
                         int sizeToAdd = accCube->getNumVerts();
                         Triangle vecToAdd;
                         for (std::vector<Triangle>::iterator i = trs->begin() ; i != trs->end(); ++i) {
@@ -764,7 +784,7 @@ void Scene::newTestScene(string filename)
                         }
 
                         /// merge new cube to accCube
-                        accCube->mergeMesh(newCube);
+                        accCube->mergeMesh(&newCube);
 
 
                         ///< delete surrounding cubes' triangles
@@ -854,6 +874,7 @@ void Scene::anotherVoxelScene(string filename)
     ShapeNode * finalMesh = new ShapeNode();
     Mesh * accCube = new Mesh();
     accCube->readSTL("meshes/triangle/10mm_test_cube.stl");
+    Mesh cube(* accCube); // copied for every further voxel rather than read again
 
     int entryCount = 0, length = 5;
     cgp::Point pointToAdd = cgp::Point(0.0f, 0.0f, 0.0f);
@@ -874,18 +895,17 @@ void Scene::anotherVoxelScene(string filename)
                             (*i).add(pointToAdd);
                         }
                     } else {
-                        Mesh * newCube = new Mesh();
-                        newCube->readSTL("meshes/triangle/10mm_test_cube.stl");
+                        Mesh newCube(cube);
 
                         /// translate vertices of new cube
-                        vector<cgp::Point> * vts = newCube->getVerts();
+                        vector<cgp::Point> * vts = newCube.getVerts();
 
                         for (std::vector<cgp::Point>::iterator i = vts->begin() ; i != vts->end(); ++i) {
                             (*i).add(pointToAdd);
                         }
 
                         /// change triangle indices in new cube
-                        vector<Triangle> * trs = newCube->getCubeTriangles();
+                        vector<Triangle> * trs = newCube.getCubeTriangles();
                         int sizeToAdd = accCube->getNumVerts();
                         Triangle vecToAdd;
                         for (std::vector<Triangle>::iterator i = trs->begin() ; i != trs->end(); ++i) {
@@ -895,7 +915,7 @@ void Scene::anotherVoxelScene(string filename)
                         }
 
                         /// merge new cube to accCube
-                        accCube->mergeMesh(newCube);
+                        accCube->mergeMesh(&newCube);
                     }
                     entryCount++;
                 }
@@ -916,123 +936,9 @@ void Scene::voxelMeshScene(string filename)
     /// load grid
     readGridVV(filename, 32);
 
-    /// global voxel rep object
-    VoxelRep * voxelRep = new VoxelRep ();
-
-    /// test merge mesh
-
-    accCube->readSTL("meshes/triangle/10mm_test_cube.stl");
-
-    int entryCount = 0, length = 32;
-    cgp::Point pointToAdd = cgp::Point(0.0f, 0.0f, 0.0f);
-
-    /// go through voxel grid and render a cube for each voxel value == 1
-    for (int z = 0; z < length; ++z) {
-        for (int y = 0; y < length; ++y) {
-            for (int x = 0; x < length; ++x) {
-                if (vox.get(x, y, z) == 1) { /// voxel found, so render cube
-
-                    voxelRep->add(0, {x, y, z});
-                    pointToAdd = cgp::Point(x*10, y*10, z*10);
-                    if (entryCount == 0) {
-                        /// translate vertices
-                        vector<cgp::Point> * vts = accCube->getVerts();
-
-                        for (std::vector<cgp::Point>::iterator i = vts->begin() ; i != vts->end(); ++i) {
-                            (*i).add(pointToAdd);
-                        }
-                    } else {
-                        Mesh * newCube = new Mesh();
-                        newCube->readSTL("meshes/triangle/10mm_test_cube.stl");
-
-                        /// translate vertices of new cube
-                        vector<cgp::Point> * vts = newCube->getVerts();
-
-                        for (std::vector<cgp::Point>::iterator i = vts->begin() ; i != vts->end(); ++i) {
-                            (*i).add(pointToAdd);
-                        }
-
-                        /// change triangle indices in new cube
-                        vector<Triangle> * trs = newCube->getCubeTriangles();
-                        int sizeToAdd = accCube->getNumVerts();
-                        Triangle vecToAdd;
-                        for (std::vector<Triangle>::iterator i = trs->begin() ; i != trs->end(); ++i) {
-                            (*i).v[0] += sizeToAdd;
-                            (*i).v[1] += sizeToAdd;
-                            (*i).v[2] += sizeToAdd;
-                        }
-
-                        /// merge new cube to accCube
-                        accCube->mergeMesh(newCube);
-
-                        ///< delete surrounding cubes' triangles
-
-                        vector<Triangle> * tris = accCube->getCubeTriangles();
-                        int eCount;
-
-                        // left
-                        if (x != 0  && (vox.get(x-1, y, z) == 1))
-                        {
-                            // existing cube
-                            eCount = voxelRep->getEntryCount({x-1, y, z});
-                            tris->erase(tris->begin() + voxelRep->getStartPos(eCount) + voxelRep->getSideCode("R", {x-1, y, z}), tris->begin() + voxelRep->getStartPos(eCount) + voxelRep->getSideCode("R", {x-1, y, z}) + 2);
-                            voxelRep->addRemovedFaceCode(eCount, "R");
-                            voxelRep->update(2, {x-1, y, z});
-
-                            // newly added cube
-                            eCount = voxelRep->getEntryCount({x, y, z});
-                            tris->erase(tris->begin() + voxelRep->getStartPos(eCount) + voxelRep->getSideCode("L", {x, y, z}), tris->begin() + voxelRep->getStartPos(eCount) + voxelRep->getSideCode("L", {x, y, z}) + 2);
-                            voxelRep->addRemovedFaceCode(eCount, "L");
-                            voxelRep->update(2, {x, y, z});
-                        }
-
-                        // back
-                        if (z != 0  && (vox.get(x, y, z-1) == 1))
-                        {
-                            // existing cube
-                            eCount = voxelRep->getEntryCount({x, y, z-1});
-                            cerr << "x, y, z-1 : " << x << ", " << y << ", " << z-1 << endl;
-                            tris->erase(tris->begin() + voxelRep->getStartPos(eCount) + voxelRep->getSideCode("F", {x, y, z-1}), tris->begin() + voxelRep->getStartPos(eCount) + voxelRep->getSideCode("F", {x, y, z-1}) + 2);
-                            voxelRep->addRemovedFaceCode(eCount, "F");
-                            voxelRep->update(2, {x, y, z-1});
-
-                            // newly added cube
-                            eCount = voxelRep->getEntryCount({x, y, z});
-                            tris->erase(tris->begin() + voxelRep->getStartPos(eCount) + voxelRep->getSideCode("Bk", {x, y, z}), tris->begin() + voxelRep->getStartPos(eCount) + voxelRep->getSideCode("Bk", {x, y, z}) + 2);
-                            voxelRep->addRemovedFaceCode(eCount, "Bk");
-                            voxelRep->update(2, {x, y, z});
-                        }
-
-
-                        // bottom
-                        if (y != 0 && (vox.get(x, y-1, z) == 1))
-                        {
-                            // existing cube
-                            eCount = voxelRep->getEntryCount({x, y-1, z});
-                            tris->erase(tris->begin() + voxelRep->getStartPos(eCount) + voxelRep->getSideCode("T", {x, y-1, z}), tris->begin() + voxelRep->getStartPos(eCount) + voxelRep->getSideCode("T", {x, y-1, z}) + 2);
-                            voxelRep->addRemovedFaceCode(eCount, "T");
-                            voxelRep->update(2, {x, y-1, z});
-
-                            // newly added cube
-                            eCount = voxelRep->getEntryCount({x, y, z});
-                            tris->erase(tris->begin() + voxelRep->getStartPos(eCount) + voxelRep->getSideCode("Bm", {x, y, z}), tris->begin() + voxelRep->getStartPos(eCount) + voxelRep->getSideCode("Bm", {x, y, z}) + 2);
-                            voxelRep->addRemovedFaceCode(eCount, "Bm");
-                            voxelRep->update(2, {x, y, z});
-                        }
-                    }
-                    entryCount++;
-                }
-            }
-        }
-    }
-
-    accCube->mergeAllVerts();
-
-//    cerr << "tris after merge:" << endl;
-//    for (vector<Triangle>::iterator triangle = accCube->getCubeTriangles()->begin(); triangle != accCube->getCubeTriangles()->end(); ++triangle)
-//    {
-//        triangle->printVec();
-//    }
+    /// mesh the exposed voxel faces directly, merging each flat wall into as few rectangles as possible
+    vox.setFrame(cgp::Point(0.0f, 0.0f, 0.0f), cgp::Vector(320.0f, 320.0f, 320.0f)); // 10mm voxels
+    accCube->greedyMesh(&vox);
 
     accCube->boxFit(10.0f);
     finalMesh->shape = accCube;
@@ -1113,6 +1019,7 @@ void Scene::testShrinkScene(bool normalSize)
     {
         vector<cgp::Point> * vts = accCube->getVerts();
         vector<Triangle> * trs = accCube->getCubeTriangles();
+        const MeshAdjacency & adjacency = accCube->getAdjacency();
         vector<cgp::Vector> netVectors;
 
         int index = 0;
@@ -1123,11 +1030,9 @@ void Scene::testShrinkScene(bool normalSize)
             vector<cgp::Vector> normals;
             vector<Triangle> adjacentTris;
 
-            ///< find all adjacent faces
-            for (vector<Triangle>::iterator triangle = trs->begin(); triangle != trs->end(); ++triangle) {
-                if (triangle->vertexFound(index))
-                    adjacentTris.push_back( *triangle );
-            }
+            ///< gather adjacent faces
+            for (int a = adjacency.vtstart[index]; a < adjacency.vtstart[index+1]; ++a)
+                adjacentTris.push_back((*trs)[adjacency.vtris[a]]);
 
             //cerr << "index " << index << " | triangles found: " << adjacentTris.size() << endl;
             //cerr << "normals size: " << normals.size() << endl;
@@ -1195,6 +1100,7 @@ void Scene::pieceA1Scene(bool shrunk)
     if (!shrunk)
     {
         accCube->readSTL("meshes/triangle/10mm_test_cube.stl");
+        Mesh cube(* accCube); // copied for every further voxel rather than read again
 
         // go through voxel grid and render a cube for each voxel value == 1
         for (int z = 0; z < length; ++z) {
@@ -1217,18 +1123,17 @@ void Scene::pieceA1Scene(bool shrunk)
                                 (*i).add(pointToAdd);
                             }
                         } else {
-                            Mesh * newCube = new Mesh();
-                            newCube->readSTL("meshes/triangle/10mm_test_cube.stl");
+                            Mesh newCube(cube);
 
                             /// translate vertices of new cube
-                            vector<cgp::Point> * vts = newCube->getVerts();
+                            vector<cgp::Point> * vts = newCube.getVerts();
 
                             for (std::vector<cgp::Point>::iterator i = vts->begin() ; i != vts->end(); ++i) {
                                 (*i).add(pointToAdd);
                             }
 
                             /// change triangle indices in new cube
-                            vector<Triangle> * trs = newCube->getCubeTriangles();
+                            vector<Triangle> * trs = newCube.getCubeTriangles();
                             int sizeToAdd = accCube->getNumVerts();
                             Triangle vecToAdd;
                             for (std::vector<Triangle>::iterator i = trs->begin() ; i != trs->end(); ++i) {
@@ -1238,7 +1143,7 @@ void Scene::pieceA1Scene(bool shrunk)
                             }
 
                             /// merge new cube to accCube
-                            accCube->mergeMesh(newCube);
+                            accCube->mergeMesh(&newCube);
 
                             ///< delete surrounding cubes' triangles
 
@@ -1315,6 +1220,7 @@ void Scene::pieceA1Scene(bool shrunk)
     {
         vector<cgp::Point> * vts = accCube->getVerts();
         vector<Triangle> * trs = accCube->getCubeTriangles();
+        const MeshAdjacency & adjacency = accCube->getAdjacency();
         vector<cgp::Vector> netVectors;
 
         int index = 0;
@@ -1325,11 +1231,9 @@ void Scene::pieceA1Scene(bool shrunk)
             vector<cgp::Vector> normals;
             vector<Triangle> adjacentTris;
 
-            ///< find all adjacent faces
-            for (vector<Triangle>::iterator triangle = trs->begin(); triangle != trs->end(); ++triangle) {
-                if (triangle->vertexFound(index))
-                    adjacentTris.push_back( *triangle );
-            }
+            ///< gather adjacent faces
+            for (int a = adjacency.vtstart[index]; a < adjacency.vtstart[index+1]; ++a)
+                adjacentTris.push_back((*trs)[adjacency.vtris[a]]);
 
             ///< calculate normals
             for (vector<Triangle>::iterator triangle = adjacentTris.begin(); triangle != adjacentTris.end(); ++triangle) {
@@ -1393,6 +1297,7 @@ void Scene::pieceA2Scene(bool shrunk)
     if (!shrunk)
     {
         accCube->readSTL("meshes/triangle/10mm_test_cube.stl");
+        Mesh cube(* accCube); // copied for every further voxel rather than read again
 
         /// go through voxel grid and render a cube for each voxel value == 1
         for (int z = 0; z < length; ++z) {
@@ -1414,18 +1319,17 @@ void Scene::pieceA2Scene(bool shrunk)
                                 (*i).add(pointToAdd);
                             }
                         } else {
-                            Mesh * newCube = new Mesh();
-                            newCube->readSTL("meshes/triangle/10mm_test_cube.stl");
+                            Mesh newCube(cube);
 
                             /// translate vertices of new cube
-                            vector<cgp::Point> * vts = newCube->getVerts();
+                            vector<cgp::Point> * vts = newCube.getVerts();
 
                             for (std::vector<cgp::Point>::iterator i = vts->begin() ; i != vts->end(); ++i) {
                                 (*i).add(pointToAdd);
                             }
 
                             /// change triangle indices in new cube
-                            vector<Triangle> * trs = newCube->getCubeTriangles();
+                            vector<Triangle> * trs = newCube.getCubeTriangles();
                             int sizeToAdd = accCube->getNumVerts();
                             Triangle vecToAdd;
                             for (std::vector<Triangle>::iterator i = trs->begin() ; i != trs->end(); ++i) {
@@ -1435,7 +1339,7 @@ void Scene::pieceA2Scene(bool shrunk)
                             }
 
                             /// merge new cube to accCube
-                            accCube->mergeMesh(newCube);
+                            accCube->mergeMesh(&newCube);
 
 
                             ///< delete surrounding cubes' triangles
@@ -1513,6 +1417,7 @@ void Scene::pieceA2Scene(bool shrunk)
     {
         vector<cgp::Point> * vts = accCube->getVerts();
         vector<Triangle> * trs = accCube->getCubeTriangles();
+        const MeshAdjacency & adjacency = accCube->getAdjacency();
         vector<cgp::Vector> netVectors;
 
         int index = 0;
@@ -1523,11 +1428,9 @@ void Scene::pieceA2Scene(bool shrunk)
             vector<cgp::Vector> normals;
             vector<Triangle> adjacentTris;
 
-            ///< find all adjacent faces
-            for (vector<Triangle>::iterator triangle = trs->begin(); triangle != trs->end(); ++triangle) {
-                if (triangle->vertexFound(index))
-                    adjacentTris.push_back( *triangle );
-            }
+            ///< gather adjacent faces
+            for (int a = adjacency.vtstart[index]; a < adjacency.vtstart[index+1]; ++a)
+                adjacentTris.push_back((*trs)[adjacency.vtris[a]]);
 
             ///< calculate normals
             for (vector<Triangle>::iterator triangle = adjacentTris.begin(); triangle != adjacentTris.end(); ++triangle) {
@@ -151,6 +151,16 @@ public:
      */
     void voxelise(float voxlen);
 
+    /**
+     * convert a binary STL file directly into a voxel representation without loading it as a mesh, for models
+     * that are too large to hold in memory. The volume is placed in the coordinate frame of the file.
+     * @param filename  binary STL file
+     * @param voxlen    side length of an individual voxel
+     * @retval true  if voxelisation succeeds,
+     * @retval false otherwise.
+     */
+    bool voxeliseSTL(string filename, float voxlen);
+
     /**
      * convert voxel representation back into a mesh using marching cubes
      */
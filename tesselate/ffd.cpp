@@ -3,139 +3,338 @@
 //
 
 #include "ffd.h"
+#include "simd.h"
 #include <stdio.h>
+#include <algorithm>
 
 using namespace std;
 
 GLfloat defaultLatCol[] = {0.2f, 0.2f, 0.2f, 1.0f};
 GLfloat highlightLatCol[] = {1.0f, 0.176f, 0.176f, 1.0f};
-int maxbezorder = 4;
+const int maxbezorder = 4;
+const int bsplineorder = 4; // cubic B-splines, and the most basis values per axis nonzero at a point for either basis
 
-void ffd::alloc()
+// points gathered into structure-of-arrays form per batch, small enough to stay in the L1 cache
+static const int ffdbatch = 256;
+
+/// Binomial coefficient n choose i, a constant expression wherever n and i are
+static constexpr float binomial(int n, int i)
 {
-    // allocate memory for a 3D array of control points and highlighting switches
-    if(dimx > 1 && dimy > 1 && dimz > 1 && dimx <= maxbezorder && dimy <= maxbezorder && dimz <= maxbezorder)
+    return (i <= 0 || i >= n) ? 1.0f : binomial(n-1, i-1) + binomial(n-1, i);
+}
+
+/// Bernstein polynomials of degree N at t, with s = 1-t, from powers of each and compile-time coefficients
+template<int N> static inline void bernstein(float t, float s, float * b)
+{
+    float tp[N+1], sp[N+1];
+
+    tp[0] = sp[0] = 1.0f;
+    for(int i = 1; i <= N; i++)
     {
-        cp = new cgp::Point **[dimx];
-        highlight = new bool **[dimx];
-        for (int i = 0; i < dimx; i++)
-        {
-            cp[i] = new cgp::Point *[dimy];
-            highlight[i] = new bool *[dimy];
+        tp[i] = tp[i-1] * t;
+        sp[i] = sp[i-1] * s;
+    }
+    for(int i = 0; i <= N; i++)
+        b[i] = binomial(N, i) * tp[i] * sp[N-i];
+}
+
+#ifdef SIMD_WIDTH
+/// Bernstein polynomials of degree N for a vector of parameter values
+template<int N> static inline void bernstein(vfloat t, vfloat s, vfloat * b)
+{
+    vfloat tp[N+1], sp[N+1];
+
+    tp[0] = sp[0] = vset(1.0f);
+    for(int i = 1; i <= N; i++)
+    {
+        tp[i] = vmul(tp[i-1], t);
+        sp[i] = vmul(sp[i-1], s);
+    }
+    for(int i = 0; i <= N; i++)
+        b[i] = vmul(vset(binomial(N, i)), vmul(tp[i], sp[N-i]));
+}
+#endif
+
+/**
+ * Deform a batch of points in place by a lattice of degree NX, NY, NZ along x, y, z, leaving points outside it alone.
+ * Control points are split by coordinate and laid out x-major.
+ */
+template<int NX, int NY, int NZ> static void deformBatch(cgp::Point * pnts, int n, cgp::Point origin, cgp::Vector diagonal,
+                                                         const float * cx, const float * cy, const float * cz)
+{
+    float u[ffdbatch], v[ffdbatch], w[ffdbatch], rx[ffdbatch], ry[ffdbatch], rz[ffdbatch];
+    int i = 0;
+
+    for(int j = 0; j < n; j++)
+    {
+        u[j] = (pnts[j].x - origin.x) / diagonal.i;
+        v[j] = (pnts[j].y - origin.y) / diagonal.j;
+        w[j] = (pnts[j].z - origin.z) / diagonal.k;
+    }
 
-            for (int j = 0; j < dimy; j++)
+#ifdef SIMD_WIDTH
+    const vfloat one = vset(1.0f);
+    for(; i + SIMD_WIDTH <= n; i += SIMD_WIDTH)
+    {
+        vfloat vu = vload(u + i), vv = vload(v + i), vw = vload(w + i);
+        vfloat bu[NX+1], bv[NY+1], bw[NZ+1];
+        vfloat x = vset(0.0f), y = vset(0.0f), z = vset(0.0f);
+        int c = 0;
+
+        bernstein<NX>(vu, vsub(one, vu), bu);
+        bernstein<NY>(vv, vsub(one, vv), bv);
+        bernstein<NZ>(vw, vsub(one, vw), bw);
+        for(int a = 0; a <= NX; a++)
+            for(int b = 0; b <= NY; b++)
             {
-                cp[i][j] = new cgp::Point[dimz];
-                highlight[i][j] = new bool[dimz];
+                vfloat bab = vmul(bu[a], bv[b]);
+                for(int d = 0; d <= NZ; d++, c++)
+                {
+                    vfloat wgt = vmul(bab, bw[d]);
+                    x = vadd(x, vmul(wgt, vset(cx[c])));
+                    y = vadd(y, vmul(wgt, vset(cy[c])));
+                    z = vadd(z, vmul(wgt, vset(cz[c])));
+                }
             }
-        }
-        deactivateAllCP();
+        vstore(rx + i, x);
+        vstore(ry + i, y);
+        vstore(rz + i, z);
+    }
+#endif
+    for(; i < n; i++)
+    {
+        float bu[NX+1], bv[NY+1], bw[NZ+1], x = 0.0f, y = 0.0f, z = 0.0f;
+        int c = 0;
+
+        bernstein<NX>(u[i], 1.0f - u[i], bu);
+        bernstein<NY>(v[i], 1.0f - v[i], bv);
+        bernstein<NZ>(w[i], 1.0f - w[i], bw);
+        for(int a = 0; a <= NX; a++)
+            for(int b = 0; b <= NY; b++)
+            {
+                float bab = bu[a] * bv[b];
+                for(int d = 0; d <= NZ; d++, c++)
+                {
+                    float wgt = bab * bw[d];
+                    x += wgt * cx[c]; y += wgt * cy[c]; z += wgt * cz[c];
+                }
+            }
+        rx[i] = x; ry[i] = y; rz[i] = z;
     }
+
+    // the whole batch is evaluated, but only points inside the lattice take the result
+    for(int j = 0; j < n; j++)
+        if(u[j] >= 0.0f && u[j] <= 1.0f && v[j] >= 0.0f && v[j] <= 1.0f && w[j] >= 0.0f && w[j] <= 1.0f)
+            pnts[j] = cgp::Point(rx[j], ry[j], rz[j]);
 }
 
-void ffd::dealloc()
+typedef void (* FFDKernel)(cgp::Point *, int, cgp::Point, cgp::Vector, const float *, const float *, const float *);
+
+template<int NX, int NY> static FFDKernel pickKernel(int nz)
+{
+    switch(nz)
+    {
+        case 1: return &deformBatch<NX, NY, 1>;
+        case 2: return &deformBatch<NX, NY, 2>;
+        default: return &deformBatch<NX, NY, 3>;
+    }
+}
+
+template<int NX> static FFDKernel pickKernel(int ny, int nz)
+{
+    switch(ny)
+    {
+        case 1: return pickKernel<NX, 1>(nz);
+        case 2: return pickKernel<NX, 2>(nz);
+        default: return pickKernel<NX, 3>(nz);
+    }
+}
+
+/// Kernel for a lattice with the given degree along each axis, each in [1, maxbezorder-1]
+static FFDKernel pickKernel(int nx, int ny, int nz)
+{
+    switch(nx)
+    {
+        case 1: return pickKernel<1>(ny, nz);
+        case 2: return pickKernel<2>(ny, nz);
+        default: return pickKernel<3>(ny, nz);
+    }
+}
+
+/// Knot k of a clamped uniform cubic B-spline over [0,1] with the given number of spans
+static inline float knot(int k, int spans)
 {
-    // deallocate 3D array of control points and boolean highlighting switches
-    for (int i = 0; i < dimx; i++)
+    return (float) min(max(k - 3, 0), spans) / (float) spans;
+}
+
+/**
+ * Clamped uniform cubic B-spline basis functions along an axis with n control points that are nonzero at t. The knot
+ * span containing t is found directly, then its four basis functions in closed form, or near the ends, where knots
+ * repeat, by the Cox-de Boor recurrence in the triangular form of Piegl and Tiller's BasisFuns.
+ * @returns index of the control point the first basis value belongs to
+ */
+static inline int bsplineBasis(float t, int n, float * b)
+{
+    int spans = n - 3, s, i, j, r;
+    float left[bsplineorder], right[bsplineorder], saved, temp;
+
+    s = min(max((int) (t * (float) spans), 0), spans - 1);
+
+    // away from the clamped ends the knots are evenly spaced and the basis is the uniform cubic one
+    if(s >= 2 && s <= spans - 3)
+    {
+        float l = t * (float) spans - (float) s, l2 = l * l, l3 = l2 * l, m = 1.0f - l;
+        b[0] = m * m * m * (1.0f / 6.0f);
+        b[1] = (3.0f * l3 - 6.0f * l2 + 4.0f) * (1.0f / 6.0f);
+        b[2] = (-3.0f * l3 + 3.0f * l2 + 3.0f * l + 1.0f) * (1.0f / 6.0f);
+        b[3] = l3 * (1.0f / 6.0f);
+        return s;
+    }
+
+    i = s + 3;
+    b[0] = 1.0f;
+    for(j = 1; j <= 3; j++)
     {
-        for (int j = 0; j < dimy; j++)
+        left[j] = t - knot(i + 1 - j, spans);
+        right[j] = knot(i + j, spans) - t;
+        saved = 0.0f;
+        for(r = 0; r < j; r++)
         {
-            delete [] cp[i][j];
-            delete [] highlight[i][j];
+            temp = b[r] / (right[r+1] + left[j-r]);
+            b[r] = saved + right[r+1] * temp;
+            saved = left[j-r] * temp;
         }
+        b[j] = saved;
+    }
+    return s;
+}
 
-        delete [] cp[i];
-        delete [] highlight[i];
+/**
+ * Deform a batch of points in place by a cubic B-spline lattice with the given dimensions, leaving points outside
+ * it alone. Each point gathers its 4x4x4 block of control points, which are split by coordinate and laid out x-major.
+ */
+static void deformBSplineBatch(cgp::Point * pnts, int n, cgp::Point origin, cgp::Vector diagonal, const int * dim,
+                               const float * cx, const float * cy, const float * cz)
+{
+    float bu[bsplineorder], bv[bsplineorder], bw[bsplineorder];
+
+    for(int j = 0; j < n; j++)
+    {
+        float u = (pnts[j].x - origin.x) / diagonal.i, v = (pnts[j].y - origin.y) / diagonal.j, w = (pnts[j].z - origin.z) / diagonal.k;
+        float x = 0.0f, y = 0.0f, z = 0.0f;
+
+        if(!(u >= 0.0f && u <= 1.0f && v >= 0.0f && v <= 1.0f && w >= 0.0f && w <= 1.0f))
+            continue;
+        int fi = bsplineBasis(u, dim[0], bu), fj = bsplineBasis(v, dim[1], bv), fk = bsplineBasis(w, dim[2], bw);
+        for(int a = 0; a < bsplineorder; a++)
+            for(int b = 0; b < bsplineorder; b++)
+            {
+                const int c = ((fi + a) * dim[1] + fj + b) * dim[2] + fk;
+                float bab = bu[a] * bv[b];
+                for(int d = 0; d < bsplineorder; d++)
+                {
+                    float wgt = bab * bw[d];
+                    x += wgt * cx[c+d]; y += wgt * cy[c+d]; z += wgt * cz[c+d];
+                }
+            }
+        pnts[j] = cgp::Point(x, y, z);
     }
-    delete [] cp;
-    delete [] highlight;
-    cp = NULL;
+}
+
+void ffd::alloc()
+{
+    bool valid;
+
+    // allocate memory for a 3D array of control points and highlighting switches
+    if(basistype == FFDBasis::BSPLINE)
+        valid = dimx >= bsplineorder && dimy >= bsplineorder && dimz >= bsplineorder;
+    else
+        valid = dimx > 1 && dimy > 1 && dimz > 1 && dimx <= maxbezorder && dimy <= maxbezorder && dimz <= maxbezorder;
+    if(valid)
+    {
+        cp.assign(dimx * dimy * dimz, cgp::Point(0.0f, 0.0f, 0.0f));
+        highlight.assign(dimx * dimy * dimz, 0);
+    }
+    else
+        dealloc();
+}
+
+void ffd::dealloc()
+{
+    cp.clear();
+    highlight.clear();
 }
 
 bool ffd::inCPBounds(int i, int j, int k)
 {
-    return (i >= 0 && j >= 0 && k >= 0 && i < dimx && j < dimy && k < dimz);
+    return (i >= 0 && j >= 0 && k >= 0 && i < dimx && j < dimy && k < dimz && !cp.empty());
 }
 
-float ffd::basis(float t, int i, int n)
+void ffd::basisAll(float t, int n, float * b)
 {
-    float b = 0.0f;
     float tinv = 1.0f - t;
 
-    // this could be made more efficienct by calculating the Bernstein polynomials for all indices at the same time
-    // but I have left it this way for readability
-    switch(n)
+    b[0] = 1.0f;
+    for(int d = 1; d <= n; d++)
     {
-        case 0:
-            break; // b=0
-        case 1:
-            switch(i)
-            {
-                case 0: b = tinv; break;
-                case 1: b = t; break;
-                default: break; // b=0
-            }
-            break;
-        case 2:
-            switch(i)
-            {
-                case 0: b = tinv*tinv; break;
-                case 1: b = 2.0f*tinv*t; break;
-                case 2: b = t*t; break;
-                default: break; // b=0
-            }
-            break;
-        case 3:
-            switch(i)
-            {
-                case 0: b = tinv*tinv*tinv; break;
-                case 1: b = 3.0f*tinv*tinv*t; break;
-                case 2: b = 3.0f*tinv*t*t; break;
-                case 3: b = t*t*t; break;
-                default: break; // b=0
-            }
-            break;
-        default:
-            break; // b=0
+        b[d] = t * b[d-1];
+        for(int i = d-1; i > 0; i--)
+            b[i] = tinv * b[i] + t * b[i-1];
+        b[0] = tinv * b[0];
+    }
+}
+
+int ffd::axisBasis(float t, int n, float * b)
+{
+    if(basistype == FFDBasis::BEZIER)
+    {
+        basisAll(t, n-1, b);
+        return 0;
     }
-    return b;
+    return bsplineBasis(t, n, b);
+}
+
+float ffd::greville(int i, int n)
+{
+    if(basistype == FFDBasis::BEZIER)
+        return (float) i / (float) (n-1);
+    else
+        return (knot(i+1, n-3) + knot(i+2, n-3) + knot(i+3, n-3)) / 3.0f;
 }
 
 ffd::ffd()
 {
     dimx = dimy = dimz = 0;
+    basistype = FFDBasis::BEZIER;
     setFrame(cgp::Point(0.0f, 0.0f, 0.0f), cgp::Vector(0.0f, 0.0f, 0.0f));
-    cp = NULL;
-    highlight = NULL;
 }
 
-ffd::ffd(int xnum, int ynum, int znum, cgp::Point corner, cgp::Vector diag)
+ffd::ffd(int xnum, int ynum, int znum, cgp::Point corner, cgp::Vector diag, FFDBasis basis)
 {
     dimx = xnum;
     dimy = ynum;
     dimz = znum;
+    basistype = basis;
     alloc();
     setFrame(corner, diag);
 }
 
 void ffd::reset()
 {
-    cgp::Vector step;
     cgp::Point pos;
 
-    // use linear precision property of bezier curves to lay out ffd control point in a regular pattern
-    // that is equivalent to an identity deformation
-    step.i = diagonal.i / (float) (dimx-1);
-    step.j = diagonal.j / (float) (dimy-1);
-    step.k = diagonal.k / (float) (dimz-1);
+    if(cp.empty())
+        return;
 
+    // use linear precision property of bezier curves and b-splines to lay out ffd control points at their Greville
+    // abscissae, a regular pattern for Bezier lattices, in a way that is equivalent to an identity deformation
     for(int i = 0; i < dimx; i++)
         for(int j = 0; j < dimy; j++)
             for(int k = 0; k < dimz; k++)
             {
                 pos = origin;
-                pos.x += (float) i * step.i; pos.y += (float) j * step.j; pos.z += (float) k * step.k;
-                cp[i][j][k] = pos;
+                pos.x += greville(i, dimx) * diagonal.i; pos.y += greville(j, dimy) * diagonal.j; pos.z += greville(k, dimz) * diagonal.k;
+                cp[index(i,j,k)] = pos;
             }
 }
 
@@ -151,6 +350,13 @@ void ffd::setDim(int numx, int numy, int numz)
     reset();
 }
 
+void ffd::setBasis(FFDBasis basis)
+{
+    basistype = basis;
+    alloc();
+    reset();
+}
+
 void ffd::getFrame(cgp::Point &corner, cgp::Vector &diag)
 {
     corner = origin;
@@ -167,21 +373,18 @@ void ffd::setFrame(cgp::Point corner, cgp::Vector diag)
 void ffd::activateCP(int i, int j, int k)
 {
     if(inCPBounds(i,j,k))
-        highlight[i][j][k] = true;
+        highlight[index(i,j,k)] = true;
 }
 
 void ffd::deactivateCP(int i, int j, int k)
 {
     if(inCPBounds(i,j,k))
-        highlight[i][j][k] = false;
+        highlight[index(i,j,k)] = false;
 }
 
 void ffd::deactivateAllCP()
 {
-    for(int i = 0; i < dimx; i++)
-        for(int j = 0; j < dimy; j++)
-            for(int k = 0; k < dimz; k++)
-                highlight[i][j][k] = false;
+    highlight.assign(highlight.size(), 0);
 }
 
 bool ffd::bindGeometry(View * view, ShapeDrawData &sdd, bool active)
@@ -211,13 +414,13 @@ bool ffd::bindGeometry(View * view, ShapeDrawData &sdd, bool active)
             for(k = 0; k < dimz; k++)
             {
                 if(active) // only draw those control points that match active flag
-                    draw = highlight[i][j][k];
+                    draw = highlight[index(i,j,k)];
                 else
-                    draw = !highlight[i][j][k];
+                    draw = !highlight[index(i,j,k)];
 
                 if(draw)
                 {
-                    pnt = cp[i][j][k];
+                    pnt = cp[index(i,j,k)];
                     trs = glm::vec3(pnt.x, pnt.y, pnt.z);
                     tfm = glm::translate(idt, trs);
                     if(active)
@@ -254,7 +457,7 @@ cgp::Point ffd::getCP(int i, int j, int k)
 {
     if(inCPBounds(i,j,k))
     {
-        return cp[i][j][k];
+        return cp[index(i,j,k)];
     }
     else
     {
@@ -266,15 +469,20 @@ cgp::Point ffd::getCP(int i, int j, int k)
 void ffd::setCP(int i, int j, int k, cgp::Point pnt)
 {
     if(inCPBounds(i,j,k))
-         cp[i][j][k] = pnt;
+         cp[index(i,j,k)] = pnt;
 }
 
 void ffd::deform(cgp::Point & pnt)
 {
     float u, v, w; // coordinates of point within the lattice
-    int i, j, k; // control point indices
+    float bu[bsplineorder], bv[bsplineorder], bw[bsplineorder]; // basis values along each axis that can be nonzero
+    int fi, fj, fk, oi, oj, ok; // first control point and number of them with a basis value along each axis
+    int i, j, k, c; // control point indices
     float b; // basis value
 
+    if(cp.empty())
+        return;
+
     // embed in axis-aligned lattice
     // basically, find the local [0,1]X[0,1]X[0,1] coordinates of the point within the space of the lattice
     u = (pnt.x - origin.x) / diagonal.i;
@@ -285,17 +493,163 @@ void ffd::deform(cgp::Point & pnt)
     if(u >= 0.0f && u <= 1.0f && v >= 0.0f && v <= 1.0f && w >= 0.0f && w <= 1.0f)
     {
         pnt = cgp::Point(0.0f, 0.0f, 0.0f);
+        fi = axisBasis(u, dimx, bu); oi = order(dimx);
+        fj = axisBasis(v, dimy, bv); oj = order(dimy);
+        fk = axisBasis(w, dimz, bw); ok = order(dimz);
 
         // deformation
-        // weighted sum of control points and basis functions that depends on the vertex (u,v,w) coordinates
-        for(i = 0; i < dimx; ++i)
-            for(j = 0; j < dimy; ++j)
-                for(k = 0; k < dimz; ++k)
+        // weighted sum of control points and basis functions that depends on the vertex (u,v,w) coordinates,
+        // over the whole lattice for Bezier bases but only the 4x4x4 block around the point for B-splines
+        for(i = 0; i < oi; ++i)
+            for(j = 0; j < oj; ++j)
+                for(k = 0, c = index(fi+i, fj+j, fk); k < ok; ++k, ++c)
                 {
-                    b = basis(u, i, dimx-1) * basis(v, j, dimy-1) * basis(w, k, dimz-1);
-                    pnt.x +=  b * cp[i][j][k].x;
-                    pnt.y +=  b * cp[i][j][k].y;
-                    pnt.z +=  b * cp[i][j][k].z;
+                    b = bu[i] * bv[j] * bw[k];
+                    pnt.x +=  b * cp[c].x;
+                    pnt.y +=  b * cp[c].y;
+                    pnt.z +=  b * cp[c].z;
                 }
     }
-}
\ No newline at end of file
+}
+
+void ffd::deform(const std::vector<cgp::Point> & pnts, std::vector<cgp::Point> & out)
+{
+    int n = (int) pnts.size(), nbatches = (n + ffdbatch - 1) / ffdbatch, b;
+    std::vector<float> cx, cy, cz;
+    FFDKernel kernel;
+
+    if(&out != &pnts)
+        out = pnts;
+    if(cp.empty())
+        return;
+
+    // control points split by coordinate, so each can be broadcast across SIMD lanes
+    cx.resize(cp.size()); cy.resize(cp.size()); cz.resize(cp.size());
+    for(int c = 0; c < (int) cp.size(); c++)
+    {
+        cx[c] = cp[c].x; cy[c] = cp[c].y; cz[c] = cp[c].z;
+    }
+
+    if(basistype == FFDBasis::BSPLINE)
+    {
+        // each point gathers its own 4x4x4 block of control points from anywhere in the lattice
+        int dim[3] = {dimx, dimy, dimz};
+        #pragma omp parallel for if(n > 65536) schedule(static)
+        for(b = 0; b < nbatches; b++)
+        {
+            int p0 = b * ffdbatch;
+            deformBSplineBatch(&out[p0], min(ffdbatch, n - p0), origin, diagonal, dim, &cx[0], &cy[0], &cz[0]);
+        }
+        return;
+    }
+    kernel = pickKernel(dimx-1, dimy-1, dimz-1);
+
+    #pragma omp parallel for if(n > 65536) schedule(static)
+    for(b = 0; b < nbatches; b++)
+    {
+        int p0 = b * ffdbatch;
+        kernel(&out[p0], min(ffdbatch, n - p0), origin, diagonal, &cx[0], &cy[0], &cz[0]);
+    }
+}
+
+void ffd::embed(const std::vector<cgp::Point> & pnts, FFDEmbedding & emb)
+{
+    int p, n, stride;
+    float u, v, w;
+
+    emb.basis = basistype;
+    emb.dim[0] = dimx; emb.dim[1] = dimy; emb.dim[2] = dimz;
+    emb.order[0] = order(dimx); emb.order[1] = order(dimy); emb.order[2] = order(dimz);
+    emb.origin = origin;
+    emb.diagonal = diagonal;
+    emb.inside.clear();
+    emb.first.clear();
+    emb.weights.clear();
+    emb.applied.clear();
+    if(cp.empty())
+        return;
+
+    // same inside test as deform, so that points on the boundary are treated alike
+    for(p = 0; p < (int) pnts.size(); p++)
+    {
+        u = (pnts[p].x - origin.x) / diagonal.i;
+        v = (pnts[p].y - origin.y) / diagonal.j;
+        w = (pnts[p].z - origin.z) / diagonal.k;
+        if(u >= 0.0f && u <= 1.0f && v >= 0.0f && v <= 1.0f && w >= 0.0f && w <= 1.0f)
+            emb.inside.push_back(p);
+    }
+
+    n = (int) emb.inside.size();
+    stride = emb.stride();
+    emb.first.resize(3 * n);
+    emb.weights.resize((long) n * (long) stride);
+    #pragma omp parallel for if(n > 65536)
+    for(p = 0; p < n; p++)
+    {
+        const cgp::Point & pnt = pnts[emb.inside[p]];
+        float * b = &emb.weights[(long) p * (long) stride];
+        int * f = &emb.first[3 * p];
+        f[0] = axisBasis((pnt.x - origin.x) / diagonal.i, dimx, b);
+        f[1] = axisBasis((pnt.y - origin.y) / diagonal.j, dimy, b + emb.order[0]);
+        f[2] = axisBasis((pnt.z - origin.z) / diagonal.k, dimz, b + emb.order[0] + emb.order[1]);
+    }
+
+    emb.applied = cp;
+}
+
+bool ffd::matches(const FFDEmbedding & emb)
+{
+    return emb.basis == basistype && emb.dim[0] == dimx && emb.dim[1] == dimy && emb.dim[2] == dimz && !cp.empty()
+        && emb.origin.x == origin.x && emb.origin.y == origin.y && emb.origin.z == origin.z
+        && emb.diagonal.i == diagonal.i && emb.diagonal.j == diagonal.j && emb.diagonal.k == diagonal.k;
+}
+
+int ffd::updateEmbedded(FFDEmbedding & emb, std::vector<cgp::Point> & out, std::vector<int> & touched)
+{
+    int n = (int) emb.inside.size(), stride = emb.stride(), ox = emb.order[0], oy = emb.order[1], oz = emb.order[2];
+    int p, c = 0, moved = 0;
+    std::vector<char> hit(n, 0);
+
+    touched.clear();
+    if(!matches(emb))
+    {
+        cerr << "Error ffd::updateEmbedded(): lattice has changed shape since the points were embedded" << endl;
+        return 0;
+    }
+
+    for(int i = 0; i < dimx; i++)
+        for(int j = 0; j < dimy; j++)
+            for(int k = 0; k < dimz; k++, c++)
+            {
+                cgp::Vector delta;
+                delta.diff(emb.applied[c], cp[c]);
+                if(delta.i == 0.0f && delta.j == 0.0f && delta.k == 0.0f)
+                    continue;
+                moved++;
+
+                // skip points outside the support of the control point, which for Bezier bases are only those
+                // pinned to the lattice faces by a zero weight
+                #pragma omp parallel for if(n > 65536)
+                for(p = 0; p < n; p++)
+                {
+                    const int * f = &emb.first[3 * p];
+                    int a = i - f[0], b = j - f[1], d = k - f[2];
+                    if(a < 0 || a >= ox || b < 0 || b >= oy || d < 0 || d >= oz)
+                        continue;
+                    const float * bs = &emb.weights[(long) p * (long) stride];
+                    float wgt = bs[a] * bs[ox + b] * bs[ox + oy + d];
+                    if(wgt != 0.0f)
+                    {
+                        cgp::Point & q = out[emb.inside[p]];
+                        q.x += wgt * delta.i; q.y += wgt * delta.j; q.z += wgt * delta.k;
+                        hit[p] = 1;
+                    }
+                }
+                emb.applied[c] = cp[c];
+            }
+
+    for(p = 0; p < n; p++)
+        if(hit[p])
+            touched.push_back(emb.inside[p]);
+    return moved;
+}
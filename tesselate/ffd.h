@@ -3,7 +3,7 @@
 /**
  * @file
  *
- * Free-form Deformation to warp vertices of a mesh. Uses a Bezier basis.
+ * Free-form Deformation to warp vertices of a mesh. Uses a Bezier or cubic B-spline basis.
  */
 
 #include <vector>
@@ -11,20 +11,53 @@
 #include <iostream>
 #include "renderer.h"
 
+/// Basis functions blending the control points of an ffd lattice
+enum class FFDBasis
+{
+    BEZIER,     ///< Bernstein polynomials over the whole lattice, 2 to 4 control points per axis
+    BSPLINE     ///< clamped uniform cubic B-splines, 4 or more control points per axis, each point feeling only 4x4x4 of them
+};
+
+/**
+ * Points embedded in an undeformed ffd lattice. The weight of a control point at a point is the product of one basis
+ * value per axis, so a few values per point stand in for the full set of weights, and since the deformation is linear
+ * in the control points, moving one of them shifts each point by its weight times the displacement.
+ */
+struct FFDEmbedding
+{
+    FFDBasis basis;                 ///< lattice basis when the points were embedded
+    int dim[3];                     ///< lattice dimensions when the points were embedded
+    int order[3];                   ///< basis values per axis that can be nonzero at a point
+    cgp::Point origin;              ///< lattice corner when the points were embedded
+    cgp::Vector diagonal;           ///< lattice extent when the points were embedded
+    std::vector<int> inside;        ///< indices of the points within the lattice, the only ones it deforms
+    std::vector<int> first;         ///< per inside point, index along x, y and z of the first control point it feels
+    std::vector<float> weights;     ///< per inside point, order[0] basis values along x, then order[1] along y and order[2] along z
+    std::vector<cgp::Point> applied;    ///< control points, x-major, that the deformed positions currently reflect
+
+    /// Constructor for an empty embedding
+    FFDEmbedding(){ basis = FFDBasis::BEZIER; dim[0] = dim[1] = dim[2] = 0; order[0] = order[1] = order[2] = 0; }
+
+    /// Number of basis values stored per inside point
+    int stride() const { return order[0] + order[1] + order[2]; }
+};
+
 /**
  * Free-Form Deformation of geometric models. Supports Bezier bases with n=1,2,3
- * that can be set seperately for each dimension.
+ * that can be set seperately for each dimension, and cubic B-spline bases for lattices of any size, where the cost
+ * per point does not grow with the number of control points.
  */
 class ffd
 {
 private:
     cgp::Point origin;      ///< bottom left front corner of lattice
     cgp::Vector diagonal;   ///< diagonal extent of lattice
-    cgp::Point *** cp;      ///< dimx * dimy * dimz lattice of control points
-    bool *** highlight;     ///< highlighting of control points to show selection
+    std::vector<cgp::Point> cp;     ///< dimx * dimy * dimz lattice of control points, x-major, empty if unallocated
+    std::vector<char> highlight;    ///< highlighting of control points to show selection, laid out as cp
     int dimx;               ///< number of control points in x dimension
     int dimy;               ///< number of control points in y dimension
     int dimz;               ///< number of control points in z dimension
+    FFDBasis basistype;     ///< basis functions blending the control points
 
     /// Memory allocation of 3D array
     void alloc();
@@ -32,6 +65,9 @@ private:
     /// Memory deallocation of 3D array
     void dealloc();
 
+    /// Position of control point (i,j,k) in the contiguous arrays
+    int index(int i, int j, int k) const { return (i * dimy + j) * dimz + k; }
+
     /**
      * Check control point access to see if it is out of bounds
      * @param i, j, k   control point index [0..dimx-1,0..dimy-1,0..dimz-1] in lattice
@@ -42,13 +78,32 @@ private:
 
 
     /**
-     * Evaluate a Bernstein polynomial for a given parameter value
-     * @param t     parameter value, in [0,1]
-     * @param i     control point index, in [0,n]
-     * @param n     polynomial degree, in [1,3]
-     * @return evaluated basis function, or 0 if any parameters are set incorrectly
+     * Evaluate every Bernstein polynomial of a degree at once, by the de Casteljau recurrence
+     * @param t         parameter value, in [0,1]
+     * @param n         polynomial degree
+     * @param[out] b    n+1 basis values
+     */
+    void basisAll(float t, int n, float * b);
+
+    /**
+     * Evaluate the basis functions along one axis that can be nonzero at a parameter value
+     * @param t         parameter value, in [0,1]
+     * @param n         number of control points along the axis
+     * @param[out] b    basis values, as many as @ref order gives
+     * @returns index of the control point the first basis value belongs to
+     */
+    int axisBasis(float t, int n, float * b);
+
+    /// Number of basis functions along an axis with n control points that can be nonzero at once
+    int order(int n){ return basistype == FFDBasis::BSPLINE ? 4 : n; }
+
+    /**
+     * Parameter value at which a control point has most influence, its Greville abscissa, at which it is placed in
+     * the undeformed lattice
+     * @param i     control point index along the axis
+     * @param n     number of control points along the axis
      */
-    float basis(float t, int i, int n);
+    float greville(int i, int n);
 
 public:
 
@@ -60,11 +115,12 @@ public:
 
     /**
      * Create FFD lattice with specified dimensions
-     * @param xnum, ynum, znum  number of control point in x, y, z dimensions (2-4)
+     * @param xnum, ynum, znum  number of control point in x, y, z dimensions (2-4 for Bezier, at least 4 for B-spline)
      * @param corner    origin position of the volume
      * @param diag      diagonal extent of the volume
+     * @param basis     basis functions blending the control points
      */
-    ffd(int xnum, int ynum, int znum, cgp::Point corner, cgp::Vector diag);
+    ffd(int xnum, int ynum, int znum, cgp::Point corner, cgp::Vector diag, FFDBasis basis = FFDBasis::BEZIER);
 
     /// Destructor
     ~ffd(){ dealloc(); }
@@ -87,6 +143,16 @@ public:
      */
     void setDim(int numx, int numy, int numz);
 
+    /// Getter for the basis functions blending the control points
+    FFDBasis getBasis(){ return basistype; }
+
+    /**
+     * Change the basis functions blending the control points, reallocating and resetting the lattice for the current
+     * dimensions, which must suit the new basis
+     * @param basis     Bezier or B-spline
+     */
+    void setBasis(FFDBasis basis);
+
     /**
      * Getter for the placement and dimensions of the lattice in 3d space
      * @param[out] corner    bottom, front, left corner of the lattice
@@ -147,6 +213,40 @@ public:
      * @param[out] pnt  Point undergoing deformation
      */
     void deform(cgp::Point & pnt);
+
+    /**
+     * Apply free-form deformation to many points at once, matching deformation of each in turn up to rounding. Points are
+     * evaluated in SIMD batches spread across threads by a kernel specialised for the degree along each axis.
+     * @param pnts      points to deform
+     * @param[out] out  deformed points, resized to match, and which may be the same vector as pnts
+     */
+    void deform(const std::vector<cgp::Point> & pnts, std::vector<cgp::Point> & out);
+
+    /**
+     * Embed points in the lattice as it is now, recording their basis values and the current control points
+     * @param pnts      undeformed points
+     * @param[out] emb  embedding of the points
+     */
+    void embed(const std::vector<cgp::Point> & pnts, FFDEmbedding & emb);
+
+    /**
+     * Test whether an embedding was made in a lattice with the same dimensions and frame as this one
+     * @param emb   embedding to check
+     * @retval true if the embedding can be updated incrementally,
+     * @retval false if the points must be embedded again
+     */
+    bool matches(const FFDEmbedding & emb);
+
+    /**
+     * Bring deformed points up to date with the current control points by adding the weighted displacement of
+     * each control point that has moved since they were last deformed. The embedding then records the current
+     * control points.
+     * @param emb           embedding of the points
+     * @param[out] out      deformed points, updated in place
+     * @param[out] touched  indices of the points that moved, in increasing order
+     * @returns number of control points that had moved
+     */
+    int updateEmbedded(FFDEmbedding & emb, std::vector<cgp::Point> & out, std::vector<int> & touched);
 };
 
 #endif
\ No newline at end of file
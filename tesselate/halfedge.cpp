@@ -0,0 +1,135 @@
+//
+// HalfEdgeMesh
+//
+
+#include "halfedge.h"
+#include "mesh.h"
+#include "bucketsort.h"
+#include <algorithm>
+
+using namespace std;
+
+HalfEdgeMesh::HalfEdgeMesh()
+{
+    numboundary = numnonmanifold = 0;
+}
+
+void HalfEdgeMesh::clear()
+{
+    vert.clear();
+    twins.clear();
+    vhalf.clear();
+    numboundary = numnonmanifold = 0;
+}
+
+void HalfEdgeMesh::build(const std::vector<Triangle> & tris, int numverts)
+{
+    int nh = (int) tris.size() * 3, h, v;
+    int nbound = 0, nnonman = 0;
+    vector<int> start, bucket;
+
+    vert.resize(nh);
+    twins.assign(nh, -1);
+    #pragma omp parallel for if(nh > 196608)
+    for(h = 0; h < nh; h++)
+        vert[h] = tris[h/3].v[h%3];
+
+    // counting sort of half-edges on their lower endpoint
+    bucketSort(numverts, nh, [this](int e){ return std::min(vert[e], target(e)); }, start, bucket);
+
+    // Within a bucket, half-edges of the same edge become adjacent when ordered by their upper endpoint. An edge
+    // with exactly two oppositely directed half-edges is manifold, and anything else is left unpaired.
+    #pragma omp parallel for if(nh > 196608) schedule(dynamic, 1024) reduction(+:nbound,nnonman)
+    for(v = 0; v < numverts; v++)
+    {
+        int * b0 = bucket.data() + start[v], * b1 = bucket.data() + start[v+1], * run, * end;
+        std::sort(b0, b1, [this](int p, int q)
+        {
+            int mp = std::max(vert[p], target(p)), mq = std::max(vert[q], target(q));
+            return mp < mq || (mp == mq && p < q);
+        });
+        for(run = b0; run < b1; run = end)
+        {
+            int hi = std::max(vert[*run], target(*run));
+            for(end = run + 1; end < b1 && std::max(vert[*end], target(*end)) == hi; end++);
+            if(end - run == 2 && vert[run[0]] == target(run[1]) && vert[run[0]] != target(run[0]))
+            {
+                twins[run[0]] = run[1];
+                twins[run[1]] = run[0];
+            }
+            else if(end - run == 1 && vert[run[0]] != target(run[0]))
+                nbound++;
+            else
+                nnonman += (int) (end - run);
+        }
+    }
+    numboundary = nbound;
+    numnonmanifold = nnonman;
+
+    // prefer a boundary half-edge as the outgoing one, so that forward rotation covers the whole fan
+    vhalf.assign(numverts, -1);
+    for(h = 0; h < nh; h++)
+    {
+        v = vert[h];
+        if(vhalf[v] < 0 || (twins[h] < 0 && twins[vhalf[v]] >= 0))
+            vhalf[v] = h;
+    }
+}
+
+void HalfEdgeMesh::resetOutgoing(int v, int h)
+{
+    int start = h;
+
+    // rotating clockwise is next(twin(h)), which stops at a boundary
+    while(twins[h] >= 0)
+    {
+        h = next(twins[h]);
+        if(h == start)
+            break;
+    }
+    vhalf[v] = h;
+}
+
+bool HalfEdgeMesh::flip(int h, int & t0, int & t1)
+{
+    int g = twins[h], a, b, c, d, ad, db, bc, ca, k;
+
+    if(g < 0)
+        return false;
+    a = vert[h]; b = target(h); c = vert[prev(h)]; d = vert[prev(g)];
+    if(c == d)
+        return false;
+
+    // refuse if c and d are already joined, which would create a doubled edge
+    bool joined = false;
+    forEachOutgoing(c, [&](int o){ if(target(o) == d) joined = true; });
+    forEachOutgoing(d, [&](int o){ if(target(o) == c) joined = true; });
+    if(joined)
+        return false;
+
+    // twins of the four outer edges of the quad a-d-b-c
+    ad = twins[next(g)]; db = twins[prev(g)];
+    bc = twins[next(h)]; ca = twins[prev(h)];
+
+    // rewrite the triangles as (a, d, c) and (d, b, c), reusing the half-edge slots of each face in order
+    t0 = face(h); t1 = face(g);
+    int f0 = t0 * 3, f1 = t1 * 3;
+    vert[f0] = a; vert[f0+1] = d; vert[f0+2] = c;
+    vert[f1] = d; vert[f1+1] = b; vert[f1+2] = c;
+
+    const int outer[4] = {ad, ca, db, bc}, inner[4] = {f0, f0+2, f1, f1+1};
+    for(k = 0; k < 4; k++)
+    {
+        twins[inner[k]] = outer[k];
+        if(outer[k] >= 0)
+            twins[outer[k]] = inner[k];
+    }
+    twins[f0+1] = f1+2; // d->c
+    twins[f1+2] = f0+1; // c->d
+
+    resetOutgoing(a, f0);
+    resetOutgoing(b, f1+1);
+    resetOutgoing(c, f0+2);
+    resetOutgoing(d, f1);
+    return true;
+}
@@ -0,0 +1,119 @@
+#ifndef _HALFEDGE
+#define _HALFEDGE
+/**
+ * @file
+ *
+ * Half-edge connectivity over an indexed triangle list.
+ */
+
+#include <vector>
+
+struct Triangle;
+
+/**
+ * Implicit half-edge structure in the style of a corner table. Half-edge h = 3t + k runs from corner k to corner
+ * (k+1)%3 of triangle t, so face, next and previous are arithmetic and only the twin of each half-edge and one
+ * outgoing half-edge per vertex are stored. Twins are matched without hashing, by a counting sort of half-edges on
+ * their lower endpoint followed by a small sort within each vertex bucket.
+ *
+ * Edges with a single incident half-edge are boundaries. Edges with more than two, or with two running in the same
+ * direction, are non-manifold and their half-edges are also left without twins, so traversal treats them as boundaries.
+ */
+class HalfEdgeMesh
+{
+private:
+    std::vector<int> vert;      ///< origin vertex of each half-edge
+    std::vector<int> twins;     ///< opposite half-edge in the neighbouring triangle, or -1
+    std::vector<int> vhalf;     ///< an outgoing half-edge per vertex, a boundary one where possible, or -1 if unused
+    int numboundary;            ///< number of half-edges on manifold boundaries
+    int numnonmanifold;         ///< number of half-edges on non-manifold or degenerate edges
+
+    /**
+     * Choose the outgoing half-edge of vertex @a v by rotating backwards from @a h until a boundary is found,
+     * so that forward rotation from it covers the whole fan
+     */
+    void resetOutgoing(int v, int h);
+
+public:
+
+    /// Constructor for an empty structure
+    HalfEdgeMesh();
+
+    /**
+     * Build the structure in O(T) from a triangle list
+     * @param tris      triangles with counterclockwise winding
+     * @param numverts  number of vertices indexed by the triangles
+     */
+    void build(const std::vector<Triangle> & tris, int numverts);
+
+    /// Remove all half-edges
+    void clear();
+
+    /// Number of half-edges, three per triangle
+    int numHalfEdges() const { return (int) vert.size(); }
+
+    /// Triangle containing half-edge @a h
+    int face(int h) const { return h / 3; }
+
+    /// Next half-edge around the triangle of @a h
+    int next(int h) const { return (h % 3 == 2) ? h - 2 : h + 1; }
+
+    /// Previous half-edge around the triangle of @a h
+    int prev(int h) const { return (h % 3 == 0) ? h + 2 : h - 1; }
+
+    /// Opposite half-edge of @a h, or -1 on a boundary or non-manifold edge
+    int twin(int h) const { return twins[h]; }
+
+    /// Vertex that @a h leaves
+    int origin(int h) const { return vert[h]; }
+
+    /// Vertex that @a h points to
+    int target(int h) const { return vert[next(h)]; }
+
+    /// Whether @a h has no opposite half-edge
+    bool isBoundary(int h) const { return twins[h] < 0; }
+
+    /// An outgoing half-edge of vertex @a v, which is a boundary half-edge if @a v is on a boundary, or -1 if unused
+    int outgoing(int v) const { return vhalf[v]; }
+
+    /**
+     * Rotate counterclockwise around the origin of @a h
+     * @returns next outgoing half-edge of the same vertex, or -1 on reaching a boundary
+     */
+    int rotate(int h) const { return twins[prev(h)]; }
+
+    /**
+     * Visit the outgoing half-edges of a vertex in counterclockwise order, starting from @ref outgoing
+     * @param v     vertex at the center of the fan
+     * @param fn    callable fn(h) applied to each outgoing half-edge
+     */
+    template<typename Fn> void forEachOutgoing(int v, Fn fn) const
+    {
+        int start = vhalf[v], h = start;
+        while(h >= 0)
+        {
+            fn(h);
+            h = rotate(h);
+            if(h == start)
+                break;
+        }
+    }
+
+    /// Number of half-edges on manifold boundaries, zero for a closed surface
+    int numBoundaryEdges() const { return numboundary; }
+
+    /// Number of half-edges on edges shared by more than two triangles, inconsistently wound or degenerate
+    int numNonManifoldEdges() const { return numnonmanifold; }
+
+    /**
+     * Flip the edge of @a h to join the two opposite vertices of its triangles, keeping all links consistent
+     * @param h     half-edge of the edge to flip
+     * @param[out] t0   first triangle changed, whose vertices are now (origin(h), vertex opposite the twin, opposite vertex)
+     * @param[out] t1   second triangle changed
+     * @retval true  if the edge was flipped,
+     * @retval false if it is a boundary or the flipped edge would duplicate an existing one
+     */
+    bool flip(int h, int & t0, int & t1);
+};
+
+#endif
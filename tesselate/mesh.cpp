@@ -3,6 +3,12 @@
 //
 
 #include "mesh.h"
+#include "weld.h"
+#include "bucketsort.h"
+#include "unionfind.h"
+#include "pointarray.h"
+#include "simplify.h"
+#include "vcache.h"
 #define GLM_ENABLE_EXPERIMENTAL
 #include <stdio.h>
 #include <math.h>
@@ -11,13 +17,22 @@
 #include <fstream>
 #include <math.h>
 #include <list>
-#include <sys/stat.h>
+#include <ctype.h>
+#include <limits.h>
+#include <locale.h>
+#include <algorithm>
 #include <glm/glm.hpp>
 #include <glm/gtx/intersect.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/rotate_vector.hpp>
-#include <unordered_map>
+#include <common/flat_hash_map.h>
+#include <common/mapped_file.h>
+#include <common/rans.h>
+#include <stdint.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 using namespace cgp;
@@ -510,107 +525,87 @@ long Mesh::hashEdge(int v0, int v1)
 
 void Mesh::mergeVerts()
 {
-    vector<cgp::Point> cleanverts;
-    long key;
-    int i, p, hitcount = 0;
-    // use hashmap to quickly look up vertices with the same coordinates
-    std::unordered_map<long, int> idxlookup; // key is concatenation of vertex position, value is index into the cleanverts vector
+    VertexWelder welder;
+    vector<uint32_t> cells(verts.size() * 3);
+    vector<int> remap, leaders;
+    long i, nv = (long) verts.size();
+    int t, p, numclean;
+    float range = 2500.0f, diag;
     cgp::BoundBox bbox;
 
     // construct a bounding box enclosing all vertices
-    for(i = 0; i < (int) verts.size(); i++)
+    for(i = 0; i < nv; i++)
         bbox.includePnt(verts[i]);
+    diag = bbox.diagLen();
 
-    // remove duplicate vertices
-    for(i = 0; i < (int) verts.size(); i++)
+    // discretise vertices exactly as hashVert does, but keep the cell coordinates apart for sorting
+    #pragma omp parallel for if(nv > 65536)
+    for(i = 0; i < nv; i++)
     {
-        key = hashVert(verts[i], bbox);
-        if(idxlookup.find(key) == idxlookup.end()) // key not in map
-        {
-            idxlookup[key] = (int) cleanverts.size(); // put index in map for quick lookup
-            cleanverts.push_back(verts[i]);
-        }
-        else
-        {
-            hitcount++;
-        }
+        cells[i*3] = (uint32_t) (long) (((verts[i].x - bbox.min.x) * range) / diag);
+        cells[i*3+1] = (uint32_t) (long) (((verts[i].y - bbox.min.y) * range) / diag);
+        cells[i*3+2] = (uint32_t) (long) (((verts[i].z - bbox.min.z) * range) / diag);
     }
 
-    /*
-    cerr << "clean verts:" << endl;
-    for(i = 0; i < (int) cleanverts.size(); i++)
-        cerr << cleanverts[i].x << " " << cleanverts[i].y << " " << cleanverts[i].z << endl;*/
-    cerr << "num duplicate vertices found = " << hitcount << " of " << (int) verts.size() << endl;
-    cerr << "clean verts = " << (int) cleanverts.size() << endl;
+    // remove duplicate vertices
+    numclean = welder.weldCells(cells, remap, leaders);
+
+    cerr << "num duplicate vertices found = " << nv - numclean << " of " << (int) nv << endl;
+    cerr << "clean verts = " << numclean << endl;
     cerr << "bbox min = " << bbox.min.x << ", " << bbox.min.y << ", " << bbox.min.z << endl;
     cerr << "bbox max = " << bbox.max.x << ", " << bbox.max.y << ", " << bbox.max.z << endl;
     cerr << "bbox diag = " << bbox.diagLen() << endl;
 
-
     // re-index triangles
-    for(i = 0; i < (int) tris.size(); i++)
+    #pragma omp parallel for if(tris.size() > 65536) private(p)
+    for(t = 0; t < (int) tris.size(); t++)
         for(p = 0; p < 3; p++)
-        {
-            key = hashVert(verts[tris[i].v[p]], bbox);
-            if(idxlookup.find(key) != idxlookup.end())
-                tris[i].v[p] = idxlookup[key];
-            else
-                cerr << "Error Mesh::mergeVerts: vertex not found in map" << endl;
-
-        }
+            tris[t].v[p] = remap[tris[t].v[p]];
+    topologyChanged();
 
-    verts.clear();
-    verts = cleanverts;
+    vector<cgp::Point> cleanverts(numclean);
+    for(i = 0; i < numclean; i++)
+        cleanverts[i] = verts[leaders[i]];
+    verts.swap(cleanverts);
 }
 
-void Mesh::deriveVertNorms()
+void Mesh::weldVerts(float tolerance)
 {
-    vector<int> vinc; // number of faces incident on vertex
-    int p, t;
-    cgp::Vector n;
+    VertexWelder welder(tolerance);
+    vector<int> remap;
+    vector<cgp::Point> welded;
+    vector<cgp::Vector> weldnorms;
+    int t, p, v, numwelded;
 
-    // init structures
-    for(p = 0; p < (int) verts.size(); p++)
-    {
-        vinc.push_back(0);
-        norms.push_back(cgp::Vector(0.0f, 0.0f, 0.0f));
-    }
+    numwelded = welder.weld(verts, remap, welded);
+    cerr << "num duplicate vertices found = " << (int) verts.size() - numwelded << " of " << (int) verts.size() << endl;
 
-    // accumulate face normals into vertex normals
+    // re-index triangles
+    #pragma omp parallel for if(tris.size() > 65536) private(p)
     for(t = 0; t < (int) tris.size(); t++)
-    {
-        n = tris[t].n; n.normalize();
         for(p = 0; p < 3; p++)
-        {
-            norms[tris[t].v[p]].add(n);
-            vinc[tris[t].v[p]]++;
-        }
-    }
+            tris[t].v[p] = remap[tris[t].v[p]];
+    topologyChanged();
 
-    // complete average
-    for(p = 0; p < (int) verts.size(); p++)
+    // a welded vertex keeps the normal of its first occurrence
+    if(norms.size() == verts.size())
     {
-        norms[p].mult(1.0f/((float) vinc[p]));
-        norms[p].normalize();
+        weldnorms.resize(numwelded);
+        for(v = (int) verts.size() - 1; v >= 0; v--)
+            weldnorms[remap[v]] = norms[v];
+        norms.swap(weldnorms);
     }
+    verts.swap(welded);
 }
 
-void Mesh::deriveFaceNorms()
+void Mesh::deriveVertNorms()
 {
-    int t;
-    cgp::Vector evec[2];
-
-    for(t = 0; t < (int) tris.size(); t++)
-    {
-        // right-hand rule for calculating normals, i.e. counter-clockwise winding from front on vertices
-        evec[0].diff(verts[tris[t].v[0]], verts[tris[t].v[1]]);
-        evec[1].diff(verts[tris[t].v[0]], verts[tris[t].v[2]]);
-        evec[0].normalize();
-        evec[1].normalize();
-        tris[t].n.cross(evec[0], evec[1]);
-        tris[t].n.normalize();
-    }
+    normalengine.vertexNormals(verts, tris, getAdjacency(), norms);
+}
 
+void Mesh::deriveFaceNorms()
+{
+    normalengine.faceNormals(verts, tris);
 }
 
 void Mesh::buildTransform(glm::mat4x4 &tfm)
@@ -812,6 +807,8 @@ void Mesh::buildSphereAccel(int maxspheres)
 
 Mesh::Mesh()
 {
+    topologyChanged();
+    ffdlattice = NULL;
     col = stdCol;
     scale = 1.0f;
     xrot = yrot = zrot = 0.0f;
@@ -827,6 +824,7 @@ void Mesh::clear()
 {
     verts.clear();
     tris.clear();
+    topologyChanged();
     geometry.clear();
     col = stdCol;
     scale = 1.0f;
@@ -836,7 +834,12 @@ void Mesh::clear()
 
 void Mesh::genGeometry(ShapeGeometry * geom, View * view)
 {
-    vector<int> faces;
+    genGeometry(geom, view, glm::mat4(1.0f));
+}
+
+void Mesh::genGeometry(ShapeGeometry * geom, View * view, const glm::mat4x4 & placement)
+{
+    vector<int> faces((int) tris.size() * 3);
     int t, p;
     glm::mat4x4 tfm;
 
@@ -844,11 +847,11 @@ void Mesh::genGeometry(ShapeGeometry * geom, View * view)
     // by flattening the triangle list
     for(t = 0; t < (int) tris.size(); t++)
         for(p = 0; p < 3; p++)
-            faces.push_back(tris[t].v[p]);
+            faces[t*3+p] = tris[t].v[p];
 
     // construct transformation matrix
     buildTransform(tfm);
-    geom->genMesh(&verts, &norms, &faces, tfm);
+    geom->genMesh(&verts, &norms, &faces, placement * tfm);
 }
 
 bool Mesh::bindGeometry(View * view, ShapeDrawData &sdd)
@@ -940,24 +943,10 @@ bool Mesh::pointContainment(cgp::Point pnt)
                 }
             }
         }
-        else // no acceleration structure so test against all triangles
+        else // cast along +x through the triangle hierarchy, which skips every triangle whose bounds the ray misses
         {
-            for(t = 0; t < (int) tris.size(); t++)
-            {
-                for(p = 0; p < 3; p++)
-                {
-                    vert = verts[tris[t].v[p]];
-                    vxfm = tfm * glm::vec4(vert.x, vert.y, vert.z, 1.0f);
-                    v[p] = glm::vec3(vxfm.x, vxfm.y, vxfm.z);
-                }
-                ray[0] = 1.0f; ray[1] = 0.0f; ray[2] = 0.0f;
-                if(glm::intersectRayTriangle(origin, ray, v[0], v[1], v[2], xsect, d)) // || glm::intersectRayTriangle(origin, ray, v[0], v[2], v[1], xsect, d)) // test triangle in both windings because intersectLineTriangle is winding dependent
-                {
-                    if(d > 0.0f)
-                        hits++;
-                }
-
-            }
+            updateBVH(tfm);
+            hits = bvh.crossings(pnt);
         }
 
         if(hits%2 == 0) // even number of intersection means point is outside
@@ -970,17 +959,55 @@ bool Mesh::pointContainment(cgp::Point pnt)
     return (incount > outcount);
 }
 
+void Mesh::getWorldTriangles(std::vector<float> & packed)
+{
+    PointArray world;
+    glm::mat4x4 tfm;
+    int t, nt = (int) tris.size();
+
+    buildTransform(tfm);
+    world.load(verts);
+    world.transform(tfm);
+    packed.resize(9 * (long) nt);
+    #pragma omp parallel for if(nt > 65536)
+    for(t = 0; t < nt; t++)
+        for(int p = 0; p < 3; p++)
+        {
+            int v = tris[t].v[p];
+            packed[9 * (long) t + 3 * p] = world.x[v];
+            packed[9 * (long) t + 3 * p + 1] = world.y[v];
+            packed[9 * (long) t + 3 * p + 2] = world.z[v];
+        }
+}
+
+void Mesh::updateBVH(const glm::mat4x4 & tfm)
+{
+    PointArray world;
+
+    // checked again inside the critical section, since another thread may have rebuilt it while this one waited
+    if(bvh.ready())
+        return;
+    #pragma omp critical(meshbvh)
+    {
+        if(!bvh.ready())
+        {
+            world.load(verts);
+            world.transform(tfm);
+            bvh.build(world, tris);
+        }
+    }
+}
+
 void Mesh::boxFit(float sidelen)
 {
-    cgp::Point pnt;
     cgp::Vector shift, diag, halfdiag;
     float scale;
-    int v;
     cgp::BoundBox bbox;
+    PointArray pnts;
 
     // calculate current bounding box
-    for(v = 0; v < (int) verts.size(); v++)
-        bbox.includePnt(verts[v]);
+    pnts.load(verts);
+    bbox = pnts.bounds();
 
     cerr << "numverts = " << (int) verts.size() << endl;
     if((int) verts.size() > 0)
@@ -1002,14 +1029,10 @@ void Mesh::boxFit(float sidelen)
             scale = sidelen / scale;
 
             // shift center to origin and scale uniformly
-            for(v = 0; v < (int) verts.size(); v++)
-            {
-                pnt = verts[v];
-                shift.pntplusvec(pnt, &pnt);
-                pnt.x *= scale; pnt.y *= scale; pnt.z *= scale;
-                verts[v] = pnt;
-                cerr << "pnt " << v << " = " << pnt.x << " " << pnt.y << " " << pnt.z << endl;
-            }
+            pnts.translateScale(shift, scale);
+            pnts.store(verts);
+            ffdvalid = false;
+            bvh.invalidate();
         }
         // buildSphereAccel((int) sphperdim);
     }
@@ -1073,261 +1096,1666 @@ void Mesh::marchingCubes(VoxelVolume * vox)
     deriveVertNorms();
 
     // create base copy of mesh to support deformation
-    base.resize((int) verts.size());
-    for(int v = 0; v < (int) verts.size(); v++)
-        base[v] = verts[v];
+    setBase();
 }
 
-void Mesh::laplacianSmooth(int iter, float rate)
+/// Bits of packed word @a w covering columns [c0, c1), with column c in bit 31 - c % 32 of word c / 32
+static inline uint32_t columnMask(int w, int c0, int c1)
 {
-    vector<vector<int>> adj;
-    vector<int> emptyadj;
-    vector<Vector> del;
-    float norm;
-    cgp::Vector delvec, adjvec;
-    int i, v, t, a, p;
+    int l0 = max(c0 - 32 * w, 0), l1 = min(c1 - 32 * w, 32);
 
-    // build an adjacency list for vertices
-    // assumes a two-manifold without boundary because it uses triangle winding to ensure that duplicate entries are not added
-    for(v = 0; v < (int) verts.size(); v++)
-        adj.push_back(emptyadj);
-    for(t = 0; t < (int) tris.size(); t++)
-        for(p = 0; p < 3; p++)
-            adj[tris[t].v[p]].push_back(tris[t].v[(p+1)%3]); // forward edge adjacency
+    if(l0 >= l1)
+        return 0;
+    return (0xffffffffu >> l0) & (l1 == 32 ? 0xffffffffu : ~(0xffffffffu >> l1));
+}
 
-    for(i = 0; i < iter; i++)
+/**
+ * Cover the set bits of a packed 2D grid with maximal rectangles, growing each along a row and then down the rows,
+ * clearing the grid as it goes
+ * @param grid      rows of @a span words each
+ * @param nrows     number of rows
+ * @param span      words per row
+ * @param[out] rects    appended with the row and column ranges r0, r1, c0, c1 of each rectangle
+ */
+static void greedyRects(vector<uint32_t> & grid, int nrows, int span, vector<int> & rects)
+{
+    int r, r1, w, c0, c1;
+
+    for(r = 0; r < nrows; r++)
     {
-        del.clear();
-        for(v = 0; v < (int) verts.size(); v++)
-        {
-            delvec = Vector(0.0f, 0.0f, 0.0f);
-            // delvec = sum_j (x_j - x_i) / numadj
-            // new position relies on weighted sum of one ring neighbours of vertex
-            for(a = 0; a < (int) adj[v].size(); a++)
+        uint32_t * row = &grid[r * span];
+        for(w = 0; w < span; w++)
+            while(row[w])
             {
-                adjvec.diff(verts[v], verts[(adj[v])[a]]);
-                delvec.add(adjvec);
-            }
-            norm =  rate / (float) adj[v].size();
-            delvec.mult(norm);
-            del.push_back(delvec);
-        }
+                for(c0 = 32 * w; !(row[w] & (0x80000000u >> (c0 % 32))); c0++);
+                for(c1 = c0 + 1; c1 < 32 * span && (row[c1 / 32] & (0x80000000u >> (c1 % 32))); c1++);
 
-        // apply Laplacian
-        for(v = 0; v < (int) verts.size(); v++)
-            del[v].pntplusvec(verts[v], &verts[v]);
+                // a lower row can join only if it covers the whole column range
+                for(r1 = r + 1; r1 < nrows; r1++)
+                {
+                    const uint32_t * next = &grid[r1 * span];
+                    bool full = true;
+                    for(int k = c0 / 32; k <= (c1 - 1) / 32 && full; k++)
+                    {
+                        uint32_t m = columnMask(k, c0, c1);
+                        full = (next[k] & m) == m;
+                    }
+                    if(!full)
+                        break;
+                }
+                for(int rr = r; rr < r1; rr++)
+                    for(int k = c0 / 32; k <= (c1 - 1) / 32; k++)
+                        grid[rr * span + k] &= ~columnMask(k, c0, c1);
+                rects.push_back(r); rects.push_back(r1); rects.push_back(c0); rects.push_back(c1);
+            }
     }
-    deriveFaceNorms();
-    deriveVertNorms();
-
-    // create base copy of mesh to support deformation
-    base.resize((int) verts.size());
-    for(v = 0; v < (int) verts.size(); v++)
-        base[v] = verts[v];
 }
 
-void Mesh::applyFFD(ffd * lat)
+void Mesh::greedyMesh(VoxelVolume * vox)
 {
-    for(int v = 0; v < (int) verts.size(); v++)
+    int dim[3], xspan, y, z, d, s, k, i, w;
+    cgp::Point origin;
+    cgp::Vector diag;
+    vector<int> rects, quads; // quads hold normal axis, side, plane and the rectangle, 7 values each
+    vector<uint32_t> grid;
+
+    vox->getDim(dim[0], dim[1], dim[2]);
+    vox->getFrame(origin, diag);
+    xspan = vox->getXSpan();
+    clear();
+    float cell[3] = {diag.i / (float) dim[0], diag.j / (float) dim[1], diag.k / (float) dim[2]};
+
+    // occupancy row of (y, z), empty outside the volume
+    vector<uint32_t> empty(xspan, 0);
+    auto row = [&](int ry, int rz) -> const uint32_t *
     {
-        verts[v] = base[v];
-        lat->deform(verts[v]);
-    }
-    deriveFaceNorms();
-    deriveVertNorms();
-}
+        if(ry < 0 || ry >= dim[1] || rz < 0 || rz >= dim[2])
+            return empty.data();
+        return (const uint32_t *) vox->getRow(ry, rz);
+    };
+
+    // faces whose normals lie along x compare neighbouring bits within a row, so find them once for every row
+    vector<uint32_t> xexposed[2];
+    for(s = 0; s < 2; s++)
+        xexposed[s].resize((size_t) xspan * dim[1] * dim[2]);
+    for(z = 0; z < dim[2]; z++)
+        for(y = 0; y < dim[1]; y++)
+        {
+            const uint32_t * occ = row(y, z);
+            uint32_t * neg = &xexposed[0][(z * dim[1] + y) * xspan], * pos = &xexposed[1][(z * dim[1] + y) * xspan];
+            for(w = 0; w < xspan; w++)
+            {
+                uint32_t right = (occ[w] << 1) | (w + 1 < xspan ? occ[w+1] >> 31 : 0);
+                uint32_t left = (occ[w] >> 1) | (w > 0 ? occ[w-1] << 31 : 0);
+                pos[w] = occ[w] & ~right;
+                neg[w] = occ[w] & ~left;
+            }
+        }
 
-bool Mesh::readSTL(string filename)
-{
-    ifstream infile;
-	char * inbuffer;
-    struct stat results;
-    int insize, inpos, numt, t, i;
-    cgp::Point vpos;
-    Triangle tri;
+    for(d = 0; d < 3; d++)
+        for(s = 0; s < 2; s++)
+            for(k = 0; k < dim[d]; k++)
+            {
+                // exposed faces of slice k as a packed grid, columns along x for z and y normals, along y otherwise
+                int nrows = d == 2 ? dim[1] : dim[2], ncols = d == 0 ? dim[1] : dim[0], span = (ncols + 31) / 32;
+                int step = s ? 1 : -1;
+                grid.assign((size_t) nrows * span, 0);
+                for(i = 0; i < nrows; i++)
+                {
+                    uint32_t * out = &grid[i * span];
+                    if(d == 0)
+                    {
+                        const uint32_t * src = &xexposed[s][(size_t) i * dim[1] * xspan];
+                        for(y = 0; y < dim[1]; y++)
+                            if(src[y * xspan + k / 32] & (0x80000000u >> (k % 32)))
+                                out[y / 32] |= 0x80000000u >> (y % 32);
+                    }
+                    else
+                    {
+                        const uint32_t * occ = d == 1 ? row(k, i) : row(i, k);
+                        const uint32_t * nbr = d == 1 ? row(k + step, i) : row(i, k + step);
+                        for(w = 0; w < span; w++)
+                            out[w] = occ[w] & ~nbr[w];
+                    }
+                }
+                rects.clear();
+                greedyRects(grid, nrows, span, rects);
+                for(i = 0; i < (int) rects.size(); i += 4)
+                {
+                    quads.push_back(d); quads.push_back(s); quads.push_back(k + s);
+                    quads.insert(quads.end(), rects.begin() + i, rects.begin() + i + 4);
+                }
+            }
 
-    // assumes binary format STL file
-    infile.open((char *) filename.c_str(), ios_base::in | ios_base::binary);
-	if(infile.is_open())
-	{
-        clear();
+    // one vertex per distinct rectangle corner on the lattice of voxel corners
+    uts::flat_hash_map<long, int> lookup;
+    auto key = [&](const int * p){ return ((long) p[0] * (dim[1] + 1) + p[1]) * (dim[2] + 1) + p[2]; };
+    vector<int> loop, looppos, next, prev;
+    Triangle tri;
+    int nquads = (int) quads.size() / 7;
+    vector<int> corners(nquads * 12);
 
-		// get the size of the file
-		stat((char *) filename.c_str(), &results);
-		insize = results.st_size;
-
-		// put file contents in buffer
-		inbuffer = new char[insize];
-		infile.read(inbuffer, insize);
-		if(!infile) // failed to read from the file for some reason
-		{
-            cerr << "Error Mesh::readSTL: unable to populate read buffer" << endl;
-			return false;
-		}
-
-		// interpret buffer as STL file
-        if(insize <= 84)
+    for(i = 0; i < nquads; i++)
+    {
+        const int * q = &quads[7 * i];
+        int nd = q[0], ca = q[0] == 0 ? 1 : 0, ra = q[0] == 2 ? 1 : 2;
+        int cs[4] = {q[5], q[6], q[6], q[5]}, rs[4] = {q[3], q[3], q[4], q[4]};
+        // corners run anticlockwise about the column axis crossed with the row axis, which is -y for y normals
+        bool reverse = (nd == 1) == (q[1] == 1);
+        for(int c = 0; c < 4; c++)
         {
-            cerr << "Error Mesh::readSTL: invalid STL binary file, too small" << endl;
-            return false;
+            int * p = &corners[12 * i + 3 * c], cc = reverse ? 3 - c : c;
+            p[nd] = q[2]; p[ca] = cs[cc]; p[ra] = rs[cc];
+            auto found = lookup.emplace(key(p), (int) verts.size());
+            if(found.second)
+                verts.push_back(cgp::Point(origin.x + p[0] * cell[0], origin.y + p[1] * cell[1], origin.z + p[2] * cell[2]));
         }
+    }
 
-        inpos = 80; // skip 80 character header
-        if(inpos+4 >= insize){ cerr << "Error Mesh::readSTL: malformed header on stl file" << endl; return false; }
-        numt = (int) (* ((long *) &inbuffer[inpos]));
-        inpos += 4;
-
-        t = 0;
+    for(i = 0; i < nquads; i++)
+    {
+        const int * q = &quads[7 * i];
+        int nd = q[0], sign = q[1] ? 1 : -1, c, n;
 
-        // triangle vertices have consistent outward facing clockwise winding (right hand rule)
-        while(t < numt) // read in triangle data
+        // walk each edge a lattice step at a time, picking up the corners of other rectangles
+        loop.clear();
+        looppos.clear();
+        for(c = 0; c < 4; c++)
         {
-            // normal
-            if(inpos+12 >= insize){ cerr << "Error Mesh::readSTL: malformed stl file" << endl; return false; }
-            // IEEE floating point 4-byte binary numerical representation, IEEE754, little endian
-            tri.n = cgp::Vector((* ((float *) &inbuffer[inpos])), (* ((float *) &inbuffer[inpos+4])), (* ((float *) &inbuffer[inpos+8])));
-            inpos += 12;
+            const int * p0 = &corners[12 * i + 3 * c], * p1 = &corners[12 * i + 3 * ((c + 1) % 4)];
+            int p[3] = {p0[0], p0[1], p0[2]}, axis = p0[0] != p1[0] ? 0 : (p0[1] != p1[1] ? 1 : 2);
+            int dir = p1[axis] > p0[axis] ? 1 : -1;
 
-            // vertices
-            for(i = 0; i < 3; i++)
+            loop.push_back(lookup[key(p)]);
+            looppos.insert(looppos.end(), p, p + 3);
+            for(p[axis] += dir; p[axis] != p1[axis]; p[axis] += dir)
             {
-                if(inpos+12 >= insize){ cerr << "Error Mesh::readSTL: malformed stl file" << endl; return false; }
-                vpos = cgp::Point((* ((float *) &inbuffer[inpos])), (* ((float *) &inbuffer[inpos+4])), (* ((float *) &inbuffer[inpos+8])));
-                tri.v[i] = (int) verts.size();
-                verts.push_back(vpos);
-                inpos += 12;
+                auto found = lookup.find(key(p));
+                if(found != lookup.end())
+                {
+                    loop.push_back(found->second);
+                    looppos.insert(looppos.end(), p, p + 3);
+                }
             }
-            tris.push_back(tri);
-            t++;
-            inpos += 2; // handle attribute byte count - which can simply be discarded
         }
 
-        // tidy up
-		delete inbuffer;
-		infile.close();
+        // the loop is convex but may have many vertices in a line. Any vertex where it turns is an ear, provided the
+        // chord that cuts it off does not run along a line of other vertices, so clipping such ears triangulates it
+        // without degenerate triangles or extra vertices
+        n = (int) loop.size();
+        next.resize(n);
+        prev.resize(n);
+        for(k = 0; k < n; k++)
+        {
+            next[k] = (k + 1) % n;
+            prev[k] = (k + n - 1) % n;
+        }
+        auto turns = [&](int a, int b, int e)
+        {
+            const int * pa = &looppos[3 * a], * pb = &looppos[3 * b], * pe = &looppos[3 * e];
+            int u0 = pb[0] - pa[0], u1 = pb[1] - pa[1], u2 = pb[2] - pa[2], v0 = pe[0] - pb[0], v1 = pe[1] - pb[1], v2 = pe[2] - pb[2];
+            return sign * (nd == 0 ? u1 * v2 - u2 * v1 : (nd == 1 ? u2 * v0 - u0 * v2 : u0 * v1 - u1 * v0)) > 0;
+        };
+        for(k = 0, w = 0; n > 3 && w < 2 * n; )
+        {
+            int a = prev[k], e = next[k];
+            // should a full lap pass without a clean ear, settle for any corner so the loop always terminates
+            if(turns(a, k, e) && (w >= n || (turns(prev[a], a, e) && turns(a, e, next[e]))))
+            {
+                w = 0;
+                tri.v[0] = loop[a]; tri.v[1] = loop[k]; tri.v[2] = loop[e];
+                tris.push_back(tri);
+                next[a] = e;
+                prev[e] = a;
+                k = a;
+                n--;
+            }
+            else
+            {
+                k = e;
+                w++;
+            }
+        }
+        tri.v[0] = loop[prev[k]]; tri.v[1] = loop[k]; tri.v[2] = loop[next[k]];
+        tris.push_back(tri);
+    }
 
-        cerr << "num vertices = " << (int) verts.size() << endl;
-        cerr << "num triangles = " << (int) tris.size() << endl;
+    deriveFaceNorms();
+    deriveVertNorms();
 
-        // STL provides a triangle soup so merge vertices that are coincident
-        mergeVerts();
-        // normal vectors at vertices are needed for rendering so derive from incident faces
-        deriveVertNorms();
-        if(basicValidity())
-            cerr << "loaded file has basic validity" << endl;
-        else
-            cerr << "loaded file does not pass basic validity" << endl;
+    // create base copy of mesh to support deformation
+    setBase();
+}
+
+/**
+ * Distinct vertices sharing an edge with a vertex, in increasing order
+ * @param tris      triangles of the mesh
+ * @param adj       adjacency whose vertex to triangle lists are complete
+ * @param v         center vertex
+ * @param[out] ring neighbours of v
+ */
+static void gatherRing(const vector<Triangle> & tris, const MeshAdjacency & adj, int v, vector<int> & ring)
+{
+    int a, b, k;
+
+    ring.clear();
+    for(a = adj.vtstart[v]; a < adj.vtstart[v+1]; a++)
+    {
+        const int * tv = tris[adj.vtris[a]].v;
+        for(k = 0; k < 2 && tv[k] != v; k++);
+        ring.push_back(tv[(k+1)%3]);
+        ring.push_back(tv[(k+2)%3]);
     }
-    else
+    // small rings are ordered faster by insertion than by a general sort
+    for(a = 1; a < (int) ring.size(); a++)
     {
-        cerr << "Error Mesh::readSTL: unable to open " << filename << endl;
-        return false;
+        int w = ring[a];
+        for(b = a; b > 0 && ring[b-1] > w; b--)
+            ring[b] = ring[b-1];
+        ring[b] = w;
     }
-    return true;
-
+    ring.erase(std::unique(ring.begin(), ring.end()), ring.end());
+    // a degenerate triangle can list the vertex itself
+    auto self = std::lower_bound(ring.begin(), ring.end(), v);
+    if(self != ring.end() && *self == v)
+        ring.erase(self);
 }
 
-bool Mesh::writeSTL(string filename)
+void Mesh::buildAdjacency()
 {
-    ofstream outfile;
-    int t, p, numt;
-    unsigned short val;
+    int nv = (int) verts.size(), nt = (int) tris.size(), v, a;
 
-    outfile.open((char *) filename.c_str(), ios_base::out | ios_base::binary);
-	if(outfile.is_open())
-	{
-        outfile.write("File Generated by Tesselator. Binary STL", 80); // skippable header
-        numt = (int) tris.size();
-        outfile.write((char *) &numt, 4); // number of triangles
+    // counting sort of triangle corners by vertex, which leaves each vertex's triangles in increasing order
+    bucketSort(nv, nt * 3, [this](int c){ return tris[c/3].v[c%3]; }, adjacency.vtstart, adjacency.vtris);
+    #pragma omp parallel for if(nt > 65536)
+    for(a = 0; a < nt * 3; a++)
+        adjacency.vtris[a] /= 3;
 
-        for(t = 0; t < numt; t++)
+    // size the one-rings and then fill them, rather than staging them in a buffer as large as the triangle lists
+    adjacency.vvstart.assign(nv+1, 0);
+    #pragma omp parallel if(nt > 65536)
+    {
+        vector<int> ring;
+        #pragma omp for schedule(dynamic, 1024)
+        for(v = 0; v < nv; v++)
         {
-            // normal
-            outfile.write((char *) &tris[t].n.i, 4);
-            outfile.write((char *) &tris[t].n.j, 4);
-            outfile.write((char *) &tris[t].n.k, 4);
-
-            // triangle vertices
-            for(p = 0; p < 3; p++)
-            {
-                outfile.write((char *) &verts[tris[t].v[p]].x, 4);
-                outfile.write((char *) &verts[tris[t].v[p]].y, 4);
-                outfile.write((char *) &verts[tris[t].v[p]].z, 4);
-            }
-
-            // attribute byte count - null
-            val = 0;
-            outfile.write((char *) &val, 2);
+            gatherRing(tris, adjacency, v, ring);
+            adjacency.vvstart[v+1] = (int) ring.size();
         }
-
-        // tidy up
-		outfile.close();
     }
-    else
+    for(v = 0; v < nv; v++)
+        adjacency.vvstart[v+1] += adjacency.vvstart[v];
+    adjacency.vverts.resize(adjacency.vvstart[nv]);
+    #pragma omp parallel if(nt > 65536)
     {
-        cerr << "Error Mesh::writeSTL: unable to open " << filename << endl;
-        return false;
+        vector<int> ring;
+        #pragma omp for schedule(dynamic, 1024)
+        for(v = 0; v < nv; v++)
+        {
+            gatherRing(tris, adjacency, v, ring);
+            std::copy(ring.begin(), ring.end(), adjacency.vverts.begin() + adjacency.vvstart[v]);
+        }
     }
-    return true;
+    adjvalid = true;
 }
 
-void Mesh::readGrid(vector<vector<vector<int>>> &voxelgrid, string filename, int len)
+const MeshAdjacency & Mesh::getAdjacency()
 {
-    ifstream infile;
-    infile.open(filename, ios::in);
-    string line;
-    //int oneCount = 0;
-    //vector<vector<vector<int>>> voxelgrid;
-    voxelgrid.resize(len);
-    //cout << "size of voxelgrid: " << voxelgrid.size() << endl;
-    for (int z = 0; z < len; z++) {
-        voxelgrid[z].resize(len);
-        //cout << "size of voxelgrid[" << z << "]: " << voxelgrid[z].size() << endl;
-        getline(infile, line);
-        //cout << "line: " << line;
-        for (int y = 0; y < len; y++) {
-            voxelgrid[z][y].resize(len);
-            for (int x = 0; x < len; x++) {
-                voxelgrid[x][y][z] = stoi(line.substr(x, 1));
-            }
-            if (y < (len-1))
-                line = line.substr(line.find(",")+1);
-        }
-    }
-    //outfile << finalGrid;
-
-    infile.close();
+    // a change in size also catches edits through getCubeTriangles pointers held across calls
+    if(!adjvalid || (int) adjacency.vtstart.size() != (int) verts.size() + 1 || adjacency.vtstart.back() != (int) tris.size() * 3)
+        buildAdjacency();
+    return adjacency;
 }
 
-bool Mesh::writeGrid(vector<vector<vector<int>>> &voxelgrid, string outfilename, int len)
+const HalfEdgeMesh & Mesh::getHalfEdges()
 {
-    ofstream outfile;
-    outfile.open(outfilename, ios::out);
-    string finalGrid = "";
-    for (int z = 0; z < len; z++) {
-
-        for (int y = 0; y < len; y++) {
-            for (int x = 0; x < len; x++)
-                finalGrid += to_string(voxelgrid[x][y][z]);
-            if (y < (len-1))
-                finalGrid += ",";
-        }
-        if (z < (len-1))
-            finalGrid += "\n";
+    if(!hevalid || halfedges.numHalfEdges() != (int) tris.size() * 3)
+    {
+        halfedges.build(tris, (int) verts.size());
+        hevalid = true;
     }
+    return halfedges;
+}
 
-    outfile << finalGrid;
+bool Mesh::flipEdge(int h)
+{
+    int f[2], k, p;
+    cgp::Vector evec[2];
+    std::vector<int> ring;
 
-    outfile.close();
+    getHalfEdges();
+    if(h < 0 || h >= halfedges.numHalfEdges() || !halfedges.flip(h, f[0], f[1]))
+        return false;
+
+    for(k = 0; k < 2; k++)
+    {
+        for(p = 0; p < 3; p++)
+            tris[f[k]].v[p] = halfedges.origin(f[k] * 3 + p);
+        // as in deriveFaceNorms
+        evec[0].diff(verts[tris[f[k]].v[0]], verts[tris[f[k]].v[1]]);
+        evec[1].diff(verts[tris[f[k]].v[0]], verts[tris[f[k]].v[2]]);
+        evec[0].normalize();
+        evec[1].normalize();
+        tris[f[k]].n.cross(evec[0], evec[1]);
+        tris[f[k]].n.normalize();
+    }
+    adjvalid = false; // the CSR adjacency cannot be patched in place
+    bvh.invalidate();
 
+    // the two faces span the four vertices of the quad, each of which gains or loses a face, as in applyFFD
+    if(norms.size() == verts.size())
+    {
+        for(k = 0; k < 2; k++)
+            for(p = 0; p < 3; p++)
+                if(std::find(ring.begin(), ring.end(), tris[f[k]].v[p]) == ring.end())
+                    ring.push_back(tris[f[k]].v[p]);
+        normalengine.vertexNormals(verts, tris, getAdjacency(), ring, norms);
+    }
     return true;
 }
 
-void Mesh::mergeMesh(Mesh *m2, bool lastCall)
+void Mesh::laplacianSmooth(int iter, float rate)
 {
-    // copy new verts and tris from m2 to this
-    verts.insert(verts.end(), m2->verts.begin(), m2->verts.end());
+    vector<Vector> del;
+    float norm;
+    cgp::Vector delvec, adjvec;
+    int i, v, a;
+
+    // the shared one-ring adjacency lists each neighbour once, so boundaries are handled as well as closed manifolds
+    const MeshAdjacency & ring = getAdjacency();
+    del.resize(verts.size());
+
+    for(i = 0; i < iter; i++)
+    {
+        #pragma omp parallel for if(verts.size() > 65536) private(a, norm, delvec, adjvec)
+        for(v = 0; v < (int) verts.size(); v++)
+        {
+            delvec = Vector(0.0f, 0.0f, 0.0f);
+            // delvec = sum_j (x_j - x_i) / numadj
+            // new position relies on weighted sum of one ring neighbours of vertex
+            for(a = ring.vvstart[v]; a < ring.vvstart[v+1]; a++)
+            {
+                adjvec.diff(verts[v], verts[ring.vverts[a]]);
+                delvec.add(adjvec);
+            }
+            if(ring.numNeighbours(v) > 0)
+            {
+                norm =  rate / (float) ring.numNeighbours(v);
+                delvec.mult(norm);
+            }
+            del[v] = delvec;
+        }
+
+        // apply Laplacian
+        for(v = 0; v < (int) verts.size(); v++)
+            del[v].pntplusvec(verts[v], &verts[v]);
+    }
+    deriveFaceNorms();
+    deriveVertNorms();
+
+    // create base copy of mesh to support deformation
+    setBase();
+}
+
+void Mesh::applyFFD(ffd * lat)
+{
+    vector<int> moved, faces, ring;
+    vector<char> mark;
+    int nv = (int) verts.size(), t, k;
+
+    if((int) base.size() != nv) // vertices were built without a base copy
+        setBase();
+
+    if(!ffdvalid || ffdlattice != lat || !lat->matches(ffdembed))
+    {
+        lat->embed(base, ffdembed);
+        lat->deform(base, verts);
+        ffdlattice = lat;
+        ffdvalid = true;
+        bvh.invalidate();
+        deriveFaceNorms();
+        deriveVertNorms();
+        return;
+    }
+
+    lat->updateEmbedded(ffdembed, verts, moved);
+    if(moved.empty())
+        return;
+    bvh.invalidate();
+
+    // faces with a moved vertex change normal, and so do the vertex normals of all their corners
+    const MeshAdjacency & adj = getAdjacency();
+    mark.assign(tris.size(), 0);
+    for(int v : moved)
+        for(k = adj.vtstart[v]; k < adj.vtstart[v+1]; k++)
+        {
+            t = adj.vtris[k];
+            if(!mark[t])
+            {
+                mark[t] = 1;
+                faces.push_back(t);
+            }
+        }
+    mark.assign(nv, 0);
+    for(int f : faces)
+        for(k = 0; k < 3; k++)
+            if(!mark[tris[f].v[k]])
+            {
+                mark[tris[f].v[k]] = 1;
+                ring.push_back(tris[f].v[k]);
+            }
+    normalengine.faceNormals(verts, tris, faces);
+    norms.resize(nv);
+    normalengine.vertexNormals(verts, tris, adj, ring, norms);
+}
+
+template<typename RecordFn> void Mesh::weldRecords(long numt, RecordFn record)
+{
+    long t, total;
+    int c, i, nchunks, hitcount;
+    float bminx, bminy, bminz, bmaxx, bmaxy, bmaxz;
+    cgp::BoundBox bbox;
+    const long chunkmin = 16384; // triangles per chunk below which threading does not pay off
+
+    // vertex keys are quantised relative to the bounding box of the whole soup, so gather it first
+    bminx = bminy = bminz = HUGE_VALF;
+    bmaxx = bmaxy = bmaxz = -HUGE_VALF;
+    #pragma omp parallel for reduction(min:bminx,bminy,bminz) reduction(max:bmaxx,bmaxy,bmaxz)
+    for(t = 0; t < numt; t++)
+    {
+        float rec[12];
+        record(t, rec);
+        for(int p = 0; p < 3; p++)
+        {
+            bminx = std::min(bminx, rec[3+p*3]); bmaxx = std::max(bmaxx, rec[3+p*3]);
+            bminy = std::min(bminy, rec[4+p*3]); bmaxy = std::max(bmaxy, rec[4+p*3]);
+            bminz = std::min(bminz, rec[5+p*3]); bmaxz = std::max(bmaxz, rec[5+p*3]);
+        }
+    }
+    bbox.min = cgp::Point(bminx, bminy, bminz);
+    bbox.max = cgp::Point(bmaxx, bmaxy, bmaxz);
+
+    // split the records into contiguous chunks that are decoded and welded independently
+    nchunks = 1;
+#ifdef _OPENMP
+    nchunks = omp_get_max_threads();
+#endif
+    nchunks = (int) std::max(1L, std::min((long) nchunks, numt / chunkmin));
+
+    vector<vector<cgp::Point>> localverts(nchunks);
+    vector<vector<long>> localkeys(nchunks);
+    tris.resize(numt);
+    topologyChanged();
+
+    // triangle vertices have consistent outward facing clockwise winding (right hand rule)
+    #pragma omp parallel for schedule(static, 1)
+    for(c = 0; c < nchunks; c++)
+    {
+        long t0 = numt * c / nchunks, t1 = numt * (c+1) / nchunks;
+        uts::flat_hash_map<long, int> lookup; // vertex key to index in this chunk's vertex list
+        float rec[12];
+        cgp::Point vpos;
+        long key;
+
+        lookup.reserve((t1-t0) * 3 / 4);
+        for(long tc = t0; tc < t1; tc++)
+        {
+            // normal followed by 3 vertices
+            record(tc, rec);
+            tris[tc].n = cgp::Vector(rec[0], rec[1], rec[2]);
+            for(int p = 0; p < 3; p++)
+            {
+                vpos = cgp::Point(rec[3+p*3], rec[4+p*3], rec[5+p*3]);
+                key = hashVert(vpos, bbox);
+                auto found = lookup.emplace(key, (int) localverts[c].size());
+                if(found.second) // first time this position is seen in the chunk
+                {
+                    localverts[c].push_back(vpos);
+                    localkeys[c].push_back(key);
+                }
+                tris[tc].v[p] = found.first->second; // chunk-local index until merged
+            }
+        }
+    }
+
+    // merge chunk tables in chunk order so that vertices are numbered by first use, exactly as mergeVerts would
+    vector<vector<int>> remap(nchunks);
+    uts::flat_hash_map<long, int> idxlookup;
+    total = 0;
+    for(c = 0; c < nchunks; c++)
+        total += (long) localverts[c].size();
+    idxlookup.reserve(total);
+    verts.clear();
+    verts.reserve(total);
+    for(c = 0; c < nchunks; c++)
+    {
+        remap[c].resize(localverts[c].size());
+        for(i = 0; i < (int) localverts[c].size(); i++)
+        {
+            auto found = idxlookup.emplace(localkeys[c][i], (int) verts.size());
+            if(found.second)
+                verts.push_back(localverts[c][i]);
+            remap[c][i] = found.first->second;
+        }
+        vector<cgp::Point>().swap(localverts[c]);
+        vector<long>().swap(localkeys[c]);
+    }
+
+    // re-index triangles from chunk-local to global vertex indices
+    #pragma omp parallel for schedule(static, 1)
+    for(c = 0; c < nchunks; c++)
+    {
+        long t0 = numt * c / nchunks, t1 = numt * (c+1) / nchunks;
+        for(long tc = t0; tc < t1; tc++)
+            for(int p = 0; p < 3; p++)
+                tris[tc].v[p] = remap[c][tris[tc].v[p]];
+    }
+
+    hitcount = (int) (numt * 3 - (long) verts.size());
+    cerr << "num duplicate vertices found = " << hitcount << " of " << numt * 3 << " in " << nchunks << " chunks" << endl;
+}
+
+bool Mesh::decodeBinarySTL(const char * buf, long len)
+{
+    long numt;
+    unsigned int count;
+
+    // interpret buffer as STL file
+    if(len <= 84)
+    {
+        cerr << "Error Mesh::decodeSTL: invalid STL binary file, too small" << endl;
+        return false;
+    }
+
+    memcpy(&count, &buf[80], 4); // skip 80 character header
+    numt = (long) count;
+    if(84 + numt * 50 > len)
+    {
+        cerr << "Error Mesh::decodeSTL: malformed stl file, " << numt << " triangles do not fit in " << len << " bytes" << endl;
+        return false;
+    }
+    const char * recs = &buf[84];
+
+    // IEEE754 little endian floats. Records are 50 bytes so fields are not aligned, hence the copy
+    weldRecords(numt, [recs](long t, float * rec) { memcpy(rec, &recs[t*50], 48); });
+    return true;
+}
+
+/// Advance @a p past whitespace and return the extent of the next token in [@a tok, @a p)
+static bool nextToken(const char * &p, const char * end, const char * &tok)
+{
+    while(p < end && isspace((unsigned char) * p))
+        p++;
+    tok = p;
+    while(p < end && !isspace((unsigned char) * p))
+        p++;
+    return p > tok;
+}
+
+/// Check whether the token [@a tok, @a p) is the keyword @a kw
+static bool tokenIs(const char * tok, const char * p, const char * kw)
+{
+    long len = (long) strlen(kw);
+    return p - tok == len && memcmp(tok, kw, len) == 0;
+}
+
+/**
+ * Parse a decimal floating point token of the form [+-]digits[.digits][(e|E)[+-]digits] without requiring
+ * a terminating null, so that it can run directly over a mapped file.
+ */
+static bool parseFloat(const char * tok, const char * end, float & val)
+{
+    static const double pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                   1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    const char * p = tok;
+    unsigned long long mant = 0;
+    int exp10 = 0, expval = 0, ndigits = 0;
+    bool neg = false, expneg = false;
+    double d;
+
+    if(p < end && (* p == '-' || * p == '+'))
+        neg = (* p++ == '-');
+    for(; p < end && isdigit((unsigned char) * p); p++, ndigits++)
+    {
+        if(mant < 100000000000000000ULL) // keep 17 significant digits, float needs fewer
+            mant = mant * 10 + (* p - '0');
+        else
+            exp10++;
+    }
+    if(p < end && * p == '.')
+    {
+        for(p++; p < end && isdigit((unsigned char) * p); p++, ndigits++)
+        {
+            if(mant < 100000000000000000ULL)
+            {
+                mant = mant * 10 + (* p - '0');
+                exp10--;
+            }
+        }
+    }
+    if(ndigits == 0)
+        return false;
+    if(p < end && (* p == 'e' || * p == 'E'))
+    {
+        p++;
+        if(p < end && (* p == '-' || * p == '+'))
+            expneg = (* p++ == '-');
+        if(p == end || !isdigit((unsigned char) * p))
+            return false;
+        for(; p < end && isdigit((unsigned char) * p); p++)
+            if(expval < 10000)
+                expval = expval * 10 + (* p - '0');
+        exp10 += expneg ? -expval : expval;
+    }
+    if(p != end) // trailing junk
+        return false;
+
+    d = (double) mant;
+    if(exp10 < 0)
+        d = (exp10 >= -22) ? d / pow10[-exp10] : d * pow(10.0, exp10);
+    else if(exp10 > 0)
+        d = (exp10 <= 22) ? d * pow10[exp10] : d * pow(10.0, exp10);
+    val = (float) (neg ? -d : d);
+    return true;
+}
+
+/**
+ * Parse the facets of an ASCII STL file whose "facet" keywords lie in [@a p, @a end), appending
+ * 12 floats (normal then 3 vertices) per facet to @a recs.
+ * @retval false and a description in @a err if the text is malformed
+ */
+static bool parseASCIIFacets(const char * p, const char * end, vector<float> & recs, string & err)
+{
+    const char * tok;
+    int nverts = -1, i; // -1 when outside a facet
+    float rec[12];
+
+    while(nextToken(p, end, tok))
+    {
+        if(tokenIs(tok, p, "facet"))
+        {
+            if(nverts >= 0) // the previous facet never reached endfacet
+            {
+                err = "unterminated facet";
+                return false;
+            }
+            if(!nextToken(p, end, tok) || !tokenIs(tok, p, "normal"))
+            {
+                err = "expected normal after facet";
+                return false;
+            }
+            for(i = 0; i < 3; i++)
+                if(!nextToken(p, end, tok) || !parseFloat(tok, p, rec[i]))
+                {
+                    err = "bad facet normal";
+                    return false;
+                }
+            nverts = 0;
+        }
+        else if(tokenIs(tok, p, "vertex"))
+        {
+            if(nverts < 0 || nverts >= 3)
+            {
+                err = "vertex outside facet or more than 3 vertices in a facet";
+                return false;
+            }
+            for(i = 0; i < 3; i++)
+                if(!nextToken(p, end, tok) || !parseFloat(tok, p, rec[3+nverts*3+i]))
+                {
+                    err = "bad vertex coordinate";
+                    return false;
+                }
+            nverts++;
+        }
+        else if(tokenIs(tok, p, "endfacet"))
+        {
+            if(nverts != 3)
+            {
+                err = "facet does not have exactly 3 vertices";
+                return false;
+            }
+            recs.insert(recs.end(), rec, rec+12);
+            nverts = -1;
+        }
+        else if(tokenIs(tok, p, "solid") || tokenIs(tok, p, "endsolid"))
+        {
+            // rest of the line is a free-form name
+            while(p < end && * p != '\n')
+                p++;
+        }
+        else if(!tokenIs(tok, p, "outer") && !tokenIs(tok, p, "loop") && !tokenIs(tok, p, "endloop"))
+        {
+            err = "unexpected token " + string(tok, p - tok);
+            return false;
+        }
+    }
+    if(nverts >= 0)
+    {
+        err = "unterminated facet";
+        return false;
+    }
+    return true;
+}
+
+bool Mesh::decodeASCIISTL(const char * buf, long len)
+{
+    int c, nchunks = 1;
+    long numt;
+    string err;
+    const long chunkmin = 1 << 20; // bytes of text per chunk below which threading does not pay off
+
+#ifdef _OPENMP
+    nchunks = omp_get_max_threads();
+#endif
+    nchunks = (int) std::max(1L, std::min((long) nchunks, len / chunkmin));
+
+    // facets are variable length, so split the text at the first "facet" keyword after each nominal boundary
+    vector<long> split(nchunks+1);
+    split[0] = 0;
+    split[nchunks] = len;
+    for(c = 1; c < nchunks; c++)
+    {
+        long s = std::max(split[c-1], len * c / nchunks);
+        while(s < len && !(s + 5 <= len && memcmp(&buf[s], "facet", 5) == 0 && isspace((unsigned char) buf[s-1])))
+            s++;
+        split[c] = s;
+    }
+
+    vector<vector<float>> chunkrecs(nchunks);
+    vector<string> chunkerr(nchunks);
+    vector<char> chunkok(nchunks);
+    #pragma omp parallel for schedule(static, 1)
+    for(c = 0; c < nchunks; c++)
+    {
+        chunkrecs[c].reserve((split[c+1] - split[c]) / 200 * 12); // about 250 bytes of text per facet
+        chunkok[c] = parseASCIIFacets(&buf[split[c]], &buf[split[c+1]], chunkrecs[c], chunkerr[c]);
+    }
+
+    for(c = 0; c < nchunks; c++)
+        if(!chunkok[c])
+        {
+            cerr << "Error Mesh::decodeSTL: malformed ASCII stl file, " << chunkerr[c] << endl;
+            return false;
+        }
+
+    // locate each triangle by chunk so that records can be welded without concatenating
+    vector<long> first(nchunks+1, 0);
+    for(c = 0; c < nchunks; c++)
+        first[c+1] = first[c] + (long) chunkrecs[c].size() / 12;
+    numt = first[nchunks];
+    if(numt == 0)
+    {
+        cerr << "Error Mesh::decodeSTL: ASCII stl file contains no facets" << endl;
+        return false;
+    }
+
+    weldRecords(numt, [&](long t, float * rec)
+    {
+        int rc = (int) (std::upper_bound(first.begin(), first.end(), t) - first.begin()) - 1;
+        memcpy(rec, &chunkrecs[rc][(t - first[rc]) * 12], 48);
+    });
+    return true;
+}
+
+bool Mesh::decodeSTL(const char * buf, long len)
+{
+    const char * p = buf, * end = buf + len;
+    unsigned int count;
+
+    // binary files may also start with "solid", so trust a header count whose records fit in the file, allowing for
+    // trailing bytes. Text in the count field reads as hundreds of millions of triangles, far more than any text file holds.
+    if(len >= 84)
+    {
+        memcpy(&count, &buf[80], 4);
+        if(84 + (long) count * 50 <= len)
+            return decodeBinarySTL(buf, len);
+    }
+
+    while(p < end && isspace((unsigned char) * p))
+        p++;
+    if(end - p >= 5 && memcmp(p, "solid", 5) == 0)
+        return decodeASCIISTL(buf, len);
+    return decodeBinarySTL(buf, len);
+}
+
+void Mesh::finishLoad()
+{
+    cerr << "num vertices = " << (int) verts.size() << endl;
+    cerr << "num triangles = " << (int) tris.size() << endl;
+
+    // normal vectors at vertices are needed for rendering so derive from incident faces
+    deriveVertNorms();
+    if(basicValidity())
+        cerr << "loaded file has basic validity" << endl;
+    else
+        cerr << "loaded file does not pass basic validity" << endl;
+}
+
+bool Mesh::readSTLStream(string filename)
+{
+    ifstream infile;
+    vector<char> inbuffer;
+    long insize = 0;
+    const long chunk = 1 << 20;
+
+    infile.open((char *) filename.c_str(), ios_base::in | ios_base::binary);
+    if(!infile.is_open())
+    {
+        cerr << "Error Mesh::readSTL: unable to open " << filename << endl;
+        return false;
+    }
+
+    // the size of a pipe is not known in advance so read until end of stream in large chunks
+    while(infile)
+    {
+        inbuffer.resize(insize + chunk);
+        infile.read(&inbuffer[insize], chunk);
+        insize += (long) infile.gcount();
+    }
+    if(infile.bad()) // failed to read from the file for some reason
+    {
+        cerr << "Error Mesh::readSTL: unable to populate read buffer" << endl;
+        return false;
+    }
+    infile.close();
+
+    clear();
+    if(!decodeSTL(inbuffer.data(), insize))
+        return false;
+    inbuffer.clear();
+    inbuffer.shrink_to_fit(); // release before deriving normals
+
+    finishLoad();
+    return true;
+}
+
+bool Mesh::readSTL(string filename)
+{
+    MappedFile infile;
+
+    // decode straight from the page cache where possible, avoiding a copy of the whole file
+    if(!infile.open(filename))
+        return readSTLStream(filename);
+
+    clear();
+    if(!decodeSTL(infile.data(), (long) infile.size()))
+        return false;
+    infile.close();
+
+    finishLoad();
+    return true;
+}
+
+/// Layout version of .tmesh files, bumped whenever the format changes
+static const char tmeshmagic[8] = {'T', 'M', 'E', 'S', 'H', 0, 0, 2};
+
+/// Fixed size header at the start of a .tmesh file, followed by vertices, vertex normals, triangle indices and triangle normals
+struct TMeshHeader
+{
+    char magic[8];              ///< tmeshmagic
+    uint64_t srchash;           ///< content hash of the source STL file
+    uint64_t srcsize;           ///< size in bytes of the source STL file
+    uint32_t numverts;          ///< number of welded vertices
+    uint32_t numtris;           ///< number of triangles
+};
+
+/// Rotate a 64-bit word left
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+/**
+ * 64-bit content hash of a buffer, taken a word at a time so that hashing keeps pace with mapped reads. Each word
+ * goes through the block mixing of MurmurHash3 and the result through its finaliser, since with a bare multiply a
+ * change to the top bit of a word, such as the sign of a float, never reaches the other bits and two of them cancel.
+ */
+static uint64_t hashContents(const char * buf, long len)
+{
+    const uint64_t c1 = 0x87c37b91114253d5ULL, c2 = 0x4cf5ad432745937fULL;
+    uint64_t h = 0x9e3779b97f4a7c15ULL, word;
+    long i;
+
+    for(i = 0; i + 8 <= len; i += 8)
+    {
+        memcpy(&word, &buf[i], 8);
+        h ^= rotl64(word * c1, 31) * c2;
+        h = rotl64(h, 27) * 5 + 0x52dce729;
+    }
+    word = 0; // remaining bytes, zero padded
+    memcpy(&word, &buf[i], len - i);
+    h ^= rotl64(word * c1, 31) * c2;
+    h ^= (uint64_t) len;
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+bool Mesh::writeCache(string filename, uint64_t srchash, uint64_t srcsize)
+{
+    TMeshHeader header;
+    vector<char> outbuffer;
+    ofstream outfile;
+    long nv = (long) verts.size(), nt = (long) tris.size();
+    string tmpname = filename + ".tmp";
+    char * pos;
+
+    if(norms.size() < verts.size())
+    {
+        cerr << "Error Mesh::writeCache: vertex normals have not been derived" << endl;
+        return false;
+    }
+
+    memcpy(header.magic, tmeshmagic, 8);
+    header.srchash = srchash;
+    header.srcsize = srcsize;
+    header.numverts = (uint32_t) nv;
+    header.numtris = (uint32_t) nt;
+
+    // pack the whole file so that it can be written in one go
+    outbuffer.resize(sizeof(TMeshHeader) + nv * 24 + nt * 24);
+    memcpy(outbuffer.data(), &header, sizeof(TMeshHeader));
+    pos = outbuffer.data() + sizeof(TMeshHeader);
+    #pragma omp parallel for if(nv > 65536)
+    for(long v = 0; v < nv; v++)
+    {
+        float rec[6] = {verts[v].x, verts[v].y, verts[v].z, norms[v].i, norms[v].j, norms[v].k};
+        memcpy(&pos[v*12], rec, 12);
+        memcpy(&pos[nv*12 + v*12], &rec[3], 12);
+    }
+    pos += nv * 24;
+    #pragma omp parallel for if(nt > 65536)
+    for(long t = 0; t < nt; t++)
+    {
+        int32_t idx[3] = {tris[t].v[0], tris[t].v[1], tris[t].v[2]};
+        float n[3] = {tris[t].n.i, tris[t].n.j, tris[t].n.k};
+        memcpy(&pos[t*12], idx, 12);
+        memcpy(&pos[nt*12 + t*12], n, 12);
+    }
+
+    // write to the side and rename so that a concurrent reader never sees a partial cache
+    outfile.open((char *) tmpname.c_str(), ios_base::out | ios_base::binary);
+    if(!outfile.is_open())
+    {
+        cerr << "Error Mesh::writeCache: unable to open " << tmpname << endl;
+        return false;
+    }
+    outfile.write(outbuffer.data(), outbuffer.size());
+    outfile.close();
+    if(outfile.fail() || rename(tmpname.c_str(), filename.c_str()) != 0)
+    {
+        cerr << "Error Mesh::writeCache: failed writing " << filename << endl;
+        remove(tmpname.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool Mesh::readCache(string filename, uint64_t srchash, uint64_t srcsize)
+{
+    MappedFile infile;
+    TMeshHeader header;
+    long nv, nt;
+    bool inrange = true;
+    const char * pos;
+
+    if(!infile.open(filename) || infile.size() < sizeof(TMeshHeader))
+        return false;
+    memcpy(&header, infile.data(), sizeof(TMeshHeader));
+    if(memcmp(header.magic, tmeshmagic, 8) != 0 || header.srchash != srchash || header.srcsize != srcsize)
+        return false; // stale or foreign
+    nv = (long) header.numverts;
+    nt = (long) header.numtris;
+    if(infile.size() != sizeof(TMeshHeader) + (std::size_t) (nv * 24 + nt * 24))
+    {
+        cerr << "Error Mesh::readCache: " << filename << " is truncated" << endl;
+        return false;
+    }
+
+    clear();
+    verts.resize(nv);
+    norms.resize(nv);
+    tris.resize(nt);
+    pos = infile.data() + sizeof(TMeshHeader);
+    #pragma omp parallel for if(nv > 65536)
+    for(long v = 0; v < nv; v++)
+    {
+        float rec[6];
+        memcpy(rec, &pos[v*12], 12);
+        memcpy(&rec[3], &pos[nv*12 + v*12], 12);
+        verts[v] = cgp::Point(rec[0], rec[1], rec[2]);
+        norms[v] = cgp::Vector(rec[3], rec[4], rec[5]);
+    }
+    pos += nv * 24;
+    #pragma omp parallel for if(nt > 65536) reduction(&&:inrange)
+    for(long t = 0; t < nt; t++)
+    {
+        int32_t idx[3];
+        float n[3];
+        memcpy(idx, &pos[t*12], 12);
+        memcpy(n, &pos[nt*12 + t*12], 12);
+        for(int p = 0; p < 3; p++)
+        {
+            tris[t].v[p] = idx[p];
+            inrange = inrange && idx[p] >= 0 && idx[p] < nv;
+        }
+        tris[t].n = cgp::Vector(n[0], n[1], n[2]);
+    }
+    if(!inrange)
+    {
+        cerr << "Error Mesh::readCache: " << filename << " has out of range vertex indices" << endl;
+        clear();
+        norms.clear();
+        return false;
+    }
+    return true;
+}
+
+bool Mesh::readSTLCached(string filename)
+{
+    MappedFile infile;
+    uint64_t srchash;
+    string cachename = filename + ".tmesh";
+
+    // only regular files have stable contents to hash
+    if(!infile.open(filename))
+        return readSTL(filename);
+
+    srchash = hashContents(infile.data(), (long) infile.size());
+    if(readCache(cachename, srchash, infile.size()))
+    {
+        cerr << "loaded cached mesh " << cachename << " with " << (int) verts.size() << " vertices and " << (int) tris.size() << " triangles" << endl;
+        return true;
+    }
+
+    clear();
+    if(!decodeSTL(infile.data(), (long) infile.size()))
+        return false;
+    finishLoad();
+    writeCache(cachename, srchash, infile.size()); // not fatal, the source may be in a read-only directory
+    return true;
+}
+
+void Mesh::encodeSTL(char * buf, long t0, long t1)
+{
+    // records are independent and fixed size, so large ranges can be packed in parallel. writeSTL hands over at
+    // most 65536 records at a time, so the threshold sits well below that.
+    #pragma omp parallel for if(t1 - t0 >= 16384)
+    for(long t = t0; t < t1; t++)
+    {
+        float rec[12];
+        unsigned short val = 0; // attribute byte count - null
+
+        // normal followed by triangle vertices
+        rec[0] = tris[t].n.i; rec[1] = tris[t].n.j; rec[2] = tris[t].n.k;
+        for(int p = 0; p < 3; p++)
+        {
+            rec[3+p*3] = verts[tris[t].v[p]].x;
+            rec[4+p*3] = verts[tris[t].v[p]].y;
+            rec[5+p*3] = verts[tris[t].v[p]].z;
+        }
+        memcpy(&buf[(t-t0)*50], rec, 48);
+        memcpy(&buf[(t-t0)*50+48], &val, 2);
+    }
+}
+
+bool Mesh::writeSTL(string filename)
+{
+    ofstream outfile;
+    long t, tend, numt;
+    unsigned int count;
+    char header[80];
+    const long blocktris = 1 << 16; // triangles packed per block write, about 3MB
+    vector<char> outbuffer;
+
+    outfile.open((char *) filename.c_str(), ios_base::out | ios_base::binary);
+	if(outfile.is_open())
+	{
+        memset(header, 0, 80);
+        strncpy(header, "File Generated by Tesselator. Binary STL", 79);
+        outfile.write(header, 80); // skippable header
+        numt = (long) tris.size();
+        count = (unsigned int) numt;
+        outfile.write((char *) &count, 4); // number of triangles
+
+        // pack records into a reusable buffer and flush in large blocks
+        outbuffer.resize(std::min(numt, blocktris) * 50);
+        for(t = 0; t < numt && outfile.good(); t = tend)
+        {
+            tend = std::min(numt, t + blocktris);
+            encodeSTL(outbuffer.data(), t, tend);
+            outfile.write(outbuffer.data(), (tend - t) * 50);
+        }
+
+        // tidy up
+		outfile.close();
+        if(outfile.fail())
+        {
+            cerr << "Error Mesh::writeSTL: failed writing " << filename << endl;
+            return false;
+        }
+    }
+    else
+    {
+        cerr << "Error Mesh::writeSTL: unable to open " << filename << endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Accumulates output in a large reusable buffer and hands it to the stream in big blocks, so that exporters can
+ * format records directly into memory instead of through many small stream writes
+ */
+class BlockWriter
+{
+private:
+    ofstream & out;         ///< destination stream
+    vector<char> buf;       ///< staging buffer
+    long used;              ///< bytes of buf currently filled
+
+public:
+    BlockWriter(ofstream & outstream, long blocksize) : out(outstream), buf(blocksize), used(0) {}
+
+    /// Flush any remaining output on destruction
+    ~BlockWriter(){ flush(); }
+
+    /// Return space for at least @a n bytes, flushing first if necessary. Commit what was used with @ref advance.
+    char * reserve(long n)
+    {
+        if(used + n > (long) buf.size())
+            flush();
+        return &buf[used];
+    }
+
+    /// Mark @a n bytes of the reserved space as filled
+    void advance(long n){ used += n; }
+
+    /// Append @a n raw bytes
+    void put(const void * src, long n){ memcpy(reserve(n), src, n); advance(n); }
+
+    /// Hand the filled part of the buffer to the stream
+    void flush()
+    {
+        if(used > 0)
+            out.write(buf.data(), used);
+        used = 0;
+    }
+};
+
+/// Format a float for text output in at most 16 characters, always with '.' as decimal separator regardless of locale
+static int formatFloat(char * dst, float val, char localepoint)
+{
+    int len = snprintf(dst, 16, "%.9g", val);
+
+    if(localepoint != '.') // Qt adopts the user locale, which may use a decimal comma
+        for(int i = 0; i < len; i++)
+            if(dst[i] == localepoint)
+                dst[i] = '.';
+    return len;
+}
+
+/// Format a non-negative integer for text output, returning the number of characters written
+static int formatInt(char * dst, long val)
+{
+    char digits[24];
+    int n = 0, len = 0;
+
+    do
+    {
+        digits[n++] = (char) ('0' + val % 10);
+        val /= 10;
+    }
+    while(val > 0);
+    while(n > 0)
+        dst[len++] = digits[--n];
+    return len;
+}
+
+bool Mesh::writePLY(string filename)
+{
+    ofstream outfile;
+    long v, t, nv = (long) verts.size(), nt = (long) tris.size();
+    bool withnorms = norms.size() >= verts.size();
+    string header;
+
+    outfile.open((char *) filename.c_str(), ios_base::out | ios_base::binary);
+    if(!outfile.is_open())
+    {
+        cerr << "Error Mesh::writePLY: unable to open " << filename << endl;
+        return false;
+    }
+
+    header = "ply\nformat binary_little_endian 1.0\ncomment File Generated by Tesselator\n";
+    header += "element vertex " + std::to_string(nv) + "\nproperty float x\nproperty float y\nproperty float z\n";
+    if(withnorms)
+        header += "property float nx\nproperty float ny\nproperty float nz\n";
+    header += "element face " + std::to_string(nt) + "\nproperty list uchar int vertex_indices\nend_header\n";
+
+    {
+        BlockWriter out(outfile, 1 << 22);
+        out.put(header.data(), (long) header.size());
+
+        // IEEE754 little endian floats, as for STL
+        for(v = 0; v < nv; v++)
+        {
+            float rec[6] = {verts[v].x, verts[v].y, verts[v].z, 0.0f, 0.0f, 0.0f};
+            if(withnorms)
+            {
+                rec[3] = norms[v].i; rec[4] = norms[v].j; rec[5] = norms[v].k;
+            }
+            out.put(rec, withnorms ? 24 : 12);
+        }
+
+        // each face is a count byte followed by 3 indices, so records are 13 bytes and unaligned
+        for(t = 0; t < nt; t++)
+        {
+            char * dst = out.reserve(13);
+            int32_t idx[3] = {tris[t].v[0], tris[t].v[1], tris[t].v[2]};
+            dst[0] = 3;
+            memcpy(&dst[1], idx, 12);
+            out.advance(13);
+        }
+    }
+
+    outfile.close();
+    if(outfile.fail())
+    {
+        cerr << "Error Mesh::writePLY: failed writing " << filename << endl;
+        return false;
+    }
+    return true;
+}
+
+bool Mesh::writeOBJ(string filename)
+{
+    ofstream outfile;
+    long v, t, nv = (long) verts.size(), nt = (long) tris.size();
+    bool withnorms = norms.size() >= verts.size();
+    char localepoint = localeconv()->decimal_point[0];
+    const char * header = "# File Generated by Tesselator\n";
+
+    outfile.open((char *) filename.c_str(), ios_base::out | ios_base::binary);
+    if(!outfile.is_open())
+    {
+        cerr << "Error Mesh::writeOBJ: unable to open " << filename << endl;
+        return false;
+    }
+
+    {
+        BlockWriter out(outfile, 1 << 22);
+        out.put(header, (long) strlen(header));
+
+        // records are formatted straight into the block buffer, 64 bytes is ample for any of them
+        for(v = 0; v < nv; v++)
+        {
+            char * dst = out.reserve(64), * pos = dst;
+            * pos++ = 'v';
+            * pos++ = ' '; pos += formatFloat(pos, verts[v].x, localepoint);
+            * pos++ = ' '; pos += formatFloat(pos, verts[v].y, localepoint);
+            * pos++ = ' '; pos += formatFloat(pos, verts[v].z, localepoint);
+            * pos++ = '\n';
+            out.advance(pos - dst);
+        }
+        if(withnorms)
+            for(v = 0; v < nv; v++)
+            {
+                char * dst = out.reserve(64), * pos = dst;
+                * pos++ = 'v'; * pos++ = 'n';
+                * pos++ = ' '; pos += formatFloat(pos, norms[v].i, localepoint);
+                * pos++ = ' '; pos += formatFloat(pos, norms[v].j, localepoint);
+                * pos++ = ' '; pos += formatFloat(pos, norms[v].k, localepoint);
+                * pos++ = '\n';
+                out.advance(pos - dst);
+            }
+
+        // OBJ counts from 1, and vertex normals share the vertex numbering
+        for(t = 0; t < nt; t++)
+        {
+            char * dst = out.reserve(128), * pos = dst;
+            * pos++ = 'f';
+            for(int p = 0; p < 3; p++)
+            {
+                * pos++ = ' ';
+                pos += formatInt(pos, (long) tris[t].v[p] + 1);
+                if(withnorms)
+                {
+                    * pos++ = '/'; * pos++ = '/';
+                    pos += formatInt(pos, (long) tris[t].v[p] + 1);
+                }
+            }
+            * pos++ = '\n';
+            out.advance(pos - dst);
+        }
+    }
+
+    outfile.close();
+    if(outfile.fail())
+    {
+        cerr << "Error Mesh::writeOBJ: failed writing " << filename << endl;
+        return false;
+    }
+    return true;
+}
+
+/// Identifies a compressed mesh archive and its layout version
+static const char tmzmagic[4] = {'T', 'M', 'Z', 1};
+
+/// Fixed size header at the start of a compressed mesh archive, followed by the coded position and index streams
+struct TMZHeader
+{
+    char magic[4];              ///< tmzmagic
+    uint32_t bits;              ///< quantisation bits per coordinate
+    uint32_t numverts;          ///< number of vertices
+    uint32_t numtris;           ///< number of triangles
+    float bmin[3];              ///< minimum corner of the quantisation box
+    float bmax[3];              ///< maximum corner of the quantisation box
+};
+
+/// Append @a val to @a out as a little endian base-128 varint
+static inline void putVarint(uts::vector<uint8_t> & out, uint32_t val)
+{
+    while(val >= 0x80)
+    {
+        out.push_back((uint8_t) (val | 0x80));
+        val >>= 7;
+    }
+    out.push_back((uint8_t) val);
+}
+
+/// Read a varint written by @ref putVarint, returning false if it runs past @a end
+static inline bool getVarint(const uint8_t * &p, const uint8_t * end, uint32_t & val)
+{
+    int shift = 0;
+
+    val = 0;
+    while(p < end && shift < 35)
+    {
+        uint8_t b = * p++;
+        val |= (uint32_t) (b & 0x7f) << shift;
+        if(!(b & 0x80))
+            return true;
+        shift += 7;
+    }
+    return false;
+}
+
+/// Spread the low 10 bits of @a v so that there are two zero bits between each
+static inline uint32_t spreadBits(uint32_t v)
+{
+    v &= 0x3ff;
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8)) & 0x0300f00f;
+    v = (v | (v << 4)) & 0x030c30c3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+bool Mesh::writeArchive(string filename, int bits)
+{
+    TMZHeader header;
+    cgp::BoundBox bbox;
+    ofstream outfile;
+    long nv = (long) verts.size(), nt = (long) tris.size();
+    long t, v;
+    int p, k;
+    float ext[3], maxq;
+    uint32_t prev[3] = {0, 0, 0}, maxsofar;
+    uts::vector<uint8_t> posbytes, idxbytes, coded;
+
+    if(bits < 4 || bits > 24)
+    {
+        cerr << "Error Mesh::writeArchive: quantisation bits must be between 4 and 24, not " << bits << endl;
+        return false;
+    }
+
+    for(v = 0; v < nv; v++)
+        bbox.includePnt(verts[v]);
+    ext[0] = bbox.max.x - bbox.min.x; ext[1] = bbox.max.y - bbox.min.y; ext[2] = bbox.max.z - bbox.min.z;
+    maxq = (float) ((1u << bits) - 1);
+
+    // locality reordering: visit triangles along a Morton curve through their centroids
+    vector<std::pair<uint32_t, long>> order(nt);
+    #pragma omp parallel for if(nt > 65536)
+    for(t = 0; t < nt; t++)
+    {
+        uint32_t cell[3];
+        for(int k = 0; k < 3; k++)
+        {
+            float c = 0.0f, lo = (k == 0) ? bbox.min.x : (k == 1) ? bbox.min.y : bbox.min.z;
+            for(int q = 0; q < 3; q++)
+            {
+                const cgp::Point & pnt = verts[tris[t].v[q]];
+                c += (k == 0) ? pnt.x : (k == 1) ? pnt.y : pnt.z;
+            }
+            cell[k] = (ext[k] > 0.0f) ? (uint32_t) ((c / 3.0f - lo) / ext[k] * 1023.0f) : 0;
+        }
+        order[t] = std::make_pair(spreadBits(cell[0]) | (spreadBits(cell[1]) << 1) | (spreadBits(cell[2]) << 2), t);
+    }
+    std::sort(order.begin(), order.end());
+
+    // renumber vertices by first use along the new triangle order, so that an index is either the next
+    // unseen vertex or one seen recently, and delta code the indices against the next unseen vertex
+    vector<int> newidx(nv, -1), oldidx;
+    oldidx.reserve(nv);
+    idxbytes.reserve(nt * 4);
+    maxsofar = 0;
+    for(t = 0; t < nt; t++)
+        for(p = 0; p < 3; p++)
+        {
+            int vi = tris[order[t].second].v[p];
+            if(newidx[vi] < 0)
+            {
+                newidx[vi] = (int) oldidx.size();
+                oldidx.push_back(vi);
+            }
+            putVarint(idxbytes, maxsofar - (uint32_t) newidx[vi]);
+            maxsofar = std::max(maxsofar, (uint32_t) newidx[vi] + 1);
+        }
+    for(v = 0; v < nv; v++) // vertices not used by any triangle go last
+        if(newidx[v] < 0)
+        {
+            newidx[v] = (int) oldidx.size();
+            oldidx.push_back((int) v);
+        }
+
+    // quantise positions to the bounding box and code each as a zigzag delta from its predecessor
+    posbytes.reserve(nv * 6);
+    for(v = 0; v < nv; v++)
+    {
+        const cgp::Point & pnt = verts[oldidx[v]];
+        float val[3] = {pnt.x - bbox.min.x, pnt.y - bbox.min.y, pnt.z - bbox.min.z};
+        for(k = 0; k < 3; k++)
+        {
+            uint32_t q = (ext[k] > 0.0f) ? (uint32_t) lroundf(val[k] / ext[k] * maxq) : 0;
+            int32_t delta = (int32_t) (q - prev[k]);
+            putVarint(posbytes, ((uint32_t) delta << 1) ^ (uint32_t) (delta >> 31));
+            prev[k] = q;
+        }
+    }
+
+    memcpy(header.magic, tmzmagic, 4);
+    header.bits = (uint32_t) bits;
+    header.numverts = (uint32_t) nv;
+    header.numtris = (uint32_t) nt;
+    header.bmin[0] = bbox.min.x; header.bmin[1] = bbox.min.y; header.bmin[2] = bbox.min.z;
+    header.bmax[0] = bbox.max.x; header.bmax[1] = bbox.max.y; header.bmax[2] = bbox.max.z;
+    coded.resize(sizeof(TMZHeader));
+    memcpy(coded.data(), &header, sizeof(TMZHeader));
+    ransEncode(posbytes.data(), posbytes.size(), coded);
+    ransEncode(idxbytes.data(), idxbytes.size(), coded);
+
+    outfile.open((char *) filename.c_str(), ios_base::out | ios_base::binary);
+    if(!outfile.is_open())
+    {
+        cerr << "Error Mesh::writeArchive: unable to open " << filename << endl;
+        return false;
+    }
+    outfile.write((const char *) coded.data(), coded.size());
+    outfile.close();
+    if(outfile.fail())
+    {
+        cerr << "Error Mesh::writeArchive: failed writing " << filename << endl;
+        return false;
+    }
+    return true;
+}
+
+bool Mesh::readArchive(string filename)
+{
+    MappedFile infile;
+    TMZHeader header;
+    uts::vector<uint8_t> posbytes, idxbytes;
+    std::size_t posused = 0, idxused = 0;
+    bool posok = false, idxok = false, ok = true;
+    long nv, nt, v, t;
+    int p, k;
+    float scale[3];
+    uint32_t q[3] = {0, 0, 0}, code, maxsofar = 0;
+
+    if(!infile.open(filename))
+    {
+        cerr << "Error Mesh::readArchive: unable to open " << filename << endl;
+        return false;
+    }
+    const uint8_t * buf = (const uint8_t *) infile.data();
+    std::size_t len = infile.size();
+    if(len < sizeof(TMZHeader))
+    {
+        cerr << "Error Mesh::readArchive: " << filename << " is too small" << endl;
+        return false;
+    }
+    memcpy(&header, buf, sizeof(TMZHeader));
+    if(memcmp(header.magic, tmzmagic, 4) != 0 || header.bits < 4 || header.bits > 24)
+    {
+        cerr << "Error Mesh::readArchive: " << filename << " is not a mesh archive" << endl;
+        return false;
+    }
+    nv = (long) header.numverts;
+    nt = (long) header.numtris;
+
+    // positions then indices, each entropy coded on its own, and each value a varint of at most 5 bytes
+    const uint8_t * streams = buf + sizeof(TMZHeader);
+    std::size_t streamlen = len - sizeof(TMZHeader);
+    posok = ransDecode(streams, streamlen, posbytes, posused, 15 * (uint64_t) nv);
+    if(posok)
+        idxok = ransDecode(streams + posused, streamlen - posused, idxbytes, idxused, 15 * (uint64_t) nt);
+    if(!posok || !idxok)
+    {
+        cerr << "Error Mesh::readArchive: " << filename << " has corrupt streams" << endl;
+        return false;
+    }
+
+    // every varint takes at least a byte, so counts the streams cannot hold are rejected before allocating for them
+    if(3 * (uint64_t) nv > posbytes.size() || 3 * (uint64_t) nt > idxbytes.size())
+    {
+        cerr << "Error Mesh::readArchive: " << filename << " has " << nv << " vertices and " << nt
+             << " triangles in its header, more than its streams hold" << endl;
+        return false;
+    }
+
+    clear();
+    norms.clear();
+    verts.resize(nv);
+    tris.resize(nt);
+    for(k = 0; k < 3; k++)
+        scale[k] = (header.bmax[k] - header.bmin[k]) / (float) ((1u << header.bits) - 1);
+
+    const uint8_t * pos = posbytes.data(), * posend = pos + posbytes.size();
+    for(v = 0; v < nv && ok; v++)
+    {
+        for(k = 0; k < 3 && ok; k++)
+        {
+            ok = getVarint(pos, posend, code);
+            q[k] += (code >> 1) ^ (0u - (code & 1)); // undo zigzag
+        }
+        verts[v] = cgp::Point(header.bmin[0] + q[0] * scale[0], header.bmin[1] + q[1] * scale[1], header.bmin[2] + q[2] * scale[2]);
+    }
+
+    const uint8_t * idx = idxbytes.data(), * idxend = idx + idxbytes.size();
+    for(t = 0; t < nt && ok; t++)
+        for(p = 0; p < 3 && ok; p++)
+        {
+            ok = getVarint(idx, idxend, code) && code <= maxsofar && maxsofar - code < (uint32_t) nv;
+            tris[t].v[p] = (int) (maxsofar - code);
+            maxsofar = std::max(maxsofar, (uint32_t) tris[t].v[p] + 1);
+        }
+
+    if(!ok)
+    {
+        cerr << "Error Mesh::readArchive: " << filename << " has malformed positions or indices" << endl;
+        clear();
+        return false;
+    }
+
+    // normals are not archived since they follow from the geometry
+    deriveFaceNorms();
+    deriveVertNorms();
+    return true;
+}
+
+void Mesh::readGrid(vector<vector<vector<int>>> &voxelgrid, string filename, int len)
+{
+    ifstream infile;
+    infile.open(filename, ios::in);
+    string line;
+    //int oneCount = 0;
+    //vector<vector<vector<int>>> voxelgrid;
+    voxelgrid.resize(len);
+    //cout << "size of voxelgrid: " << voxelgrid.size() << endl;
+    for (int z = 0; z < len; z++) {
+        voxelgrid[z].resize(len);
+        //cout << "size of voxelgrid[" << z << "]: " << voxelgrid[z].size() << endl;
+        getline(infile, line);
+        //cout << "line: " << line;
+        for (int y = 0; y < len; y++) {
+            voxelgrid[z][y].resize(len);
+            for (int x = 0; x < len; x++) {
+                voxelgrid[x][y][z] = stoi(line.substr(x, 1));
+            }
+            if (y < (len-1))
+                line = line.substr(line.find(",")+1);
+        }
+    }
+    //outfile << finalGrid;
+
+    infile.close();
+}
+
+bool Mesh::writeGrid(vector<vector<vector<int>>> &voxelgrid, string outfilename, int len)
+{
+    ofstream outfile;
+    outfile.open(outfilename, ios::out);
+    string finalGrid = "";
+    for (int z = 0; z < len; z++) {
+
+        for (int y = 0; y < len; y++) {
+            for (int x = 0; x < len; x++)
+                finalGrid += to_string(voxelgrid[x][y][z]);
+            if (y < (len-1))
+                finalGrid += ",";
+        }
+        if (z < (len-1))
+            finalGrid += "\n";
+    }
+
+    outfile << finalGrid;
+
+    outfile.close();
+
+    return true;
+}
+
+void Mesh::mergeMesh(Mesh *m2, bool lastCall)
+{
+    // copy new verts and tris from m2 to this
+    verts.insert(verts.end(), m2->verts.begin(), m2->verts.end());
     tris.insert(tris.end(), m2->tris.begin(), m2->tris.end());
+    topologyChanged();
 
     if (lastCall)
     {
@@ -1345,7 +2773,7 @@ bool Mesh::basicValidity()
     vector<bool> dangle;
     long key;
     // use hashmap to quickly look up vertices with the same coordinates
-    std::unordered_map<long, int> idxlookup; // key is concatenation of vertex position, value is index into the cleanverts vector
+    uts::flat_hash_map<long, int> idxlookup; // key is concatenation of vertex position, value is index into the cleanverts vector
     cgp::BoundBox bbox;
     vector<cgp::Point> cleanverts;
 
@@ -1383,6 +2811,7 @@ bool Mesh::basicValidity()
         bbox.includePnt(verts[i]);
 
     cleanverts.clear();
+    idxlookup.reserve(verts.size());
 
     // search vertex list for duplicates using hash table
     for(i = 0; i < (int) verts.size(); i++)
@@ -1432,195 +2861,388 @@ bool Mesh::basicValidity()
     return true;
 }
 
-bool Mesh::sameTriangle(Triangle t1, Triangle t2)
+/// Sort a short list of packed keys, by insertion when it is as small as the neighbourhood of a typical vertex
+static inline void sortKeys(uint64_t * first, uint64_t * last)
 {
-    std::vector<int> ind1, ind2;
-
-    // a duplicate has the same set of vertices but they may be ordered differently
-    // so sort vertex indices of both triangles and then compare index by index
-    for(int i = 0; i < 3; i++)
-    {
-        ind1.push_back(t1.v[i]);
-        ind2.push_back(t2.v[i]);
-    }
-    std::sort(ind1.begin(), ind1.end());
-    std::sort(ind2.begin(), ind2.end());
-    return (ind1 == ind2);
-}
-
-bool Mesh::sameEdge(Edge e1, Edge e2, bool & opposite)
-{
-    if(e1.v[0] == e2.v[0] && e1.v[1] == e2.v[1])
+    if(last - first > 32)
     {
-        opposite = false;
-        return true;
+        std::sort(first, last);
+        return;
     }
-    if(e1.v[0] == e2.v[1] && e1.v[1] == e2.v[0])
+    for(uint64_t * i = first + 1; i < last; i++)
     {
-        opposite = true;
-        return true;
+        uint64_t k = *i, * j = i;
+        for(; j > first && *(j-1) > k; j--)
+            *j = *(j-1);
+        *j = k;
     }
-    return false;
 }
 
-bool Mesh::manifoldValidity()
+bool Mesh::manifoldValidity(ManifoldReport & report)
 {
-    std::unordered_multimap<long, int> trilookup; // key is sum of vertex indices, needs a multimap because this is not unique
-    long key;
-    int i, j, k, t, v, e, erest, mcount, ocount;
-    std::vector<std::vector<int>> incident;
-    std::vector<int> incempty;
-    std::vector<Edge> edges;
-    std::vector<bool> visited;
-    bool opposite, fin, found;
-    Edge edge1, edge2;
-
-    /*
-     // inefficient search of triangle list for duplicates - O(n^2)
-     int t = 0, trest = 0;
-     bool found = false;
-     while(!found && t < (int) tris.size()-1)
-     {
-     // search remainder of list
-     trest = t+1;
-     while(!found && trest < (int) tris.size())
-     {
-     if(sameTriangle(tris[t], tris[trest]))
-     {
-     found = true;
-     }
-     trest++;
-     }
-     t++;
-     }
-     if(found)
-     {
-     cerr << "Error Mesh::manifoldValidity(): duplicate triangle found" << endl;
-     return false;
-     }
-     */
-
-    // search triangle list for duplicates
-    // usual trick for more efficient version using hash table but this time keys map to multiple values
-    for(i = 0; i < (int) tris.size(); i++)
-    {
-        key = (long) tris[i].v[0] + (long) tris[i].v[1] + (long) tris[i].v[2]; // use sum of vertex indices as the key, not unique but a good start
-        if(!(trilookup.find(key) == trilookup.end())) // key in map
-        {
-            // cerr << "possible dup" << endl;
-            // iterate over triangles with the same key to see if any are duplicates
-            auto range = trilookup.equal_range(key);
-            for(auto it = range.first; it != range.second; it++) // now check if each truly is a duplicate, by looking at all values with the same key
-            {
-                // cerr << tris[i].v[0] << " " << tris[i].v[1] << " " << tris[i].v[2] << " ?= " << tris[it->second].v[0] << " " << tris[it->second].v[1] << " " << tris[it->second].v[2] << endl;
-                if(sameTriangle(tris[i], tris[it->second]))
-                {
-                    cerr << "Error Mesh::manifoldValidity(): duplicate triangle found" << endl;
-                    return false; // early out - exits on first duplicate encountered
-                }
-            }
-        }
-        trilookup.emplace(key, i); // add triangle index to multimap
-    }
-
-    // make sure every edge appears exactly twice in triangle list, with edges traversed in different directions
-    // build list of triangles incident on each vertex - single pass over tris list
-    for(v = 0; v < (int) verts.size(); v++)
-        incident.push_back(incempty);
-    for(t = 0; t < (int) tris.size(); t++)
-        for(i = 0; i < 3; i++)
-            incident[tris[t].v[i]].push_back(t);
-
-    // make sure edges match up around each vertex. Each edge is shared by two triangles with opposite directions - single pass over incident list
-    for(i = 0; i < (int) incident.size(); i++)
+    int nv = (int) verts.size(), nt = (int) tris.size(), nthreads = 1;
+    vector<int> start, corners;
+
+    // counting sort of triangle corners by vertex, so that each vertex sees its incident triangles
+    bucketSort(nv, nt * 3, [this](int c){ return tris[c/3].v[c%3]; }, start, corners);
+
+#ifdef _OPENMP
+    nthreads = omp_get_max_threads();
+#endif
+    vector<ManifoldReport> local(nthreads);
+
+    // Each edge and each triangle is reported by its lowest numbered vertex only, so one parallel pass over the
+    // vertices sees every directed edge sorted by (min, max) key and every triangle sorted by its vertex set.
+    // Static scheduling gives each thread a contiguous range of vertices, so merging in thread order keeps the
+    // defects ordered by vertex.
+    #pragma omp parallel if(nv > 16384)
     {
-
-        // note: this edge counting approach does not pick up cases where two surfaces touch at a single vertex
-        edges.clear();
-        // gather incident edges
-        for(j = 0; j < (int) incident[i].size(); j++)
+        int th = 0;
+#ifdef _OPENMP
+        th = omp_get_thread_num();
+#endif
+        ManifoldReport & found = local[th];
+        vector<uint64_t> edges, links, faces;   // packed (other vertex, direction), (after, before) and (mid, max)
+
+        #pragma omp for schedule(static)
+        for(int v = 0; v < nv; v++)
         {
-            t = (incident[i])[j]; // index of incident triangle
-            for(k = 0; k < 3; k++) // gather edges incident on vertex
+            edges.clear(); links.clear(); faces.clear();
+            for(int j = start[v]; j < start[v+1]; j++)
             {
-                if(tris[t].v[k] == i) // vertex for incidence, gather edge before and after
-                {
-                    edge1.v[0] = i; edge1.v[1] = tris[t].v[(k+1)%3]; // outgoing edge
-                    edges.push_back(edge1);
+                int t = corners[j] / 3, k = corners[j] % 3;
+                const int * tv = tris[t].v;
+                uint32_t a = (uint32_t) tv[(k+1)%3], b = (uint32_t) tv[(k+2)%3];
 
-                    // incoming edge
-                    edge2.v[0] = tris[t].v[(k+2)%3]; edge2.v[1] = i; // incoming edge
-                    edges.push_back(edge2);
+                if((int) a == v || (int) b == v || a == b)
+                {
+                    // report once, from the first corner of the lowest vertex
+                    if(std::min(std::min(tv[0], tv[1]), tv[2]) == v && (tv[0] == v ? 0 : (tv[1] == v ? 1 : 2)) == k)
+                        found.degenerate.push_back(t);
+                    continue;
                 }
+                edges.push_back((uint64_t) a << 1 | 1); // triangle runs v to a
+                edges.push_back((uint64_t) b << 1);     // and b to v
+                links.push_back((uint64_t) a << 32 | b);
+                if((int) a > v && (int) b > v) // v is the lowest vertex, so this triangle is checked for duplicates here
+                    faces.push_back((uint64_t) std::min(a, b) << 32 | std::max(a, b));
             }
-        }
 
-        // compare edges - O(n^2) but small n
-        for(e = 0; e < (int) edges.size(); e++)
-        {
-            mcount = 0; ocount = 0;
-            for(erest = 0; erest < (int) edges.size(); erest++)
-            {
-                if(e != erest)
-                    if(sameEdge(edges[e], edges[erest], opposite))
+            // Triangles with the same vertex set. Duplicates are rare, so their triangles are found again by scanning,
+            // in increasing order, and all but the first are reported.
+            sortKeys(faces.data(), faces.data() + faces.size());
+            for(size_t f = 1; f < faces.size(); f++)
+                if(faces[f] == faces[f-1] && (f == 1 || faces[f-1] != faces[f-2]))
+                {
+                    bool first = true;
+                    for(int j = start[v]; j < start[v+1]; j++)
                     {
-                        if(opposite)
-                            ocount++;
-                        else
-                            mcount++;
+                        const int * tv = tris[corners[j] / 3].v;
+                        int a = tv[(corners[j]+1)%3], b = tv[(corners[j]+2)%3];
+                        if(a > v && b > v && ((uint64_t) std::min(a, b) << 32 | (uint64_t) std::max(a, b)) == faces[f])
+                        {
+                            if(!first)
+                                found.duptris.push_back(corners[j] / 3);
+                            first = false;
+                        }
                     }
-            }
-            if(ocount != 1 || mcount != 0) // only one matching edge wound oppositely
+                }
+
+            // Multiplicity and orientation of each edge in one scan over the runs of equal keys. All edges at v are
+            // checked for the fan test below, but only those to higher vertices are reported, so each appears once.
+            bool edgesok = true;
+            sortKeys(edges.data(), edges.data() + edges.size());
+            for(size_t e0 = 0, e1; e0 < edges.size(); e0 = e1)
             {
-                cerr << "Error Mesh::manifoldValidity(): edges do not have exactly two incident triangles correctly wound" << endl;
-                return false;
+                int w = (int) (edges[e0] >> 1), forward = 0;
+                for(e1 = e0; e1 < edges.size() && (int) (edges[e1] >> 1) == w; e1++)
+                    forward += (int) (edges[e1] & 1);
+                if(e1 - e0 == 2 && forward == 1)
+                    continue;
+                edgesok = false;
+                if(w < v)
+                    continue;
+                Edge edge;
+                edge.v[0] = v; edge.v[1] = w;
+                if(e1 - e0 == 1)
+                    found.boundary.push_back(edge);
+                else if(e1 - e0 > 2)
+                    found.nonmanifold.push_back(edge);
+                else
+                    found.misoriented.push_back(edge);
             }
-        }
 
-        // check for reachability - there should only be a single cycle around a vertex
-        // more efficient if this was combined with the previous loop but less readable
-        visited.clear(); visited.resize((int) incident[i].size(), false);
-        e = 0; visited[0] = true; fin = false;
-        while(!fin)
-        {
-            // find adjacent triangle to outgoing edge using incident edge table
-            found = false; erest = 0;
-            while(!found && erest < (int) edges.size())
+            // Where every edge is shared properly the triangles around v link a to b into cycles, and there must be
+            // only one. Vertices next to bad edges have already been reported through those edges.
+            if(edgesok && !links.empty())
             {
-                if(e != erest)
-                    if(sameEdge(edges[e], edges[erest], opposite))
+                sortKeys(links.data(), links.data() + links.size());
+                bool ok = true;
+                for(size_t l = 1; l < links.size(); l++)
+                    ok = ok && (links[l] >> 32) != (links[l-1] >> 32);
+                if(ok)
+                {
+                    size_t steps = 0;
+                    uint64_t first = links[0] & 0xffffffffULL, cur = first;
+                    do
                     {
-                        found = true;
-                        e = erest;
-
-                        // check if triangle is already visited
-                        if(visited[e/2])
-                            fin = true;
-                        else
-                            visited[e/2] = true;
-
-                        if(e % 2 == 0) // find outgoing edge, come in pairs
-                            e++;
-                        else
-                            e--;
-                    }
-                erest++;
+                        auto it = std::lower_bound(links.begin(), links.end(), cur << 32);
+                        if(it == links.end() || (*it >> 32) != cur)
+                            break;
+                        cur = *it & 0xffffffffULL;
+                        steps++;
+                    } while(cur != first && steps <= links.size());
+                    if(steps != links.size())
+                        found.pinched.push_back(v);
+                }
             }
         }
+    }
 
-        for(j = 0; j < (int) incident[i].size(); j++)
-        {
-            if(!visited[j])
-            {
-                cerr << "Error Mesh::manifoldValidity(): vertices do note have a single cycle of incident triangles" << endl;
-                return false;
-            }
-        }
+    report.clear();
+    for(int th = 0; th < nthreads; th++)
+    {
+        report.duptris.insert(report.duptris.end(), local[th].duptris.begin(), local[th].duptris.end());
+        report.degenerate.insert(report.degenerate.end(), local[th].degenerate.begin(), local[th].degenerate.end());
+        report.boundary.insert(report.boundary.end(), local[th].boundary.begin(), local[th].boundary.end());
+        report.nonmanifold.insert(report.nonmanifold.end(), local[th].nonmanifold.begin(), local[th].nonmanifold.end());
+        report.misoriented.insert(report.misoriented.end(), local[th].misoriented.begin(), local[th].misoriented.end());
+        report.pinched.insert(report.pinched.end(), local[th].pinched.begin(), local[th].pinched.end());
     }
 
     // For true 2-manifold validity it would also be necessary to see if the object is self-intersecting by testing triangles against
     // each other for intersection. This would require a spatial data structure such as a bounding sphere hierarchy to accelerate properly
     // which is beyond the scope of this assignment
+    return report.valid();
+}
+
+bool Mesh::manifoldValidity()
+{
+    ManifoldReport report;
+
+    if(manifoldValidity(report))
+        return true;
+
+    if(!report.duptris.empty())
+        cerr << "Error Mesh::manifoldValidity(): " << report.duptris.size() << " duplicate triangles found, first is triangle " << report.duptris[0] << endl;
+    if(!report.degenerate.empty())
+        cerr << "Error Mesh::manifoldValidity(): " << report.degenerate.size() << " degenerate triangles found, first is triangle " << report.degenerate[0] << endl;
+    if(!report.boundary.empty())
+        cerr << "Error Mesh::manifoldValidity(): " << report.boundary.size() << " boundary edges with only one incident triangle, first is "
+             << report.boundary[0].v[0] << "-" << report.boundary[0].v[1] << endl;
+    if(!report.nonmanifold.empty())
+        cerr << "Error Mesh::manifoldValidity(): " << report.nonmanifold.size() << " edges with more than two incident triangles, first is "
+             << report.nonmanifold[0].v[0] << "-" << report.nonmanifold[0].v[1] << endl;
+    if(!report.misoriented.empty())
+        cerr << "Error Mesh::manifoldValidity(): " << report.misoriented.size() << " edges whose triangles are not correctly wound, first is "
+             << report.misoriented[0].v[0] << "-" << report.misoriented[0].v[1] << endl;
+    if(!report.pinched.empty())
+        cerr << "Error Mesh::manifoldValidity(): " << report.pinched.size() << " vertices without a single cycle of incident triangles, first is vertex "
+             << report.pinched[0] << endl;
+    return false;
+}
+
+void Mesh::findComponents(MeshComponents & comp)
+{
+    int nv = (int) verts.size(), nt = (int) tris.size(), ncomp = 0, t, v, c;
+    ConcurrentUnionFind sets(nv);
+    vector<int> rep(nv), id(nv, 0);
+
+    // two unions per triangle join all three corners, in any order
+    #pragma omp parallel for if(nt > 65536)
+    for(t = 0; t < nt; t++)
+    {
+        sets.unite(tris[t].v[0], tris[t].v[1]);
+        sets.unite(tris[t].v[0], tris[t].v[2]);
+    }
+
+    #pragma omp parallel for if(nv > 65536)
+    for(v = 0; v < nv; v++)
+        rep[v] = sets.find(v);
+
+    // every set is rooted at its lowest vertex, so numbering the roots that carry triangles in vertex order
+    // gives the same labels on any number of threads
+    for(t = 0; t < nt; t++)
+        id[rep[tris[t].v[0]]] = 1;
+    for(v = 0; v < nv; v++)
+        if(id[v])
+            id[v] = ++ncomp;
+
+    comp.vertlabel.resize(nv);
+    #pragma omp parallel for if(nv > 65536)
+    for(v = 0; v < nv; v++)
+        comp.vertlabel[v] = id[rep[v]] - 1;
+    comp.trilabel.resize(nt);
+    #pragma omp parallel for if(nt > 65536)
+    for(t = 0; t < nt; t++)
+        comp.trilabel[t] = comp.vertlabel[tris[t].v[0]];
+
+    bucketSort(ncomp, nt, [&comp](int e){ return comp.trilabel[e]; }, comp.tstart, comp.ctris);
+
+    // unused vertices go into an extra bucket at the end that is then dropped
+    bucketSort(ncomp + 1, nv, [&comp, ncomp](int e){ return comp.vertlabel[e] < 0 ? ncomp : comp.vertlabel[e]; }, comp.vstart, comp.cverts);
+    comp.vstart.pop_back();
+    comp.cverts.resize(comp.vstart.back());
+
+    comp.vertrank.assign(nv, -1);
+    comp.bbox.assign(ncomp, cgp::BoundBox());
+    #pragma omp parallel for if(nv > 65536) schedule(dynamic, 16)
+    for(c = 0; c < ncomp; c++)
+        for(int i = comp.vstart[c]; i < comp.vstart[c+1]; i++)
+        {
+            comp.vertrank[comp.cverts[i]] = i - comp.vstart[c];
+            comp.bbox[c].includePnt(verts[comp.cverts[i]]);
+        }
+}
+
+void Mesh::extractComponent(const MeshComponents & comp, int c, Mesh & part)
+{
+    int i, p, nv = comp.numVerts(c), nt = comp.numTris(c);
+    bool hasnorms = norms.size() == verts.size();
+
+    part.clear();
+    part.col = col;
+    part.scale = scale;
+    part.trx = trx;
+    part.xrot = xrot; part.yrot = yrot; part.zrot = zrot;
+
+    part.verts.resize(nv);
+    part.norms.resize(hasnorms ? nv : 0);
+    for(i = 0; i < nv; i++)
+    {
+        int v = comp.cverts[comp.vstart[c] + i];
+        part.verts[i] = verts[v];
+        if(hasnorms)
+            part.norms[i] = norms[v];
+    }
+
+    part.tris.resize(nt);
+    for(i = 0; i < nt; i++)
+    {
+        const Triangle & src = tris[comp.ctris[comp.tstart[c] + i]];
+        for(p = 0; p < 3; p++)
+            part.tris[i].v[p] = comp.vertrank[src.v[p]];
+        part.tris[i].n = src.n;
+    }
+}
+
+int Mesh::removeSmallComponents(int mintris)
+{
+    MeshComponents comp;
+    int nv = (int) verts.size(), nt = (int) tris.size(), removed = 0, t, v, p, c, nkept;
+    vector<int> remap(nv, -1);
+
+    findComponents(comp);
+    for(c = 0; c < comp.size(); c++)
+        if(comp.numTris(c) < mintris)
+            removed++;
+    if(removed == 0)
+        return 0;
+
+    // compact in place, keeping the relative order of what survives and any vertices not used by a triangle
+    bool hasnorms = norms.size() == verts.size(), hasbase = base.size() == verts.size();
+    nkept = 0;
+    for(v = 0; v < nv; v++)
+    {
+        c = comp.vertlabel[v];
+        if(c >= 0 && comp.numTris(c) < mintris)
+            continue;
+        remap[v] = nkept;
+        verts[nkept] = verts[v];
+        if(hasnorms)
+            norms[nkept] = norms[v];
+        if(hasbase)
+            base[nkept] = base[v];
+        nkept++;
+    }
+    verts.resize(nkept);
+    if(hasnorms)
+        norms.resize(nkept);
+    if(hasbase)
+        base.resize(nkept);
+
+    nkept = 0;
+    for(t = 0; t < nt; t++)
+    {
+        if(comp.numTris(comp.trilabel[t]) < mintris)
+            continue;
+        tris[nkept] = tris[t];
+        for(p = 0; p < 3; p++)
+            tris[nkept].v[p] = remap[tris[t].v[p]];
+        nkept++;
+    }
+    tris.resize(nkept);
+    topologyChanged();
+    return removed;
+}
+
+int Mesh::simplify(int targetTris, float maxError)
+{
+    QuadricSimplifier simp(verts, tris, getAdjacency());
+    int remaining = simp.simplify(targetTris, maxError);
+
+    simplified();
+    return remaining;
+}
+
+int Mesh::simplifyParallel(int targetTris, float maxError)
+{
+    QuadricSimplifier simp(verts, tris, getAdjacency());
+    int remaining = simp.simplifyParallel(targetTris, maxError);
+
+    simplified();
+    return remaining;
+}
+
+void Mesh::optimizeLocality()
+{
+    VertexCacheOptimizer vco;
+    vector<int> order;
+    int nv = (int) verts.size(), v;
+
+    vco.optimize(tris, nv);
+    vco.reorderVertices(tris, nv, order);
+
+    vector<cgp::Point> newverts(nv);
+    for(v = 0; v < nv; v++)
+        newverts[v] = verts[order[v]];
+    verts.swap(newverts);
+    if((int) norms.size() == nv)
+    {
+        vector<cgp::Vector> newnorms(nv);
+        for(v = 0; v < nv; v++)
+            newnorms[v] = norms[order[v]];
+        norms.swap(newnorms);
+    }
+    if((int) base.size() == nv)
+    {
+        for(v = 0; v < nv; v++)
+            newverts[v] = base[order[v]];
+        base.swap(newverts);
+    }
+    topologyChanged();
+    boundspheres.clear();
+}
+
+void Mesh::simplified()
+{
+    topologyChanged();
+    deriveFaceNorms();
+    deriveVertNorms();
+    setBase();
+}
+
+bool Mesh::connectionValidity()
+{
+    MeshComponents comp;
+
+    findComponents(comp);
+    if(comp.size() > 1)
+    {
+        cerr << "Error Mesh::connectionValidity(): mesh is split into " << comp.size() << " components, the largest has "
+             << comp.numTris(comp.largest()) << " of " << (int) tris.size() << " triangles" << endl;
+        return false;
+    }
     return true;
 }
 
@@ -1758,3 +3380,33 @@ void Mesh::basicBreakTest()
     t.v[0] = 2; t.v[1] = 3; t.v[2] = 4;
     tris.push_back(t);
 }
+
+MeshInstance::MeshInstance(std::shared_ptr<Mesh> geometry)
+{
+    mesh = geometry;
+    placement = glm::mat4(1.0f);
+    inverse = glm::mat4(1.0f);
+}
+
+void MeshInstance::setPlacement(const glm::mat4x4 & tfm)
+{
+    placement = tfm;
+    inverse = glm::inverse(tfm);
+}
+
+void MeshInstance::setTranslation(cgp::Vector tvec)
+{
+    setPlacement(glm::translate(glm::mat4(1.0f), glm::vec3(tvec.i, tvec.j, tvec.k)));
+}
+
+void MeshInstance::genGeometry(ShapeGeometry * geom, View * view)
+{
+    mesh->genGeometry(geom, view, placement);
+}
+
+bool MeshInstance::pointContainment(cgp::Point pnt)
+{
+    glm::vec4 local = inverse * glm::vec4(pnt.x, pnt.y, pnt.z, 1.0f);
+
+    return mesh->pointContainment(cgp::Point(local.x, local.y, local.z));
+}
@@ -13,7 +13,12 @@
 #include "renderer.h"
 #include "ffd.h"
 #include "voxels.h"
+#include "halfedge.h"
+#include "normals.h"
+#include "bvh.h"
 #include <unordered_set>
+#include <memory>
+#include <stdint.h>
 
 using namespace std;
 
@@ -88,6 +93,81 @@ struct Edge
     int v[2];   ///< indices into the vertex list for edge endpoints
 };
 
+/**
+ * Every defect found by @ref Mesh::manifoldValidity, with edges given lowest vertex first and lists ordered by vertex
+ */
+struct ManifoldReport
+{
+    std::vector<int> duptris;       ///< triangles with the same vertices as a lower numbered triangle
+    std::vector<int> degenerate;    ///< triangles that use a vertex more than once
+    std::vector<Edge> boundary;     ///< edges with only one incident triangle
+    std::vector<Edge> nonmanifold;  ///< edges with more than two incident triangles
+    std::vector<Edge> misoriented;  ///< edges whose two triangles traverse them in the same direction
+    std::vector<int> pinched;       ///< vertices whose incident triangles form more than one fan
+
+    /// Remove all defects
+    void clear(){ duptris.clear(); degenerate.clear(); boundary.clear(); nonmanifold.clear(); misoriented.clear(); pinched.clear(); }
+
+    /// Whether no defects were found
+    bool valid() const
+    {
+        return duptris.empty() && degenerate.empty() && boundary.empty() && nonmanifold.empty() && misoriented.empty() && pinched.empty();
+    }
+};
+
+/**
+ * Compressed sparse row adjacency of a triangle mesh. The entries for vertex v occupy [start[v], start[v+1])
+ * of the corresponding index array.
+ */
+struct MeshAdjacency
+{
+    std::vector<int> vtstart;   ///< offsets into vtris, one per vertex followed by the total
+    std::vector<int> vtris;     ///< triangles incident on each vertex, in increasing order
+    std::vector<int> vvstart;   ///< offsets into vverts, one per vertex followed by the total
+    std::vector<int> vverts;    ///< distinct vertices sharing an edge with each vertex, in increasing order
+
+    /// Number of triangles incident on vertex @a v
+    int numTris(int v) const { return vtstart[v+1] - vtstart[v]; }
+
+    /// Number of distinct vertices sharing an edge with vertex @a v
+    int numNeighbours(int v) const { return vvstart[v+1] - vvstart[v]; }
+};
+
+/**
+ * Edge-connected components of a triangle mesh, numbered in order of their lowest vertex. Triangles and vertices of
+ * component c occupy [start[c], start[c+1]) of the corresponding grouped array, each in increasing order.
+ */
+struct MeshComponents
+{
+    std::vector<int> trilabel;      ///< component of each triangle
+    std::vector<int> vertlabel;     ///< component of each vertex, or -1 if no triangle uses it
+    std::vector<int> tstart;        ///< offsets into ctris, one per component followed by the total
+    std::vector<int> ctris;         ///< triangles grouped by component
+    std::vector<int> vstart;        ///< offsets into cverts, one per component followed by the total
+    std::vector<int> cverts;        ///< used vertices grouped by component
+    std::vector<int> vertrank;      ///< position of each vertex within its component's group, or -1 if unused
+    std::vector<cgp::BoundBox> bbox;///< bounding box of the vertices of each component
+
+    /// Number of components
+    int size() const { return (int) bbox.size(); }
+
+    /// Number of triangles in component @a c
+    int numTris(int c) const { return tstart[c+1] - tstart[c]; }
+
+    /// Number of vertices in component @a c
+    int numVerts(int c) const { return vstart[c+1] - vstart[c]; }
+
+    /// Index of the component with the most triangles, or -1 if there are none
+    int largest() const
+    {
+        int best = -1;
+        for(int c = 0; c < size(); c++)
+            if(best < 0 || numTris(c) > numTris(best))
+                best = c;
+        return best;
+    }
+};
+
 /**
  * Abstract base class for shapes
  */
@@ -263,6 +343,29 @@ private:
     cgp::Vector trx;                 ///< translation
     float xrot, yrot, zrot;     ///< rotation angles about x, y, and z axes
     std::vector<Sphere> boundspheres; ///< bounding sphere accel structure
+    MeshAdjacency adjacency;    ///< vertex adjacency, valid only while adjvalid is set
+    bool adjvalid;              ///< whether adjacency matches the current triangles
+    HalfEdgeMesh halfedges;     ///< half-edge connectivity, valid only while hevalid is set
+    bool hevalid;               ///< whether halfedges matches the current triangles
+    NormalEngine normalengine;  ///< face and vertex normal computation, with the chosen weighting
+    FFDEmbedding ffdembed;      ///< base vertices embedded in the last lattice applied, valid only while ffdvalid is set
+    const ffd * ffdlattice;     ///< lattice last applied by applyFFD
+    bool ffdvalid;              ///< whether verts are base deformed by the control points recorded in ffdembed
+    TriangleBVH bvh;            ///< hierarchy over the transformed triangles for containment, rebuilt on demand once invalidated
+
+    /// Discard connectivity derived from the triangles after they have changed
+    void topologyChanged(){ adjvalid = false; hevalid = false; ffdvalid = false; bvh.invalidate(); }
+
+    /// Take the current vertices as the undeformed base for later deformation
+    void setBase(){ base = verts; ffdvalid = false; bvh.invalidate(); }
+
+    /**
+     * Bring the containment hierarchy up to date with the vertices, triangles and transformation, rebuilding it if
+     * any has changed since it was built. Safe to call from several threads at once, provided none of them is
+     * changing the mesh.
+     * @param tfm   current transformation from model to world space
+     */
+    void updateBVH(const glm::mat4x4 & tfm);
 
     /**
      * Search list of vertices to find matching point
@@ -289,15 +392,9 @@ private:
      */
     long hashEdge(int v0, int v1);
 
-    /// Connect triangles together by merging duplicate vertices
+    /// Connect triangles together by merging duplicate vertices, discretised as by @ref hashVert
     void mergeVerts();
 
-    /// Generate vertex normals by averaging normals of the surrounding faces
-    void deriveVertNorms();
-
-    /// Generate face normals from triangle vertex positions
-    void deriveFaceNorms();
-
     /**
      * Composite rotations, translation and scaling into a single transformation matrix
      * @param tfm   composited transformation matrix
@@ -305,23 +402,9 @@ private:
     void buildTransform(glm::mat4x4 &tfm);
 
     /**
-     * Compare two Triangles to see if they index the same vertices
-     * @param t1    first triangle
-     * @param t2    second triangle
-     * @return true if the triangles are the same
-     * @return false otherwise
+     * Build vertex to triangle and vertex to vertex adjacency by a parallel counting sort of triangle corners
      */
-    bool sameTriangle(Triangle t1, Triangle t2);
-
-    /**
-     * Compare two Edges to see if they index the same vertices
-     * @param e1    first edge
-     * @param e2    second edge
-     * @param[out] opposite true if the edges traverse in opposite directions
-     * @return true if the edges index the same vertices
-     * @return false otherwise
-     */
-    bool sameEdge(Edge e1, Edge e2, bool & opposite);
+    void buildAdjacency();
 
     /**
      * Create bounding sphere acceleration structure for mesh
@@ -329,6 +412,86 @@ private:
      */
     void buildSphereAccel(int maxspheres);
 
+    /**
+     * Weld a triangle soup into the vertex and triangle lists. Triangles are split into contiguous chunks that are
+     * decoded and welded into per-thread tables, which are then merged in a single pass. Vertices are numbered in
+     * order of first use, as with @ref mergeVerts.
+     * @param numt      number of triangles in the soup
+     * @param record    callable record(t, rec) that fills rec[12] with the normal and 3 vertices of triangle t
+     */
+    template<typename RecordFn> void weldRecords(long numt, RecordFn record);
+
+    /**
+     * Decode an in-memory binary STL file. The triangle list is sized up front from the header triangle count
+     * and the fixed-size 50-byte records are welded in place.
+     * @param buf   file contents, starting with the 80 byte header
+     * @param len   number of bytes in buf
+     * @retval true  if the buffer holds a well-formed binary STL,
+     * @retval false otherwise.
+     */
+    bool decodeBinarySTL(const char * buf, long len);
+
+    /**
+     * Decode an in-memory ASCII STL file. The text is split at facet boundaries and tokenized in parallel
+     * without copying or null-terminating the buffer, then welded like a binary file.
+     * @param buf   file contents
+     * @param len   number of bytes in buf
+     * @retval true  if the buffer holds a well-formed ASCII STL with at least one facet,
+     * @retval false otherwise.
+     */
+    bool decodeASCIISTL(const char * buf, long len);
+
+    /**
+     * Decode an in-memory STL file in either binary or ASCII format
+     * @param buf   file contents
+     * @param len   number of bytes in buf
+     * @retval true  if the buffer holds a well-formed STL,
+     * @retval false otherwise.
+     */
+    bool decodeSTL(const char * buf, long len);
+
+    /**
+     * Read STL by streaming the whole file into a buffer. Fallback for pipes and other inputs that cannot be memory mapped.
+     * @param filename  name of file to load (STL format)
+     * @retval true  if load succeeds,
+     * @retval false otherwise.
+     */
+    bool readSTLStream(string filename);
+
+    /// Derive normals and check validity of a freshly loaded mesh
+    void finishLoad();
+
+    /**
+     * Pack a range of triangles into consecutive 50-byte binary STL records. Large ranges are encoded in parallel.
+     * @param[out] buf  destination with room for (t1 - t0) records
+     * @param t0        first triangle to encode
+     * @param t1        one past the last triangle to encode
+     */
+    void encodeSTL(char * buf, long t0, long t1);
+
+    /**
+     * Save the welded mesh with its vertex normals to a .tmesh cache file, tagged with the identity of its source
+     * @param filename  name of cache file to write
+     * @param srchash   content hash of the source STL file
+     * @param srcsize   size in bytes of the source STL file
+     * @retval true  if save succeeds,
+     * @retval false otherwise.
+     */
+    bool writeCache(string filename, uint64_t srchash, uint64_t srcsize);
+
+    /**
+     * Load a mesh from a .tmesh cache file with a single mapping and no welding or normal derivation
+     * @param filename  name of cache file to read
+     * @param srchash   content hash the cache must have been created from
+     * @param srcsize   size in bytes the source must have had
+     * @retval true  if the cache exists, matches the source and is intact,
+     * @retval false otherwise, leaving the mesh unchanged unless the cache was corrupt.
+     */
+    bool readCache(string filename, uint64_t srchash, uint64_t srcsize);
+
+    /// Rederive normals and the deformation base after the simplifier has rewritten the vertices and triangles
+    void simplified();
+
 public:
 
     ShapeGeometry geometry;         ///< renderable version of mesh
@@ -346,19 +509,19 @@ public:
     bool empty(){ return verts.empty(); }
 
     /// Setter for scale
-    void setScale(float scf){ scale = scf; }
+    void setScale(float scf){ scale = scf; bvh.invalidate(); }
 
     /// Getter for scale
     float getScale(){ return scale; }
 
     /// Setter for translation
-    void setTranslation(cgp::Vector tvec){ trx = tvec; }
+    void setTranslation(cgp::Vector tvec){ trx = tvec; bvh.invalidate(); }
 
     /// Getter for translation
     cgp::Vector getTranslation(){ return trx; }
 
     /// Setter for rotation angles
-    void setRotations(float ax, float ay, float az){ xrot = ax; yrot = ay; zrot = az; }
+    void setRotations(float ax, float ay, float az){ xrot = ax; yrot = ay; zrot = az; bvh.invalidate(); }
 
     /// Getter for rotation angles
     void getRotations(float &ax, float &ay, float &az){ ax = xrot; ay = yrot; az = zrot; }
@@ -371,8 +534,23 @@ public:
 
     void mergeAllVerts() { mergeVerts(); }
 
-    /// Getter for vertices
-    vector<cgp::Point>* getVerts() { return &verts; }
+    /**
+     * Weld coincident vertices with a configurable tolerance, using a parallel sort rather than hashing
+     * @param tolerance  size of the grid cells within which vertices are merged, or 0 to merge only vertices with identical coordinates
+     */
+    void weldVerts(float tolerance);
+
+    /// Getter for vertices. The caller may move them, so they are no longer assumed to follow the last deformation.
+    vector<cgp::Point>* getVerts() { ffdvalid = false; bvh.invalidate(); return &verts; }
+
+    /// Getter for vertex normals, empty until derived
+    const vector<cgp::Vector> & getVertNorms(){ return norms; }
+
+    /// Generate vertex normals by a weighted average of the normals of the surrounding faces, replacing any already present
+    void deriveVertNorms();
+
+    /// Generate face normals from triangle vertex positions, in parallel SIMD batches
+    void deriveFaceNorms();
 
     /// Getter for number of faces
     int getNumFaces(){ return (int) tris.size(); }
@@ -380,8 +558,34 @@ public:
     /// Merge meshses
     void mergeMesh(Mesh * m2, bool lastCall=false);
 
+    /**
+     * Vertex adjacency of the mesh, rebuilt on demand after the triangles have changed
+     * @returns adjacency, valid until the next change to the triangles
+     */
+    const MeshAdjacency & getAdjacency();
+
+    /**
+     * Half-edge connectivity of the mesh, rebuilt on demand after the triangles have changed and kept up to date
+     * by @ref flipEdge
+     * @returns half-edges, valid until the next change to the triangles
+     */
+    const HalfEdgeMesh & getHalfEdges();
+
+    /**
+     * Flip an interior edge, updating the triangles, their normals, the normals of their four vertices if vertex
+     * normals have been derived, and the half-edge connectivity in place
+     * @param h     half-edge, as numbered by @ref getHalfEdges, of the edge to flip
+     * @retval true  if the edge was flipped,
+     * @retval false if it lies on a boundary or the result would duplicate an existing edge
+     */
+    bool flipEdge(int h);
+
+    /// Mark derived connectivity as stale. Needed only after changing triangles through a pointer obtained earlier.
+    void invalidateTopology(){ topologyChanged(); }
+
     /// Setter for cube triangles
     void setCubeTriangles() {
+        topologyChanged();
         tris.clear();
         Triangle t;
         t.v[0] = 1; t.v[1] = 2; t.v[2] = 3; // front
@@ -415,8 +619,9 @@ public:
         tris.push_back(t);
     }
 
-    // Getter for cube triangles
+    // Getter for cube triangles. The caller may change them, so derived connectivity is invalidated.
     vector<Triangle>* getCubeTriangles() {
+        topologyChanged();
         return &tris;
     }
 
@@ -437,13 +642,28 @@ public:
     void genGeometry(ShapeGeometry * geom, View * view);
 
     /**
-     * Test whether a point falls inside the mesh using ray-mesh intersection tests
+     * Generate triangle mesh geometry for OpenGL rendering, placed by an additional transformation
+     * @param[out] geom     triangle-mesh geometry packed for OpenGL
+     * @param view          current view parameters
+     * @param placement     transformation applied after the mesh's own scale, rotation and translation
+     */
+    void genGeometry(ShapeGeometry * geom, View * view, const glm::mat4x4 & placement);
+
+    /**
+     * Test whether a point falls inside the mesh using ray-mesh intersection tests, accelerated by a bounding volume
+     * hierarchy over the transformed triangles that is rebuilt when the geometry or transformation changes
      * @param pnt   point to test for containment
      * @retval true if the point falls within the mesh, 
      * @retval false otherwise
      */
     bool pointContainment(cgp::Point pnt);
 
+    /**
+     * Triangles placed in world space by the mesh transformation, packed for @ref scanConvertTriangles
+     * @param[out] packed   9 floats per triangle, its three transformed vertices
+     */
+    void getWorldTriangles(std::vector<float> & packed);
+
     /**
      * Scale geometry to fit bounding cube centered at origin
      * @param sidelen   length of one side of the bounding cube
@@ -456,6 +676,14 @@ public:
      */
     void marchingCubes(VoxelVolume * vox);
 
+    /**
+     * Generate the blocky surface of the occupied voxels, merging coplanar exposed faces into maximal rectangles.
+     * Rectangles are split wherever the corner of another touches their edges, so the result is watertight and free
+     * of T-junctions.
+     * @param vox           voxel volume, whose frame places each voxel as a cube in world space
+     */
+    void greedyMesh(VoxelVolume * vox);
+
     /**
      * Apply in-place simple Laplacian smoothing to the mesh
      * @param iter  number of smoothing iterations
@@ -464,13 +692,17 @@ public:
     void laplacianSmooth(int iter, float rate);
 
     /**
-     * Apply a free-form deformation to the mesh
+     * Apply a free-form deformation to the base mesh. When the same lattice was last applied and only its control
+     * points have since moved, only the vertices they influence are moved, by the weighted displacement of each
+     * control point, and only normals around those vertices are refreshed. Otherwise the base vertices are embedded
+     * in the lattice afresh.
      * @param lat   ffd lattice being applied
      */
     void applyFFD(ffd * lat);
 
     /**
-     * Read in triangle mesh from STL format binary file
+     * Read in triangle mesh from STL format file, binary or ASCII. Regular files are memory mapped and decoded without
+     * an intermediate copy; anything that cannot be mapped is streamed instead.
      * @param filename  name of file to load (STL format)
      * @retval true  if load succeeds,
      * @retval false otherwise.
@@ -478,13 +710,59 @@ public:
     bool readSTL(string filename);
 
     /**
-     * Write triangle mesh to STL format binary file
+     * Read in triangle mesh from STL format file via a sidecar cache named filename.tmesh. The cache is used
+     * when it was generated from identical file contents, and otherwise the STL is loaded as by @ref readSTL
+     * and the cache is rewritten.
+     * @param filename  name of file to load (STL format)
+     * @retval true  if load succeeds,
+     * @retval false otherwise.
+     */
+    bool readSTLCached(string filename);
+
+    /**
+     * Write triangle mesh to STL format binary file. Records are packed into a reusable buffer and written in large blocks.
      * @param filename  name of file to save (STL format)
      * @retval true  if save succeeds,
      * @retval false otherwise.
      */
     bool writeSTL(string filename);
 
+    /**
+     * Write indexed triangle mesh, with vertex normals if derived, to binary little-endian PLY format file.
+     * Shared vertices are stored once, unlike STL.
+     * @param filename  name of file to save (PLY format)
+     * @retval true  if save succeeds,
+     * @retval false otherwise.
+     */
+    bool writePLY(string filename);
+
+    /**
+     * Write indexed triangle mesh, with vertex normals if derived, to Wavefront OBJ format text file
+     * @param filename  name of file to save (OBJ format)
+     * @retval true  if save succeeds,
+     * @retval false otherwise.
+     */
+    bool writeOBJ(string filename);
+
+    /**
+     * Write triangle mesh to a compact archive. Vertex positions are quantised to the bounding box and triangles are
+     * reordered for locality so that positions and indices delta code to small values, which are then entropy coded.
+     * Normals are not stored but rederived on reading.
+     * @param filename  name of file to save
+     * @param bits      quantisation bits per coordinate, from 4 to 24
+     * @retval true  if save succeeds,
+     * @retval false otherwise.
+     */
+    bool writeArchive(string filename, int bits = 16);
+
+    /**
+     * Read in triangle mesh from an archive written by @ref writeArchive
+     * @param filename  name of file to load
+     * @retval true  if load succeeds,
+     * @retval false otherwise.
+     */
+    bool readArchive(string filename);
+
     /**
      * Read in 3D vector data from file
      * @param filename  name of file to read
@@ -506,21 +784,85 @@ public:
     bool basicValidity();
 
     /**
-     * Check that the mesh is a closed two-manifold
+     * Check that the mesh is a closed two-manifold, printing a summary of each kind of defect
      * @retval true if the mesh is two-manifold,
      * @retval false otherwise
-     * @todo manifoldValidity requires completing for CGP Prac1
      */
     bool manifoldValidity();
 
+    /**
+     * Check that the mesh is a closed two-manifold and collect every defect rather than stopping at the first.
+     * Runs in time linear in the number of triangles, in parallel over vertices.
+     * @param[out] report   all duplicate or degenerate triangles, bad edges and pinched vertices
+     * @retval true if the mesh is two-manifold,
+     * @retval false otherwise
+     */
+    bool manifoldValidity(ManifoldReport & report);
+
     /**
      * Test that the mesh forms a single connected structure
-     * @retval true if any vertex can be reached by edge traversal from any other
+     * @retval true if any vertex used by a triangle can be reached by edge traversal from any other
      * @retval false otherwise
-     * @todo connectionValidity requires completing for CGP Prac1
      */
     bool connectionValidity();
 
+    /**
+     * Label the edge-connected components of the mesh with a lock-free parallel union-find over triangle edges
+     * @param[out] comp     component of every triangle and vertex, with per-component counts and bounding boxes
+     */
+    void findComponents(MeshComponents & comp);
+
+    /**
+     * Copy a single component into another mesh, touching only its own triangles and vertices. The vertices keep
+     * their relative order, and the normals and placement of this mesh are carried over.
+     * @param comp      components found by @ref findComponents since the last change to the mesh
+     * @param c         index of the component to extract
+     * @param[out] part mesh that is replaced by the component
+     */
+    void extractComponent(const MeshComponents & comp, int c, Mesh & part);
+
+    /**
+     * Delete components with fewer than @a mintris triangles, such as floating debris left by marching cubes,
+     * along with their vertices
+     * @param mintris   smallest number of triangles a component needs to be kept
+     * @returns number of components removed
+     */
+    int removeSmallComponents(int mintris);
+
+    /**
+     * Reduce the triangle count by collapsing edges in order of increasing quadric error, keeping the mesh manifold
+     * and open boundaries in place. Normals are rederived and the result becomes the base shape for deformation.
+     * @param targetTris    stop once no more than this many triangles remain
+     * @param maxError      stop once every remaining collapse would move the surface further than this, measured as
+     *                      a sum of squared distances to the original planes around each vertex
+     * @returns number of triangles remaining
+     */
+    int simplify(int targetTris, float maxError = HUGE_VALF);
+
+    /**
+     * As @ref simplify, but collapses edges within separate slabs of a large mesh in parallel before finishing serially
+     * across the slab boundaries. The result is independent of the number of threads, though not identical to that of
+     * @ref simplify. Meshes too small to split are simplified serially.
+     * @param targetTris    stop once no more than this many triangles remain
+     * @param maxError      stop once every remaining collapse has a larger quadric error
+     * @returns number of triangles remaining
+     */
+    int simplifyParallel(int targetTris, float maxError = HUGE_VALF);
+
+    /**
+     * Reorder the triangles for reuse of transformed vertices when drawn, then renumber the vertices in order of first
+     * use, so that the index buffer and traversals of the triangles walk the vertex arrays close to sequentially.
+     * The shape and winding of the mesh are unchanged.
+     */
+    void optimizeLocality();
+
+    /**
+     * Choose how face normals are weighted in vertex normals from now on, which takes effect when normals are
+     * next derived
+     * @param weight    uniform, area or angle weighting
+     */
+    void setNormalWeighting(NormalWeight weight){ normalengine.setWeighting(weight); }
+
     /**
      * Build a simple valid 2-manifold tetrahedron with correct winding
      */
@@ -547,4 +889,55 @@ public:
     void overlapTetTest();
 };
 
+/**
+ * A placed copy of a mesh that shares its geometry with every other instance of the same mesh, so that a scene of
+ * many identical parts holds the vertices and triangles once. The shared mesh is reference counted and is released
+ * with its last instance. It must not be changed while instanced.
+ */
+class MeshInstance: public BaseShape
+{
+private:
+    std::shared_ptr<Mesh> mesh; ///< shared geometry, including its own scale, rotation and translation
+    glm::mat4x4 placement;      ///< transformation from the shared mesh into the scene
+    glm::mat4x4 inverse;        ///< transformation from the scene back to the shared mesh
+
+public:
+
+    /**
+     * Constructor
+     * @param geometry  shared mesh, placed initially with the identity transformation
+     */
+    MeshInstance(std::shared_ptr<Mesh> geometry);
+
+    /// Getter for the shared mesh
+    const std::shared_ptr<Mesh> & getMesh(){ return mesh; }
+
+    /**
+     * Setter for the placement of this instance
+     * @param tfm   affine transformation applied after the shared mesh's own transformation
+     */
+    void setPlacement(const glm::mat4x4 & tfm);
+
+    /// Getter for the placement of this instance
+    const glm::mat4x4 & getPlacement(){ return placement; }
+
+    /// Place this instance by a translation only
+    void setTranslation(cgp::Vector tvec);
+
+    /**
+     * Generate triangle mesh geometry for OpenGL rendering, transforming the shared vertices and normals in bulk
+     * @param[out] geom triangle-mesh geometry packed for OpenGL
+     * @param view      current view parameters
+     */
+    void genGeometry(ShapeGeometry * geom, View * view);
+
+    /**
+     * Test whether a point falls inside the instance by taking it back into the frame of the shared mesh
+     * @param pnt   point to test for containment
+     * @retval true if the point falls within the instance,
+     * @retval false otherwise
+     */
+    bool pointContainment(cgp::Point pnt);
+};
+
 #endif
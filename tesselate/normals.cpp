@@ -0,0 +1,147 @@
+//
+// NormalEngine
+//
+
+#include "normals.h"
+#include "simd.h"
+#include "mesh.h"
+#include <math.h>
+#include <algorithm>
+
+using namespace std;
+
+// triangles gathered into structure-of-arrays form per batch, small enough to stay in the L1 cache
+static const int normalbatch = 256;
+
+void NormalEngine::faceNormals(const std::vector<cgp::Point> & verts, std::vector<Triangle> & tris)
+{
+    int nt = (int) tris.size(), nbatches = (nt + normalbatch - 1) / normalbatch, b;
+
+    #pragma omp parallel for if(nt > 65536) schedule(static)
+    for(b = 0; b < nbatches; b++)
+    {
+        float ux[normalbatch], uy[normalbatch], uz[normalbatch], vx[normalbatch], vy[normalbatch], vz[normalbatch];
+        int t0 = b * normalbatch, n = min(normalbatch, nt - t0), i = 0;
+
+        for(int j = 0; j < n; j++)
+        {
+            const int * tv = tris[t0 + j].v;
+            const cgp::Point & p0 = verts[tv[0]], & p1 = verts[tv[1]], & p2 = verts[tv[2]];
+            ux[j] = p1.x - p0.x; uy[j] = p1.y - p0.y; uz[j] = p1.z - p0.z;
+            vx[j] = p2.x - p0.x; vy[j] = p2.y - p0.y; vz[j] = p2.z - p0.z;
+        }
+
+        // the cross product overwrites the first edge, then is scaled to unit length
+#ifdef SIMD_WIDTH
+        const vfloat one = vset(1.0f);
+        for(; i + SIMD_WIDTH <= n; i += SIMD_WIDTH)
+        {
+            vfloat ax = vload(ux + i), ay = vload(uy + i), az = vload(uz + i);
+            vfloat bx = vload(vx + i), by = vload(vy + i), bz = vload(vz + i);
+            vfloat cx = vsub(vmul(ay, bz), vmul(az, by));
+            vfloat cy = vsub(vmul(az, bx), vmul(ax, bz));
+            vfloat cz = vsub(vmul(ax, by), vmul(ay, bx));
+            vfloat len = vsqrt(vadd(vadd(vmul(cx, cx), vmul(cy, cy)), vmul(cz, cz)));
+            vfloat inv = vpositive(len, vdiv(one, len));
+            vstore(ux + i, vmul(cx, inv));
+            vstore(uy + i, vmul(cy, inv));
+            vstore(uz + i, vmul(cz, inv));
+        }
+#endif
+        for(; i < n; i++)
+        {
+            float cx = uy[i] * vz[i] - uz[i] * vy[i], cy = uz[i] * vx[i] - ux[i] * vz[i], cz = ux[i] * vy[i] - uy[i] * vx[i];
+            float len = sqrtf(cx * cx + cy * cy + cz * cz);
+            if(len > 0.0f)
+                len = 1.0f / len;
+            ux[i] = cx * len; uy[i] = cy * len; uz[i] = cz * len;
+        }
+
+        for(int j = 0; j < n; j++)
+            tris[t0 + j].n = cgp::Vector(ux[j], uy[j], uz[j]);
+    }
+}
+
+void NormalEngine::vertexNormals(const std::vector<cgp::Point> & verts, const std::vector<Triangle> & tris, const MeshAdjacency & adj,
+                                 std::vector<cgp::Vector> & norms)
+{
+    int nv = (int) verts.size(), v;
+
+    norms.resize(nv);
+    #pragma omp parallel for if(nv > 65536) schedule(static)
+    for(v = 0; v < nv; v++)
+        norms[v] = vertexNormal(verts, tris, adj, v);
+}
+
+void NormalEngine::faceNormals(const std::vector<cgp::Point> & verts, std::vector<Triangle> & tris, const std::vector<int> & subset)
+{
+    int n = (int) subset.size(), s;
+
+    #pragma omp parallel for if(n > 65536) schedule(static)
+    for(s = 0; s < n; s++)
+        tris[subset[s]].n = faceNormal(verts, tris[subset[s]]);
+}
+
+void NormalEngine::vertexNormals(const std::vector<cgp::Point> & verts, const std::vector<Triangle> & tris, const MeshAdjacency & adj,
+                                 const std::vector<int> & subset, std::vector<cgp::Vector> & norms)
+{
+    int n = (int) subset.size(), s;
+
+    #pragma omp parallel for if(n > 65536) schedule(static)
+    for(s = 0; s < n; s++)
+        norms[subset[s]] = vertexNormal(verts, tris, adj, subset[s]);
+}
+
+cgp::Vector NormalEngine::faceNormal(const std::vector<cgp::Point> & verts, const Triangle & tri)
+{
+    const cgp::Point & p0 = verts[tri.v[0]], & p1 = verts[tri.v[1]], & p2 = verts[tri.v[2]];
+    float ux = p1.x - p0.x, uy = p1.y - p0.y, uz = p1.z - p0.z;
+    float vx = p2.x - p0.x, vy = p2.y - p0.y, vz = p2.z - p0.z;
+    float cx = uy * vz - uz * vy, cy = uz * vx - ux * vz, cz = ux * vy - uy * vx;
+    float len = sqrtf(cx * cx + cy * cy + cz * cz);
+
+    // same arithmetic as the scalar tail of the batched version
+    if(len > 0.0f)
+        len = 1.0f / len;
+    return cgp::Vector(cx * len, cy * len, cz * len);
+}
+
+cgp::Vector NormalEngine::vertexNormal(const std::vector<cgp::Point> & verts, const std::vector<Triangle> & tris, const MeshAdjacency & adj, int v)
+{
+    float sx = 0.0f, sy = 0.0f, sz = 0.0f;
+
+    for(int a = adj.vtstart[v]; a < adj.vtstart[v+1]; a++)
+    {
+        const Triangle & tri = tris[adj.vtris[a]];
+        const cgp::Point & p0 = verts[tri.v[0]], & p1 = verts[tri.v[1]], & p2 = verts[tri.v[2]];
+
+        if(weighting == NormalWeight::UNIFORM)
+        {
+            sx += tri.n.i; sy += tri.n.j; sz += tri.n.k;
+        }
+        else if(weighting == NormalWeight::AREA)
+        {
+            // the unnormalised cross product is the normal scaled by twice the area
+            float ux = p1.x - p0.x, uy = p1.y - p0.y, uz = p1.z - p0.z;
+            float wx = p2.x - p0.x, wy = p2.y - p0.y, wz = p2.z - p0.z;
+            sx += uy * wz - uz * wy; sy += uz * wx - ux * wz; sz += ux * wy - uy * wx;
+        }
+        else
+        {
+            // angle between the two edges leaving this vertex
+            int k = tri.v[0] == v ? 0 : (tri.v[1] == v ? 1 : 2);
+            const cgp::Point & c = verts[tri.v[k]], & n1 = verts[tri.v[(k+1)%3]], & n2 = verts[tri.v[(k+2)%3]];
+            float ux = n1.x - c.x, uy = n1.y - c.y, uz = n1.z - c.z;
+            float wx = n2.x - c.x, wy = n2.y - c.y, wz = n2.z - c.z;
+            float lens = sqrtf((ux * ux + uy * uy + uz * uz) * (wx * wx + wy * wy + wz * wz));
+            if(lens > 0.0f)
+            {
+                float ang = acosf(max(-1.0f, min(1.0f, (ux * wx + uy * wy + uz * wz) / lens)));
+                sx += ang * tri.n.i; sy += ang * tri.n.j; sz += ang * tri.n.k;
+            }
+        }
+    }
+    cgp::Vector n(sx, sy, sz);
+    n.normalize();
+    return n;
+}
@@ -0,0 +1,93 @@
+#ifndef _NORMALS
+#define _NORMALS
+/**
+ * @file
+ *
+ * Parallel computation of face and vertex normals for triangle meshes.
+ */
+
+#include <vector>
+#include "vecpnt.h"
+
+struct Triangle;
+struct MeshAdjacency;
+
+/// How the normals of the triangles around a vertex are weighted in its normal
+enum class NormalWeight
+{
+    UNIFORM,    ///< every triangle counts equally
+    AREA,       ///< triangles count in proportion to their area, favouring large faces over slivers
+    ANGLE       ///< triangles count in proportion to their angle at the vertex, which is independent of tessellation
+};
+
+/**
+ * Computes unit face normals a SIMD batch of triangles at a time, and vertex normals by gathering over the
+ * triangles of each vertex in a CSR adjacency. Every vertex is written by one thread only, so no locks or per-thread
+ * copies are needed and the result does not depend on the number of threads.
+ */
+class NormalEngine
+{
+private:
+    NormalWeight weighting; ///< weighting of face normals in vertex normals
+
+public:
+
+    /**
+     * Constructor
+     * @param weight    weighting of face normals in vertex normals
+     */
+    NormalEngine(NormalWeight weight = NormalWeight::UNIFORM){ weighting = weight; }
+
+    /// Set the weighting of face normals in vertex normals
+    void setWeighting(NormalWeight weight){ weighting = weight; }
+
+    /// Current weighting of face normals in vertex normals
+    NormalWeight getWeighting(){ return weighting; }
+
+    /**
+     * Set the normal of every triangle by the right-hand rule, leaving degenerate triangles with a zero normal
+     * @param verts     vertex positions
+     * @param tris      triangles whose normals are overwritten
+     */
+    void faceNormals(const std::vector<cgp::Point> & verts, std::vector<Triangle> & tris);
+
+    /**
+     * Set the normal of every vertex as the weighted average of the normals of its triangles, which must be current
+     * for uniform and angle weighting. Vertices without triangles get a zero normal.
+     * @param verts     vertex positions
+     * @param tris      triangles with unit normals
+     * @param adj       adjacency giving the triangles of each vertex
+     * @param[out] norms    vertex normals, resized to match the vertices
+     */
+    void vertexNormals(const std::vector<cgp::Point> & verts, const std::vector<Triangle> & tris, const MeshAdjacency & adj,
+                       std::vector<cgp::Vector> & norms);
+
+    /**
+     * Set the normals of some triangles only, as @ref faceNormals does for all of them
+     * @param verts     vertex positions
+     * @param tris      triangles
+     * @param subset    indices of the triangles whose normals are overwritten
+     */
+    void faceNormals(const std::vector<cgp::Point> & verts, std::vector<Triangle> & tris, const std::vector<int> & subset);
+
+    /**
+     * Set the normals of some vertices only, as @ref vertexNormals does for all of them
+     * @param verts     vertex positions
+     * @param tris      triangles with unit normals
+     * @param adj       adjacency giving the triangles of each vertex
+     * @param subset    indices of the vertices whose normals are overwritten
+     * @param[out] norms    vertex normals, already sized to match the vertices
+     */
+    void vertexNormals(const std::vector<cgp::Point> & verts, const std::vector<Triangle> & tris, const MeshAdjacency & adj,
+                       const std::vector<int> & subset, std::vector<cgp::Vector> & norms);
+
+private:
+
+    /// Unit normal of a single triangle, or a zero vector if it is degenerate
+    cgp::Vector faceNormal(const std::vector<cgp::Point> & verts, const Triangle & tri);
+
+    /// Weighted normal of a single vertex
+    cgp::Vector vertexNormal(const std::vector<cgp::Point> & verts, const std::vector<Triangle> & tris, const MeshAdjacency & adj, int v);
+};
+
+#endif
@@ -0,0 +1,195 @@
+//
+// PointArray
+//
+
+#include "pointarray.h"
+#include "simd.h"
+#include <math.h>
+#include <algorithm>
+
+using namespace std;
+
+void PointArray::load(const std::vector<cgp::Point> & pnts)
+{
+    int i, n = (int) pnts.size();
+
+    resize(n);
+    for(i = 0; i < n; i++)
+    {
+        x[i] = pnts[i].x; y[i] = pnts[i].y; z[i] = pnts[i].z;
+    }
+}
+
+void PointArray::load(const std::vector<cgp::Vector> & vecs)
+{
+    int i, n = (int) vecs.size();
+
+    resize(n);
+    for(i = 0; i < n; i++)
+    {
+        x[i] = vecs[i].i; y[i] = vecs[i].j; z[i] = vecs[i].k;
+    }
+}
+
+void PointArray::store(std::vector<cgp::Point> & pnts) const
+{
+    int i, n = size();
+
+    pnts.resize(n);
+    for(i = 0; i < n; i++)
+    {
+        pnts[i].x = x[i]; pnts[i].y = y[i]; pnts[i].z = z[i];
+    }
+}
+
+void PointArray::store(std::vector<cgp::Vector> & vecs) const
+{
+    int i, n = size();
+
+    vecs.resize(n);
+    for(i = 0; i < n; i++)
+    {
+        vecs[i].i = x[i]; vecs[i].j = y[i]; vecs[i].k = z[i];
+    }
+}
+
+void PointArray::transform(const glm::mat4x4 & tfm)
+{
+    int i = 0, n = size();
+    float * px = x.data(), * py = y.data(), * pz = z.data();
+    // glm matrices are indexed by column then row
+    const float m00 = tfm[0][0], m01 = tfm[1][0], m02 = tfm[2][0], m03 = tfm[3][0];
+    const float m10 = tfm[0][1], m11 = tfm[1][1], m12 = tfm[2][1], m13 = tfm[3][1];
+    const float m20 = tfm[0][2], m21 = tfm[1][2], m22 = tfm[2][2], m23 = tfm[3][2];
+
+#ifdef SIMD_WIDTH
+    const vfloat a00 = vset(m00), a01 = vset(m01), a02 = vset(m02), a03 = vset(m03);
+    const vfloat a10 = vset(m10), a11 = vset(m11), a12 = vset(m12), a13 = vset(m13);
+    const vfloat a20 = vset(m20), a21 = vset(m21), a22 = vset(m22), a23 = vset(m23);
+    for(; i + SIMD_WIDTH <= n; i += SIMD_WIDTH)
+    {
+        vfloat vx = vload(px + i), vy = vload(py + i), vz = vload(pz + i);
+        vstore(px + i, vadd(vadd(vadd(vmul(a00, vx), vmul(a01, vy)), vmul(a02, vz)), a03));
+        vstore(py + i, vadd(vadd(vadd(vmul(a10, vx), vmul(a11, vy)), vmul(a12, vz)), a13));
+        vstore(pz + i, vadd(vadd(vadd(vmul(a20, vx), vmul(a21, vy)), vmul(a22, vz)), a23));
+    }
+#endif
+    for(; i < n; i++)
+    {
+        float vx = px[i], vy = py[i], vz = pz[i];
+        px[i] = m00 * vx + m01 * vy + m02 * vz + m03;
+        py[i] = m10 * vx + m11 * vy + m12 * vz + m13;
+        pz[i] = m20 * vx + m21 * vy + m22 * vz + m23;
+    }
+}
+
+void PointArray::transformVectors(const glm::mat3x3 & tfm)
+{
+    int i = 0, n = size();
+    float * px = x.data(), * py = y.data(), * pz = z.data();
+    const float m00 = tfm[0][0], m01 = tfm[1][0], m02 = tfm[2][0];
+    const float m10 = tfm[0][1], m11 = tfm[1][1], m12 = tfm[2][1];
+    const float m20 = tfm[0][2], m21 = tfm[1][2], m22 = tfm[2][2];
+
+#ifdef SIMD_WIDTH
+    const vfloat a00 = vset(m00), a01 = vset(m01), a02 = vset(m02);
+    const vfloat a10 = vset(m10), a11 = vset(m11), a12 = vset(m12);
+    const vfloat a20 = vset(m20), a21 = vset(m21), a22 = vset(m22);
+    for(; i + SIMD_WIDTH <= n; i += SIMD_WIDTH)
+    {
+        vfloat vx = vload(px + i), vy = vload(py + i), vz = vload(pz + i);
+        vstore(px + i, vadd(vadd(vmul(a00, vx), vmul(a01, vy)), vmul(a02, vz)));
+        vstore(py + i, vadd(vadd(vmul(a10, vx), vmul(a11, vy)), vmul(a12, vz)));
+        vstore(pz + i, vadd(vadd(vmul(a20, vx), vmul(a21, vy)), vmul(a22, vz)));
+    }
+#endif
+    for(; i < n; i++)
+    {
+        float vx = px[i], vy = py[i], vz = pz[i];
+        px[i] = m00 * vx + m01 * vy + m02 * vz;
+        py[i] = m10 * vx + m11 * vy + m12 * vz;
+        pz[i] = m20 * vx + m21 * vy + m22 * vz;
+    }
+}
+
+void PointArray::translateScale(const cgp::Vector & shift, float scale)
+{
+    int i = 0, n = size();
+    float * px = x.data(), * py = y.data(), * pz = z.data();
+
+#ifdef SIMD_WIDTH
+    const vfloat tx = vset(shift.i), ty = vset(shift.j), tz = vset(shift.k), s = vset(scale);
+    for(; i + SIMD_WIDTH <= n; i += SIMD_WIDTH)
+    {
+        vstore(px + i, vmul(vadd(vload(px + i), tx), s));
+        vstore(py + i, vmul(vadd(vload(py + i), ty), s));
+        vstore(pz + i, vmul(vadd(vload(pz + i), tz), s));
+    }
+#endif
+    for(; i < n; i++)
+    {
+        px[i] = (px[i] + shift.i) * scale;
+        py[i] = (py[i] + shift.j) * scale;
+        pz[i] = (pz[i] + shift.k) * scale;
+    }
+}
+
+void PointArray::normalize()
+{
+    int i = 0, n = size();
+    float * px = x.data(), * py = y.data(), * pz = z.data();
+
+#ifdef SIMD_WIDTH
+    const vfloat one = vset(1.0f);
+    for(; i + SIMD_WIDTH <= n; i += SIMD_WIDTH)
+    {
+        vfloat vx = vload(px + i), vy = vload(py + i), vz = vload(pz + i);
+        vfloat len = vsqrt(vadd(vadd(vmul(vx, vx), vmul(vy, vy)), vmul(vz, vz)));
+        // zero length lanes are scaled by zero rather than infinity
+        vfloat inv = vpositive(len, vdiv(one, len));
+        vstore(px + i, vmul(vx, inv));
+        vstore(py + i, vmul(vy, inv));
+        vstore(pz + i, vmul(vz, inv));
+    }
+#endif
+    for(; i < n; i++)
+    {
+        float len = sqrtf(px[i] * px[i] + py[i] * py[i] + pz[i] * pz[i]);
+        if(len > 0.0f)
+            len = 1.0f / len;
+        px[i] *= len; py[i] *= len; pz[i] *= len;
+    }
+}
+
+cgp::BoundBox PointArray::bounds() const
+{
+    int i = 0, n = size();
+    const float * px = x.data(), * py = y.data(), * pz = z.data();
+    cgp::BoundBox bbox;
+
+#ifdef SIMD_WIDTH
+    if(n >= SIMD_WIDTH)
+    {
+        vfloat lox = vload(px), loy = vload(py), loz = vload(pz);
+        vfloat hix = lox, hiy = loy, hiz = loz;
+        float lo[3][SIMD_WIDTH], hi[3][SIMD_WIDTH];
+
+        for(i = SIMD_WIDTH; i + SIMD_WIDTH <= n; i += SIMD_WIDTH)
+        {
+            vfloat vx = vload(px + i), vy = vload(py + i), vz = vload(pz + i);
+            lox = vmin(lox, vx); loy = vmin(loy, vy); loz = vmin(loz, vz);
+            hix = vmax(hix, vx); hiy = vmax(hiy, vy); hiz = vmax(hiz, vz);
+        }
+        vstore(lo[0], lox); vstore(lo[1], loy); vstore(lo[2], loz);
+        vstore(hi[0], hix); vstore(hi[1], hiy); vstore(hi[2], hiz);
+        for(int l = 0; l < SIMD_WIDTH; l++)
+        {
+            bbox.includePnt(cgp::Point(lo[0][l], lo[1][l], lo[2][l]));
+            bbox.includePnt(cgp::Point(hi[0][l], hi[1][l], hi[2][l]));
+        }
+    }
+#endif
+    for(; i < n; i++)
+        bbox.includePnt(cgp::Point(px[i], py[i], pz[i]));
+    return bbox;
+}
@@ -0,0 +1,127 @@
+#ifndef _POINTARRAY
+#define _POINTARRAY
+/**
+ * @file
+ *
+ * Structure-of-arrays storage for points and vectors, with SIMD kernels for bulk transforms.
+ */
+
+#include <vector>
+#include "vecpnt.h"
+#include <glm/glm.hpp>
+
+class PointArray;
+
+/**
+ * Adapter that makes one element of a @ref PointArray behave like a cgp::Point or cgp::Vector, so that code written
+ * for the array-of-structures types can read and write it directly
+ */
+class PointArrayRef
+{
+private:
+    PointArray * arr;   ///< array holding the element
+    int idx;            ///< index of the element
+
+public:
+
+    /// Constructor
+    PointArrayRef(PointArray * array, int index) : arr(array), idx(index) {}
+
+    /// Read the element as a point
+    inline operator cgp::Point() const;
+
+    /// Read the element as a vector
+    inline operator cgp::Vector() const;
+
+    /// Overwrite the element with a point
+    inline PointArrayRef & operator=(const cgp::Point & pnt);
+
+    /// Overwrite the element with a vector
+    inline PointArrayRef & operator=(const cgp::Vector & vec);
+};
+
+/**
+ * Three coordinates per element held in separate contiguous arrays, so that bulk operations load 4 or 8 elements of
+ * one coordinate per instruction. Kernels use AVX when the compiler targets it, otherwise SSE2, with a scalar loop
+ * for the remainder and for other targets. Every path applies the same operations in the same order to each element.
+ */
+class PointArray
+{
+public:
+    std::vector<float> x;   ///< first coordinate of each element
+    std::vector<float> y;   ///< second coordinate of each element
+    std::vector<float> z;   ///< third coordinate of each element
+
+    /// Number of elements
+    int size() const { return (int) x.size(); }
+
+    /// Resize all three coordinate arrays
+    void resize(int n){ x.resize(n); y.resize(n); z.resize(n); }
+
+    /// Remove all elements
+    void clear(){ x.clear(); y.clear(); z.clear(); }
+
+    /// Element @a i viewed as a point or vector
+    PointArrayRef operator[](int i){ return PointArrayRef(this, i); }
+
+    /// Element @a i as a point
+    cgp::Point point(int i) const { return cgp::Point(x[i], y[i], z[i]); }
+
+    /// Element @a i as a vector
+    cgp::Vector vector(int i) const { return cgp::Vector(x[i], y[i], z[i]); }
+
+    /// Replace the contents with a copy of a list of points
+    void load(const std::vector<cgp::Point> & pnts);
+
+    /// Replace the contents with a copy of a list of vectors
+    void load(const std::vector<cgp::Vector> & vecs);
+
+    /// Copy the contents out to a list of points, resizing it to match
+    void store(std::vector<cgp::Point> & pnts) const;
+
+    /// Copy the contents out to a list of vectors, resizing it to match
+    void store(std::vector<cgp::Vector> & vecs) const;
+
+    /**
+     * Apply an affine transformation to every element as a point
+     * @param tfm   transformation matrix, whose bottom row is taken to be (0, 0, 0, 1)
+     */
+    void transform(const glm::mat4x4 & tfm);
+
+    /**
+     * Apply a linear transformation to every element as a vector, such as the inverse transpose for normals
+     * @param tfm   transformation matrix
+     */
+    void transformVectors(const glm::mat3x3 & tfm);
+
+    /**
+     * Translate and then uniformly scale every element
+     * @param shift     translation added first
+     * @param scale     factor applied to the translated coordinates
+     */
+    void translateScale(const cgp::Vector & shift, float scale);
+
+    /// Scale every element to unit length, as by cgp::Vector::normalize, leaving zero vectors unchanged
+    void normalize();
+
+    /// Bounding box of all elements, which is empty if there are none
+    cgp::BoundBox bounds() const;
+};
+
+inline PointArrayRef::operator cgp::Point() const { return arr->point(idx); }
+
+inline PointArrayRef::operator cgp::Vector() const { return arr->vector(idx); }
+
+inline PointArrayRef & PointArrayRef::operator=(const cgp::Point & pnt)
+{
+    arr->x[idx] = pnt.x; arr->y[idx] = pnt.y; arr->z[idx] = pnt.z;
+    return * this;
+}
+
+inline PointArrayRef & PointArrayRef::operator=(const cgp::Vector & vec)
+{
+    arr->x[idx] = vec.i; arr->y[idx] = vec.j; arr->z[idx] = vec.k;
+    return * this;
+}
+
+#endif
@@ -1,5 +1,6 @@
 #include <GL/glew.h>
 #include "shape.h"
+#include "pointarray.h"
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
@@ -126,23 +127,25 @@ void ShapeGeometry::genSphere(float radius, int slices, int stacks, glm::mat4x4
 
 void ShapeGeometry::genMesh(std::vector<cgp::Point> * points, std::vector<cgp::Vector> * norms, std::vector<int> * faces, glm::mat4x4 trm)
 {
-    int i, base;
-    glm::vec4 p;
-    glm::vec3 v;
+    int i, base, n = (int) points->size();
+    PointArray p, v;
+
+    // transform positions and normals in bulk, with normals taken through the inverse transpose
+    p.load(* points);
+    p.transform(trm);
+    v.load(* norms);
+    v.resize(n);
+    v.transformVectors(glm::transpose(glm::inverse(glm::mat3(trm))));
+    v.normalize();
 
     base = int(verts.size()) / 8;
-    for(i = 0; i < (int) points->size(); i++)
+    verts.resize(verts.size() + 8 * n);
+    float * dst = verts.data() + 8 * base;
+    for(i = 0; i < n; i++, dst += 8)
     {
-        // apply transformation
-        p = trm * glm::vec4((* points)[i].x, (* points)[i].y, (* points)[i].z, 1.0f);
-        // v = glm::mat3(trm) * glm::normalize(glm::vec3(x, y, z));
-        v = glm::transpose(glm::inverse(glm::mat3(trm))) * glm::normalize(glm::vec3((* norms)[i].i, (* norms)[i].j, (* norms)[i].k));
-        v = glm::normalize(v);
-
-
-        verts.push_back(p.x); verts.push_back(p.y); verts.push_back(p.z); // position
-        verts.push_back(0.0f); verts.push_back(0.0f); // texture coordinates
-        verts.push_back(v.x); verts.push_back(v.y); verts.push_back(v.z); // normal
+        dst[0] = p.x[i]; dst[1] = p.y[i]; dst[2] = p.z[i]; // position
+        dst[3] = 0.0f; dst[4] = 0.0f; // texture coordinates
+        dst[5] = v.x[i]; dst[6] = v.y[i]; dst[7] = v.z[i]; // normal
     }
 
     for(i = 0; i < (int) faces->size(); i++)
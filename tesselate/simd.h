@@ -0,0 +1,57 @@
+#ifndef _SIMD
+#define _SIMD
+/**
+ * @file
+ *
+ * Minimal wrappers so that each SIMD kernel is written once for whichever vector width the compiler targets. AVX is
+ * used when enabled, otherwise SSE2, and SIMD_WIDTH is left undefined on other targets so kernels fall back to
+ * their scalar loops.
+ */
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX__)
+#define SIMD_WIDTH 8
+typedef __m256 vfloat;
+static inline vfloat vload(const float * p){ return _mm256_loadu_ps(p); }
+static inline void vstore(float * p, vfloat a){ _mm256_storeu_ps(p, a); }
+static inline vfloat vset(float a){ return _mm256_set1_ps(a); }
+static inline vfloat vadd(vfloat a, vfloat b){ return _mm256_add_ps(a, b); }
+static inline vfloat vsub(vfloat a, vfloat b){ return _mm256_sub_ps(a, b); }
+static inline vfloat vmul(vfloat a, vfloat b){ return _mm256_mul_ps(a, b); }
+static inline vfloat vdiv(vfloat a, vfloat b){ return _mm256_div_ps(a, b); }
+static inline vfloat vsqrt(vfloat a){ return _mm256_sqrt_ps(a); }
+static inline vfloat vmin(vfloat a, vfloat b){ return _mm256_min_ps(a, b); }
+static inline vfloat vmax(vfloat a, vfloat b){ return _mm256_max_ps(a, b); }
+static inline vfloat vpositive(vfloat a, vfloat b){ return _mm256_and_ps(_mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_GT_OQ), b); }
+static inline vfloat vgt(vfloat a, vfloat b){ return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+static inline vfloat vge(vfloat a, vfloat b){ return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+static inline vfloat vand(vfloat a, vfloat b){ return _mm256_and_ps(a, b); }
+static inline vfloat vor(vfloat a, vfloat b){ return _mm256_or_ps(a, b); }
+static inline int vmask(vfloat a){ return _mm256_movemask_ps(a); }
+#elif defined(__SSE2__)
+#define SIMD_WIDTH 4
+typedef __m128 vfloat;
+static inline vfloat vload(const float * p){ return _mm_loadu_ps(p); }
+static inline void vstore(float * p, vfloat a){ _mm_storeu_ps(p, a); }
+static inline vfloat vset(float a){ return _mm_set1_ps(a); }
+static inline vfloat vadd(vfloat a, vfloat b){ return _mm_add_ps(a, b); }
+static inline vfloat vsub(vfloat a, vfloat b){ return _mm_sub_ps(a, b); }
+static inline vfloat vmul(vfloat a, vfloat b){ return _mm_mul_ps(a, b); }
+static inline vfloat vdiv(vfloat a, vfloat b){ return _mm_div_ps(a, b); }
+static inline vfloat vsqrt(vfloat a){ return _mm_sqrt_ps(a); }
+static inline vfloat vmin(vfloat a, vfloat b){ return _mm_min_ps(a, b); }
+static inline vfloat vmax(vfloat a, vfloat b){ return _mm_max_ps(a, b); }
+static inline vfloat vpositive(vfloat a, vfloat b){ return _mm_and_ps(_mm_cmpgt_ps(a, _mm_setzero_ps()), b); }
+static inline vfloat vgt(vfloat a, vfloat b){ return _mm_cmpgt_ps(a, b); }
+static inline vfloat vge(vfloat a, vfloat b){ return _mm_cmpge_ps(a, b); }
+static inline vfloat vand(vfloat a, vfloat b){ return _mm_and_ps(a, b); }
+static inline vfloat vor(vfloat a, vfloat b){ return _mm_or_ps(a, b); }
+static inline int vmask(vfloat a){ return _mm_movemask_ps(a); }
+#endif
+
+#endif
@@ -0,0 +1,463 @@
+//
+// QuadricSimplifier
+//
+
+#include "simplify.h"
+#include "mesh.h"
+#include <math.h>
+#include <algorithm>
+#include <functional>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace std;
+
+// weight of the planes through boundary edges relative to those of triangles
+static const double boundaryweight = 100.0;
+
+// smallest cosine allowed between the normals of a triangle before and after a collapse
+static const double minflipcos = 0.2;
+
+void Quadric::addPlane(double a, double b, double c, double d, double w)
+{
+    q[0] += w * a * a; q[1] += w * a * b; q[2] += w * a * c; q[3] += w * a * d;
+    q[4] += w * b * b; q[5] += w * b * c; q[6] += w * b * d;
+    q[7] += w * c * c; q[8] += w * c * d;
+    q[9] += w * d * d;
+}
+
+double Quadric::error(const cgp::Point & p) const
+{
+    double x = p.x, y = p.y, z = p.z;
+
+    return q[0] * x * x + 2.0 * q[1] * x * y + 2.0 * q[2] * x * z + 2.0 * q[3] * x
+         + q[4] * y * y + 2.0 * q[5] * y * z + 2.0 * q[6] * y
+         + q[7] * z * z + 2.0 * q[8] * z
+         + q[9];
+}
+
+bool Quadric::optimum(cgp::Point & p) const
+{
+    // solve the 3x3 system by cofactors, refusing nearly singular matrices such as those of flat or ridge vertices
+    double c00 = q[4] * q[7] - q[5] * q[5], c01 = q[2] * q[5] - q[1] * q[7], c02 = q[1] * q[5] - q[2] * q[4];
+    double det = q[0] * c00 + q[1] * c01 + q[2] * c02, trace = q[0] + q[4] + q[7];
+
+    if(trace <= 0.0 || fabs(det) <= 1e-6 * trace * trace * trace)
+        return false;
+    double c11 = q[0] * q[7] - q[2] * q[2], c12 = q[1] * q[2] - q[0] * q[5], c22 = q[0] * q[4] - q[1] * q[1];
+    double inv = 1.0 / det;
+    p.x = (float) (-(c00 * q[3] + c01 * q[6] + c02 * q[8]) * inv);
+    p.y = (float) (-(c01 * q[3] + c11 * q[6] + c12 * q[8]) * inv);
+    p.z = (float) (-(c02 * q[3] + c12 * q[6] + c22 * q[8]) * inv);
+    return true;
+}
+
+/// Whether triangle @a tv contains the directed edge a->b
+static inline bool hasDirected(const int * tv, int a, int b)
+{
+    return (tv[0] == a && tv[1] == b) || (tv[1] == a && tv[2] == b) || (tv[2] == a && tv[0] == b);
+}
+
+/// Whether triangle @a tv uses vertex @a v
+static inline bool hasVert(const int * tv, int v)
+{
+    return tv[0] == v || tv[1] == v || tv[2] == v;
+}
+
+/// Unnormalised normal of triangle (a, b, c)
+static inline void crossNormal(const cgp::Point & a, const cgp::Point & b, const cgp::Point & c, double n[3])
+{
+    double e0[3] = {(double) b.x - a.x, (double) b.y - a.y, (double) b.z - a.z};
+    double e1[3] = {(double) c.x - a.x, (double) c.y - a.y, (double) c.z - a.z};
+
+    n[0] = e0[1] * e1[2] - e0[2] * e1[1];
+    n[1] = e0[2] * e1[0] - e0[0] * e1[2];
+    n[2] = e0[0] * e1[1] - e0[1] * e1[0];
+}
+
+QuadricSimplifier::QuadricSimplifier(std::vector<cgp::Point> & vertices, std::vector<Triangle> & triangles, const MeshAdjacency & adj)
+    : verts(vertices), tris(triangles)
+{
+    int nv = (int) verts.size(), v;
+
+    quadrics.assign(nv, Quadric());
+    vtris.resize(nv);
+    stamp.assign(nv, 0);
+    tdead.assign(tris.size(), 0);
+    vdead.assign(nv, 0);
+    border.assign(nv, 0);
+    locked.assign(nv, 0);
+    numlive = (int) tris.size();
+
+    #pragma omp parallel for if(nv > 65536)
+    for(v = 0; v < nv; v++)
+        vtris[v].assign(adj.vtris.begin() + adj.vtstart[v], adj.vtris.begin() + adj.vtstart[v+1]);
+
+    // each vertex sums the planes of its own triangles and of the boundary edges it lies on, so no two threads
+    // write the same quadric
+    #pragma omp parallel for if(nv > 65536) schedule(dynamic, 1024)
+    for(v = 0; v < nv; v++)
+    {
+        for(int t : vtris[v])
+        {
+            const int * tv = tris[t].v;
+            double n[3], len;
+            int k;
+
+            crossNormal(verts[tv[0]], verts[tv[1]], verts[tv[2]], n);
+            len = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if(len == 0.0)
+                continue;
+            n[0] /= len; n[1] /= len; n[2] /= len;
+            const cgp::Point & p = verts[v];
+            quadrics[v].addPlane(n[0], n[1], n[2], -(n[0] * p.x + n[1] * p.y + n[2] * p.z), 1.0);
+
+            for(k = 0; k < 2 && tv[k] != v; k++);
+            int next = tv[(k+1)%3], prev = tv[(k+2)%3];
+            // an edge is open if no triangle runs along it in the opposite direction
+            for(int e = 0; e < 2; e++)
+            {
+                int a = e ? prev : v, b = e ? v : next;
+                bool twin = false;
+                for(int s : vtris[b])
+                    if(hasDirected(tris[s].v, b, a))
+                    {
+                        twin = true;
+                        break;
+                    }
+                if(twin)
+                    continue;
+
+                // plane through the edge perpendicular to the triangle
+                const cgp::Point & pa = verts[a], & pb = verts[b];
+                double ed[3] = {(double) pb.x - pa.x, (double) pb.y - pa.y, (double) pb.z - pa.z}, m[3], mlen;
+                m[0] = ed[1] * n[2] - ed[2] * n[1];
+                m[1] = ed[2] * n[0] - ed[0] * n[2];
+                m[2] = ed[0] * n[1] - ed[1] * n[0];
+                mlen = sqrt(m[0] * m[0] + m[1] * m[1] + m[2] * m[2]);
+                border[v] = 1;
+                if(mlen == 0.0)
+                    continue;
+                m[0] /= mlen; m[1] /= mlen; m[2] /= mlen;
+                quadrics[v].addPlane(m[0], m[1], m[2], -(m[0] * pa.x + m[1] * pa.y + m[2] * pa.z), boundaryweight);
+            }
+        }
+    }
+}
+
+void QuadricSimplifier::evaluate(int u, int v, Candidate & cand)
+{
+    Quadric q = quadrics[u];
+    cgp::Point p;
+    const cgp::Point & pu = verts[u], & pv = verts[v];
+
+    q.add(quadrics[v]);
+    cand.u = u; cand.v = v;
+    cand.su = stamp[u]; cand.sv = stamp[v];
+
+    bool solved = q.optimum(p);
+    if(solved)
+    {
+        // a minimiser far from the edge comes from a badly conditioned system
+        float mx = 0.5f * (pu.x + pv.x), my = 0.5f * (pu.y + pv.y), mz = 0.5f * (pu.z + pv.z);
+        float ex = pu.x - pv.x, ey = pu.y - pv.y, ez = pu.z - pv.z;
+        float dx = p.x - mx, dy = p.y - my, dz = p.z - mz;
+        if(dx * dx + dy * dy + dz * dz > 4.0f * (ex * ex + ey * ey + ez * ez))
+            solved = false;
+    }
+    if(!solved)
+    {
+        cgp::Point mid(0.5f * (pu.x + pv.x), 0.5f * (pu.y + pv.y), 0.5f * (pu.z + pv.z));
+        double eu = q.error(pu), ev = q.error(pv), em = q.error(mid);
+        p = (eu <= ev && eu <= em) ? pu : ((ev <= em) ? pv : mid);
+    }
+    cand.pos = p;
+    cand.cost = (float) max(0.0, q.error(p));
+}
+
+void QuadricSimplifier::gatherRing(int v, std::vector<int> & ring)
+{
+    ring.clear();
+    for(int t : vtris[v])
+    {
+        if(tdead[t])
+            continue;
+        for(int k = 0; k < 3; k++)
+            if(tris[t].v[k] != v)
+                ring.push_back(tris[t].v[k]);
+    }
+    std::sort(ring.begin(), ring.end());
+    ring.erase(std::unique(ring.begin(), ring.end()), ring.end());
+}
+
+bool QuadricSimplifier::collapse(const Candidate & cand, std::vector<int> & ring, int & removed)
+{
+    int u = cand.u, v = cand.v, nshared = 0, common = 0;
+    size_t a, b;
+
+    removed = 0;
+    if(vdead[u] || vdead[v] || stamp[u] != cand.su || stamp[v] != cand.sv)
+        return false;
+
+    for(int t : vtris[v])
+        if(!tdead[t] && hasVert(tris[t].v, u))
+            nshared++;
+    if(nshared == 0 || nshared > 2)
+        return false;
+    // joining two boundaries through the interior would pinch the surface
+    if(nshared == 2 && border[u] && border[v])
+        return false;
+
+    // link condition: the only vertices adjacent to both ends are those opposite the edge
+    gatherRing(u, ring);
+    size_t nu = ring.size();
+    for(int t : vtris[v])
+    {
+        if(tdead[t])
+            continue;
+        for(int k = 0; k < 3; k++)
+            if(tris[t].v[k] != v)
+                ring.push_back(tris[t].v[k]);
+    }
+    std::sort(ring.begin() + nu, ring.end());
+    ring.erase(std::unique(ring.begin() + nu, ring.end()), ring.end());
+    for(a = 0, b = nu; a < nu && b < ring.size(); )
+    {
+        if(ring[a] < ring[b])
+            a++;
+        else if(ring[a] > ring[b])
+            b++;
+        else
+        {
+            if(ring[a] != u && ring[a] != v)
+                common++;
+            a++; b++;
+        }
+    }
+    if(common != nshared)
+        return false;
+
+    // refuse to fold over any triangle that survives
+    for(int e = 0; e < 2; e++)
+        for(int t : vtris[e ? v : u])
+        {
+            const int * tv = tris[t].v;
+            if(tdead[t] || (hasVert(tv, u) && hasVert(tv, v)))
+                continue;
+            cgp::Point p[3];
+            double n0[3], n1[3];
+            for(int k = 0; k < 3; k++)
+                p[k] = verts[tv[k]];
+            crossNormal(p[0], p[1], p[2], n0);
+            for(int k = 0; k < 3; k++)
+                if(tv[k] == u || tv[k] == v)
+                    p[k] = cand.pos;
+            crossNormal(p[0], p[1], p[2], n1);
+            double d = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2];
+            double l0 = n0[0] * n0[0] + n0[1] * n0[1] + n0[2] * n0[2], l1 = n1[0] * n1[0] + n1[1] * n1[1] + n1[2] * n1[2];
+            if(l1 == 0.0 || d <= minflipcos * sqrt(l0 * l1))
+                return false;
+        }
+
+    verts[u] = cand.pos;
+    quadrics[u].add(quadrics[v]);
+    border[u] = border[u] || border[v];
+    for(int t : vtris[v])
+    {
+        if(tdead[t])
+            continue;
+        int * tv = tris[t].v;
+        if(hasVert(tv, u))
+        {
+            tdead[t] = 1;
+            removed++;
+        }
+        else
+        {
+            for(int k = 0; k < 3; k++)
+                if(tv[k] == v)
+                    tv[k] = u;
+            vtris[u].push_back(t);
+        }
+    }
+    vtris[u].erase(std::remove_if(vtris[u].begin(), vtris[u].end(), [this](int t){ return tdead[t] != 0; }), vtris[u].end());
+    std::vector<int>().swap(vtris[v]);
+    vdead[v] = 1;
+    stamp[u]++;
+    return true;
+}
+
+void QuadricSimplifier::run(std::vector<Candidate> & heap, int & live, int target, float maxError)
+{
+    std::vector<int> ring, nbrs;
+    Candidate cand, next;
+    int removed;
+
+    while(live > target && !heap.empty())
+    {
+        std::pop_heap(heap.begin(), heap.end(), std::greater<Candidate>());
+        cand = heap.back();
+        heap.pop_back();
+        if(cand.cost > maxError)
+            break;
+        if(!collapse(cand, ring, removed))
+            continue;
+        live -= removed;
+
+        // every edge at the merged vertex has a new cost
+        gatherRing(cand.u, nbrs);
+        for(int w : nbrs)
+            if(!locked[w])
+            {
+                evaluate(cand.u, w, next);
+                heap.push_back(next);
+                std::push_heap(heap.begin(), heap.end(), std::greater<Candidate>());
+            }
+    }
+}
+
+void QuadricSimplifier::buildHeap(std::vector<Candidate> & heap)
+{
+    int nv = (int) verts.size(), nthreads = 1;
+
+#ifdef _OPENMP
+    nthreads = omp_get_max_threads();
+#endif
+    // contiguous per-thread ranges concatenated in order give the same heap on any number of threads
+    std::vector<std::vector<Candidate>> parts(nthreads);
+    #pragma omp parallel num_threads(nthreads) if(nv > 65536)
+    {
+        int th = 0, v;
+        std::vector<int> ring;
+        Candidate cand;
+#ifdef _OPENMP
+        th = omp_get_thread_num();
+#endif
+        #pragma omp for schedule(static)
+        for(v = 0; v < nv; v++)
+        {
+            if(vdead[v] || locked[v])
+                continue;
+            gatherRing(v, ring);
+            for(int w : ring)
+                if(w > v && !locked[w])
+                {
+                    evaluate(v, w, cand);
+                    parts[th].push_back(cand);
+                }
+        }
+    }
+    heap.clear();
+    for(auto & part : parts)
+        heap.insert(heap.end(), part.begin(), part.end());
+    std::make_heap(heap.begin(), heap.end(), std::greater<Candidate>());
+}
+
+void QuadricSimplifier::compact()
+{
+    int nv = (int) verts.size(), nt = (int) tris.size(), t, v, k, nkept = 0;
+    std::vector<int> remap(nv, -1);
+
+    for(t = 0; t < nt; t++)
+        if(!tdead[t])
+            for(k = 0; k < 3; k++)
+                remap[tris[t].v[k]] = 0;
+    for(v = 0; v < nv; v++)
+        if(remap[v] == 0)
+        {
+            remap[v] = nkept;
+            verts[nkept++] = verts[v];
+        }
+    verts.resize(nkept);
+
+    nkept = 0;
+    for(t = 0; t < nt; t++)
+        if(!tdead[t])
+        {
+            tris[nkept] = tris[t];
+            for(k = 0; k < 3; k++)
+                tris[nkept].v[k] = remap[tris[t].v[k]];
+            nkept++;
+        }
+    tris.resize(nkept);
+}
+
+int QuadricSimplifier::simplify(int targetTris, float maxError)
+{
+    std::vector<Candidate> heap;
+
+    std::fill(locked.begin(), locked.end(), 0);
+    buildHeap(heap);
+    run(heap, numlive, targetTris, maxError);
+    compact();
+    return numlive;
+}
+
+int QuadricSimplifier::simplifyParallel(int targetTris, float maxError)
+{
+    int nv = (int) verts.size(), nt = (int) tris.size(), nparts = min(64, numlive / 65536), removed = 0;
+    int p, t, v, axis = 0;
+    const int nbins = 4096;
+
+    if(nparts < 2)
+        return simplify(targetTris, maxError);
+
+    // slabs of roughly equal vertex count along the longest axis, cut at the quantiles of a coordinate histogram
+    cgp::BoundBox bbox;
+    for(v = 0; v < nv; v++)
+        bbox.includePnt(verts[v]);
+    cgp::Vector diag = bbox.getDiag();
+    if(diag.j > diag.i && diag.j >= diag.k)
+        axis = 1;
+    else if(diag.k > diag.i && diag.k > diag.j)
+        axis = 2;
+    float lo = axis == 0 ? bbox.min.x : (axis == 1 ? bbox.min.y : bbox.min.z);
+    float extent = axis == 0 ? diag.i : (axis == 1 ? diag.j : diag.k);
+    std::vector<int> bin(nv), hist(nbins, 0), binpart(nbins), part(nv), ptris(nparts, 0);
+    for(v = 0; v < nv; v++)
+    {
+        float c = axis == 0 ? verts[v].x : (axis == 1 ? verts[v].y : verts[v].z);
+        bin[v] = extent > 0.0f ? min(nbins - 1, (int) ((c - lo) / extent * nbins)) : 0;
+        hist[bin[v]]++;
+    }
+    long acc = 0;
+    for(int b = 0; b < nbins; b++)
+    {
+        binpart[b] = (int) min((long) nparts - 1, acc * nparts / max(nv, 1));
+        acc += hist[b];
+    }
+    for(v = 0; v < nv; v++)
+        part[v] = binpart[bin[v]];
+
+    // triangles crossing between slabs pin their vertices
+    for(t = 0; t < nt; t++)
+    {
+        const int * tv = tris[t].v;
+        if(part[tv[0]] != part[tv[1]] || part[tv[0]] != part[tv[2]])
+            locked[tv[0]] = locked[tv[1]] = locked[tv[2]] = 1;
+        else
+            ptris[part[tv[0]]]++;
+    }
+
+    std::vector<Candidate> all;
+    std::vector<std::vector<Candidate>> heaps(nparts);
+    buildHeap(all);
+    for(const Candidate & cand : all)
+        heaps[part[cand.u]].push_back(cand);
+    std::vector<Candidate>().swap(all);
+
+    #pragma omp parallel for schedule(dynamic, 1) reduction(+:removed)
+    for(p = 0; p < nparts; p++)
+    {
+        int live = ptris[p], target = (int) ((double) ptris[p] * targetTris / numlive);
+        std::make_heap(heaps[p].begin(), heaps[p].end(), std::greater<Candidate>());
+        run(heaps[p], live, target, maxError);
+        removed += ptris[p] - live;
+        std::vector<Candidate>().swap(heaps[p]);
+    }
+    numlive -= removed;
+
+    // finish across the seams, with every vertex free again
+    return simplify(targetTris, maxError);
+}
@@ -0,0 +1,152 @@
+#ifndef _SIMPLIFY
+#define _SIMPLIFY
+/**
+ * @file
+ *
+ * Mesh decimation by edge collapse under quadric error metrics.
+ */
+
+#include <vector>
+#include "vecpnt.h"
+
+struct Triangle;
+struct MeshAdjacency;
+
+/**
+ * Symmetric 4x4 matrix whose quadratic form gives the sum of weighted squared distances of a point to a set of planes
+ */
+struct Quadric
+{
+    double q[10];   ///< upper triangle of the matrix, row by row
+
+    /// Constructor for the zero quadric
+    Quadric(){ for(int i = 0; i < 10; i++) q[i] = 0.0; }
+
+    /**
+     * Add the squared distance to the plane ax + by + cz + d = 0, which must have a unit normal
+     * @param a, b, c   plane normal
+     * @param d         plane offset
+     * @param w         weight of the plane
+     */
+    void addPlane(double a, double b, double c, double d, double w);
+
+    /// Add another quadric
+    void add(const Quadric & o){ for(int i = 0; i < 10; i++) q[i] += o.q[i]; }
+
+    /// Weighted sum of squared distances from @a p to the planes
+    double error(const cgp::Point & p) const;
+
+    /**
+     * Find the point of least error
+     * @param[out] p    minimising point, if there is a unique one
+     * @retval true  if the planes constrain all three directions,
+     * @retval false if the minimum is not unique
+     */
+    bool optimum(cgp::Point & p) const;
+};
+
+/**
+ * Simplifies a triangle mesh in place by collapsing edges in order of increasing quadric error, following Garland
+ * and Heckbert. Each vertex carries the quadric of the planes of its original triangles, plus heavily weighted planes
+ * through boundary edges so that open borders keep their shape. Candidate collapses are kept in a binary heap and
+ * invalidated lazily by a per-vertex stamp. A collapse is refused if it would make the surface non-manifold, join
+ * two boundaries across the interior, or flip a triangle.
+ *
+ * The parallel variant splits the vertices into slabs of equal size along the longest axis of the mesh. Vertices
+ * on triangles that cross between slabs are locked, so every collapse inside a slab touches only its own triangles
+ * and slabs can be simplified concurrently without locking. A final serial pass then works across the seams. The
+ * number of slabs depends only on the size of the mesh, so the result does not depend on the number of threads.
+ */
+class QuadricSimplifier
+{
+private:
+    /// Candidate collapse of edge (u, v) into a single vertex, valid while both vertex stamps are unchanged
+    struct Candidate
+    {
+        float cost;         ///< quadric error at the new position
+        int u, v;           ///< vertex kept and vertex removed
+        int su, sv;         ///< stamps of u and v when the candidate was evaluated
+        cgp::Point pos;     ///< position of the merged vertex
+
+        /// Ordering for a min-heap on cost
+        bool operator>(const Candidate & o) const { return cost > o.cost; }
+    };
+
+    std::vector<cgp::Point> & verts;        ///< vertices, moved in place
+    std::vector<Triangle> & tris;           ///< triangles, rewritten in place
+    std::vector<Quadric> quadrics;          ///< accumulated quadric of each vertex
+    std::vector<std::vector<int>> vtris;    ///< triangles incident on each vertex, including dead ones until tidied
+    std::vector<int> stamp;                 ///< incremented whenever a vertex moves
+    std::vector<char> tdead;                ///< triangles removed by a collapse
+    std::vector<char> vdead;                ///< vertices removed by a collapse
+    std::vector<char> border;               ///< vertices on an open boundary
+    std::vector<char> locked;               ///< vertices that may not take part in a collapse
+    int numlive;                            ///< triangles not yet removed
+
+    /**
+     * Evaluate the collapse of edge (u, v)
+     * @param u, v          endpoints of the edge
+     * @param[out] cand     candidate with its optimal position and cost
+     */
+    void evaluate(int u, int v, Candidate & cand);
+
+    /**
+     * Distinct vertices sharing a live triangle with @a v, in increasing order
+     * @param v         center vertex
+     * @param[out] ring neighbours of v
+     */
+    void gatherRing(int v, std::vector<int> & ring);
+
+    /**
+     * Collapse an edge if it is still current and passes the topology and flip tests
+     * @param cand          candidate collapse
+     * @param ring          scratch space for neighbour lists
+     * @param[out] removed  number of triangles removed
+     * @retval true  if the edge was collapsed,
+     * @retval false if it was refused
+     */
+    bool collapse(const Candidate & cand, std::vector<int> & ring, int & removed);
+
+    /**
+     * Collapse edges from a heap until a triangle count or error bound is reached
+     * @param heap      min-heap of candidates, consumed in place
+     * @param live      number of live triangles this heap can affect, updated as collapses happen
+     * @param target    stop once @a live falls to this count
+     * @param maxError  stop once the cheapest candidate exceeds this error
+     */
+    void run(std::vector<Candidate> & heap, int & live, int target, float maxError);
+
+    /// Candidates for every edge between unlocked vertices of live triangles, as a heap
+    void buildHeap(std::vector<Candidate> & heap);
+
+    /// Drop dead triangles and unused vertices, keeping the order of what remains
+    void compact();
+
+public:
+
+    /**
+     * Constructor, which computes the vertex quadrics
+     * @param vertices  mesh vertices, simplified in place
+     * @param triangles mesh triangles, simplified in place
+     * @param adj       vertex adjacency of the mesh as given
+     */
+    QuadricSimplifier(std::vector<cgp::Point> & vertices, std::vector<Triangle> & triangles, const MeshAdjacency & adj);
+
+    /**
+     * Collapse edges in order of increasing error
+     * @param targetTris    stop once no more than this many triangles remain
+     * @param maxError      stop once every remaining collapse has a larger error, as a sum of squared distances
+     * @returns number of triangles remaining
+     */
+    int simplify(int targetTris, float maxError);
+
+    /**
+     * Collapse edges in parallel within slabs of the mesh, then finish serially across the slab boundaries
+     * @param targetTris    stop once no more than this many triangles remain
+     * @param maxError      stop once every remaining collapse has a larger error, as a sum of squared distances
+     * @returns number of triangles remaining
+     */
+    int simplifyParallel(int targetTris, float maxError);
+};
+
+#endif
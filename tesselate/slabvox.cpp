@@ -0,0 +1,311 @@
+//
+// Slab voxeliser
+//
+
+#include "slabvox.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+
+using namespace std;
+
+/**
+ * Inside test with tie breaking for a point lying exactly on an edge, so that two triangles sharing the edge
+ * in opposite directions count the point exactly once
+ */
+static inline bool edgeInside(double w, double ey, double ez)
+{
+    return w > 0.0 || (w == 0.0 && (ez > 0.0 || (ez == 0.0 && ey < 0.0)));
+}
+
+/// Index of the first voxel centre along x at or beyond a position, computed exactly as the centres themselves are
+static inline int firstCentre(double a, double ox, double sx, int dx)
+{
+    int x = (int) std::max(0.0, std::min((double) dx, ceil((a - ox) / sx)));
+    while(x > 0 && ox + (x-1) * sx >= a)
+        x--;
+    while(x < dx && ox + x * sx < a)
+        x++;
+    return x;
+}
+
+void scanConvertTriangles(const std::vector<float> & tris, VoxelVolume * vox, int z0, int z1)
+{
+    int dx, dy, dz;
+    long t, numt = (long) tris.size() / 9;
+    cgp::Point o;
+    cgp::Vector d;
+    double sx, sy, sz;
+
+    vox->getDim(dx, dy, dz);
+    vox->getFrame(o, d);
+    sx = d.i / (double) (dx-1);
+    sy = d.j / (double) (dy-1);
+    sz = d.k / (double) (dz-1);
+    z0 = std::max(z0, 0);
+    z1 = std::min(z1, dz);
+    if(z0 >= z1)
+        return;
+
+    // bin triangles by the rows of voxel centres that their yz projection spans
+    vector<vector<long>> rows(dy);
+    vector<int> tz0(numt), tz1(numt);
+    for(t = 0; t < numt; t++)
+    {
+        const float * v = &tris[t*9];
+        double ymin = std::min(v[1], std::min(v[4], v[7])), ymax = std::max(v[1], std::max(v[4], v[7]));
+        double zmin = std::min(v[2], std::min(v[5], v[8])), zmax = std::max(v[2], std::max(v[5], v[8]));
+        int y0 = std::max(0, (int) ceil((ymin - o.y) / sy)), y1 = std::min(dy-1, (int) floor((ymax - o.y) / sy));
+        tz0[t] = std::max(z0, (int) ceil((zmin - o.z) / sz));
+        tz1[t] = std::min(z1-1, (int) floor((zmax - o.z) / sz));
+        if(tz0[t] > tz1[t])
+            continue;
+        for(int y = y0; y <= y1; y++)
+            rows[y].push_back(t);
+    }
+
+    // each column owns whole words of the bit packed volume, so rows can be filled concurrently
+    #pragma omp parallel for schedule(dynamic, 4)
+    for(int y = 0; y < dy; y++)
+    {
+        vector<double> xs;
+        double py = o.y + y * sy;
+
+        for(int z = z0; z < z1; z++)
+        {
+            double pz = o.z + z * sz;
+            xs.clear();
+            for(long r : rows[y])
+            {
+                if(z < tz0[r] || z > tz1[r])
+                    continue;
+                const float * v = &tris[r*9];
+                double ay = v[1], az = v[2], by = v[4], bz = v[5], cy = v[7], cz = v[8];
+                double ax = v[0], bx = v[3], cx = v[6];
+                double area = (by - ay) * (cz - az) - (bz - az) * (cy - ay);
+                if(area == 0.0) // edge on to the ray, which grazes rather than crosses it
+                    continue;
+                if(area < 0.0) // orient counter-clockwise in yz
+                {
+                    std::swap(by, cy); std::swap(bz, cz); std::swap(bx, cx);
+                    area = -area;
+                }
+                double w0 = (cy - by) * (pz - bz) - (cz - bz) * (py - by);
+                double w1 = (ay - cy) * (pz - cz) - (az - cz) * (py - cy);
+                double w2 = (by - ay) * (pz - az) - (bz - az) * (py - ay);
+                if(edgeInside(w0, cy - by, cz - bz) && edgeInside(w1, ay - cy, az - cz) && edgeInside(w2, by - ay, bz - az))
+                    xs.push_back((w0 * ax + w1 * bx + w2 * cx) / area);
+            }
+            if(xs.empty())
+                continue;
+            std::sort(xs.begin(), xs.end());
+
+            // a voxel is inside when an odd number of crossings lie beyond its centre, which holds for the centres
+            // from each crossing up to the next, pairing them back from the last, so each span is set in one go
+            for(long k = (long) xs.size() - 1; k >= 0; k -= 2)
+            {
+                int x0 = k > 0 ? firstCentre(xs[k-1], o.x, sx, dx) : 0;
+                int x1 = firstCentre(xs[k], o.x, sx, dx);
+                vox->setSpan(x0, x1, y, z);
+            }
+        }
+    }
+}
+
+SlabVoxeliser::SlabVoxeliser(long batch, int depth)
+{
+    batchtris = std::max(1L, batch);
+    slabdepth = std::max(1, depth);
+}
+
+SlabVoxeliser::~SlabVoxeliser()
+{
+    removeTmpDir();
+}
+
+void SlabVoxeliser::removeTmpDir()
+{
+    if(!tmpdir.empty())
+        rmdir(tmpdir.c_str());
+    tmpdir.clear();
+}
+
+bool SlabVoxeliser::scanBounds(const std::string & filename, cgp::BoundBox & bbox, long & numt)
+{
+    ifstream infile;
+    char header[84];
+    unsigned int count;
+    long t, done, n;
+    vector<char> batch(batchtris * 50);
+
+    infile.open((char *) filename.c_str(), ios_base::in | ios_base::binary);
+    if(!infile.is_open())
+    {
+        cerr << "Error SlabVoxeliser::voxelise: unable to open " << filename << endl;
+        return false;
+    }
+    if(!infile.read(header, 84))
+    {
+        cerr << "Error SlabVoxeliser::voxelise: invalid STL binary file, too small" << endl;
+        return false;
+    }
+    memcpy(&count, &header[80], 4);
+    numt = (long) count;
+
+    bbox.reset();
+    for(done = 0; done < numt; done += n)
+    {
+        n = std::min(batchtris, numt - done);
+        if(!infile.read(batch.data(), n * 50))
+        {
+            cerr << "Error SlabVoxeliser::voxelise: malformed stl file, expected " << numt << " triangles" << endl;
+            return false;
+        }
+        for(t = 0; t < n; t++)
+        {
+            float rec[12];
+            memcpy(rec, &batch[t*50], 48);
+            for(int p = 0; p < 3; p++)
+                bbox.includePnt(cgp::Point(rec[3+p*3], rec[4+p*3], rec[5+p*3]));
+        }
+    }
+    return true;
+}
+
+bool SlabVoxeliser::binSlabs(const std::string & filename, VoxelVolume * vox, std::vector<FILE *> & slabfiles)
+{
+    ifstream infile;
+    int dx, dy, dz, nslabs = (int) slabfiles.size();
+    long t, done, n, numt;
+    unsigned int count;
+    char header[84];
+    cgp::Point o;
+    cgp::Vector d;
+    double sz;
+    vector<char> batch(batchtris * 50);
+    vector<vector<float>> pending(nslabs); // per slab write buffers
+    const std::size_t flushfloats = 9 * 4096;
+
+    vox->getDim(dx, dy, dz);
+    vox->getFrame(o, d);
+    sz = d.k / (double) (dz-1);
+
+    infile.open((char *) filename.c_str(), ios_base::in | ios_base::binary);
+    if(!infile.is_open() || !infile.read(header, 84))
+        return false;
+    memcpy(&count, &header[80], 4);
+    numt = (long) count;
+
+    for(done = 0; done < numt; done += n)
+    {
+        n = std::min(batchtris, numt - done);
+        if(!infile.read(batch.data(), n * 50))
+            return false;
+        for(t = 0; t < n; t++)
+        {
+            float rec[12];
+            memcpy(rec, &batch[t*50], 48);
+            double zmin = std::min(rec[5], std::min(rec[8], rec[11])), zmax = std::max(rec[5], std::max(rec[8], rec[11]));
+            int s0 = std::max(0, (int) ceil((zmin - o.z) / sz)) / slabdepth;
+            int s1 = std::min(dz-1, (int) floor((zmax - o.z) / sz)) / slabdepth;
+            for(int s = s0; s <= s1 && s < nslabs; s++)
+            {
+                pending[s].insert(pending[s].end(), &rec[3], &rec[12]);
+                if(pending[s].size() >= flushfloats)
+                {
+                    if(fwrite(pending[s].data(), sizeof(float), pending[s].size(), slabfiles[s]) != pending[s].size())
+                        return false;
+                    pending[s].clear();
+                }
+            }
+        }
+    }
+    for(int s = 0; s < nslabs; s++)
+        if(!pending[s].empty() && fwrite(pending[s].data(), sizeof(float), pending[s].size(), slabfiles[s]) != pending[s].size())
+            return false;
+    return true;
+}
+
+bool SlabVoxeliser::voxelise(const std::string & filename, float voxlen, VoxelVolume * vox)
+{
+    cgp::BoundBox bbox;
+    long numt;
+    int xdim, ydim, zdim, nslabs, s;
+    bool ok = true;
+    vector<FILE *> slabfiles;
+    vector<std::string> slabnames;
+    vector<float> slabtris;
+    const char * envtmp = getenv("TMPDIR");
+
+    if(!scanBounds(filename, bbox, numt))
+        return false;
+    if(numt == 0)
+    {
+        cerr << "Error SlabVoxeliser::voxelise: " << filename << " has no triangles" << endl;
+        return false;
+    }
+
+    // one empty voxel of border on every side, as with Scene::voxelise, so that the surface is closed
+    vox->setDim((int) ceil((bbox.max.x - bbox.min.x) / voxlen) + 3,
+                (int) ceil((bbox.max.y - bbox.min.y) / voxlen) + 3,
+                (int) ceil((bbox.max.z - bbox.min.z) / voxlen) + 3);
+    vox->getDim(xdim, ydim, zdim);
+    vox->setFrame(cgp::Point(bbox.min.x - voxlen, bbox.min.y - voxlen, bbox.min.z - voxlen),
+                  cgp::Vector((xdim-1) * voxlen, (ydim-1) * voxlen, (zdim-1) * voxlen));
+    cerr << "Voxel volume dimensions = " << xdim << " x " << ydim << " x " << zdim << endl;
+
+    // slab files live in a private temporary directory
+    removeTmpDir();
+    std::string tmpl = std::string(envtmp != NULL ? envtmp : "/tmp") + "/tesselate_slabsXXXXXX";
+    vector<char> tmpname(tmpl.begin(), tmpl.end());
+    tmpname.push_back('\0');
+    if(mkdtemp(tmpname.data()) == NULL)
+    {
+        cerr << "Error SlabVoxeliser::voxelise: unable to create temporary directory " << tmpl << endl;
+        return false;
+    }
+    tmpdir = tmpname.data();
+
+    nslabs = (zdim + slabdepth - 1) / slabdepth;
+    for(s = 0; s < nslabs && ok; s++)
+    {
+        slabnames.push_back(tmpdir + "/slab" + std::to_string(s));
+        slabfiles.push_back(fopen(slabnames.back().c_str(), "w+b"));
+        ok = (slabfiles.back() != NULL);
+    }
+    if(!ok)
+        cerr << "Error SlabVoxeliser::voxelise: unable to create slab files in " << tmpdir << endl;
+    else if(!(ok = binSlabs(filename, vox, slabfiles)))
+        cerr << "Error SlabVoxeliser::voxelise: failed binning triangles from " << filename << endl;
+
+    // scan convert one slab at a time, releasing each file as soon as it is done
+    for(s = 0; s < (int) slabfiles.size(); s++)
+    {
+        if(slabfiles[s] == NULL)
+            continue;
+        if(ok)
+        {
+            long bytes;
+            fseek(slabfiles[s], 0, SEEK_END);
+            bytes = ftell(slabfiles[s]);
+            rewind(slabfiles[s]);
+            slabtris.resize(bytes / sizeof(float));
+            if(fread(slabtris.data(), sizeof(float), slabtris.size(), slabfiles[s]) != slabtris.size())
+            {
+                cerr << "Error SlabVoxeliser::voxelise: unable to read back " << slabnames[s] << endl;
+                ok = false;
+            }
+            else
+                scanConvertTriangles(slabtris, vox, s * slabdepth, (s+1) * slabdepth);
+        }
+        fclose(slabfiles[s]);
+        remove(slabnames[s].c_str());
+    }
+    removeTmpDir();
+    return ok;
+}
@@ -0,0 +1,83 @@
+#ifndef _SLABVOX
+#define _SLABVOX
+/**
+ * @file
+ *
+ * Out-of-core voxelisation of binary STL files, streaming triangles through on-disk slabs of the voxel volume.
+ */
+
+#include <vector>
+#include <string>
+#include "voxels.h"
+
+/**
+ * Scan convert a set of triangles into a range of z layers of a voxel volume by ray parity along +x.
+ * For every voxel column (y, z) the crossings of a ray through the voxel centres are found and sorted, and a voxel is
+ * set when an odd number of crossings lie beyond it, matching the convention of Mesh::pointContainment. The runs of
+ * voxels between crossings are set a word at a time. Voxels are only ever set, never cleared.
+ * @param tris      packed triangles, 9 floats (3 vertices) each, in the world space of the volume
+ * @param vox       voxel volume receiving the occupied voxels
+ * @param z0, z1    range [z0, z1) of z layers to fill
+ */
+void scanConvertTriangles(const std::vector<float> & tris, VoxelVolume * vox, int z0, int z1);
+
+/**
+ * Voxelises binary STL files that are too large to hold in memory. Triangles are read in fixed-size batches,
+ * binned by the z layers they span into temporary slab files, and each slab is then scan converted on its own.
+ * Peak memory beyond the voxel volume is bounded by one batch, the slab write buffers and the largest slab.
+ */
+class SlabVoxeliser
+{
+private:
+    long batchtris;             ///< number of triangles read from the source per batch
+    int slabdepth;              ///< number of voxel z layers per slab
+    std::string tmpdir;         ///< directory holding the slab files, empty when none has been created
+
+    /**
+     * Stream the file once to find its bounding box
+     * @param filename      binary STL file
+     * @param[out] bbox     bounding box of all triangle vertices
+     * @param[out] numt     number of triangles in the file
+     * @retval true  if the file is a well-formed binary STL,
+     * @retval false otherwise.
+     */
+    bool scanBounds(const std::string & filename, cgp::BoundBox & bbox, long & numt);
+
+    /**
+     * Stream the file a second time, appending each triangle to the slab files of the z layers it spans
+     * @param filename      binary STL file
+     * @param vox           voxel volume whose frame defines the layers
+     * @param slabfiles     open slab files, one per slab
+     * @retval true  if all triangles were read and binned,
+     * @retval false otherwise.
+     */
+    bool binSlabs(const std::string & filename, VoxelVolume * vox, std::vector<FILE *> & slabfiles);
+
+    /// Remove the temporary slab directory if it exists
+    void removeTmpDir();
+
+public:
+
+    /**
+     * Constructor
+     * @param batch     triangles read from the source file per batch
+     * @param depth     voxel z layers per slab
+     */
+    SlabVoxeliser(long batch = 1 << 16, int depth = 32);
+
+    /// Destructor, which removes any leftover slab files
+    ~SlabVoxeliser();
+
+    /**
+     * Voxelise a binary STL file in its own coordinate frame. The volume is sized to the bounding box of the
+     * triangles with an empty border of one voxel on every side.
+     * @param filename      binary STL file
+     * @param voxlen        side length of a single voxel
+     * @param[out] vox      volume that is resized, framed and filled
+     * @retval true  if voxelisation succeeds,
+     * @retval false otherwise.
+     */
+    bool voxelise(const std::string & filename, float voxlen, VoxelVolume * vox);
+};
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef _UNIONFIND
+#define _UNIONFIND
+/**
+ * @file
+ *
+ * Lock-free disjoint set forest for labelling connected components in parallel.
+ */
+
+#include <vector>
+#include <atomic>
+
+/**
+ * Disjoint sets over the integers 0 to n-1 that can be united concurrently from many threads. Each set is rooted at
+ * its lowest member, since roots are only ever linked beneath a smaller root with a compare-and-swap, so the result
+ * is the same whatever order unions are applied in. Finds shorten paths by halving, which is a benign race because
+ * every parent a thread can install is an ancestor of the node.
+ */
+class ConcurrentUnionFind
+{
+private:
+    std::vector<std::atomic<int>> parent; ///< parent of each element, or the element itself at a root
+
+public:
+
+    /**
+     * Constructor
+     * @param n     number of elements, each starting in its own set
+     */
+    ConcurrentUnionFind(int n) : parent(n)
+    {
+        #pragma omp parallel for if(n > 65536)
+        for(int i = 0; i < n; i++)
+            parent[i].store(i, std::memory_order_relaxed);
+    }
+
+    /// Number of elements
+    int size() const { return (int) parent.size(); }
+
+    /**
+     * Find the root of the set containing @a x
+     * @param x     element to look up
+     * @returns lowest element in the same set, once all unions have completed
+     */
+    int find(int x)
+    {
+        int p = parent[x].load(std::memory_order_relaxed);
+        while(p != x)
+        {
+            int gp = parent[p].load(std::memory_order_relaxed);
+            if(gp != p)
+                parent[x].compare_exchange_weak(p, gp, std::memory_order_relaxed);
+            x = gp;
+            p = parent[x].load(std::memory_order_relaxed);
+        }
+        return x;
+    }
+
+    /**
+     * Merge the sets containing @a a and @a b. Safe to call concurrently with other unions and finds.
+     * @param a     element of the first set
+     * @param b     element of the second set
+     */
+    void unite(int a, int b)
+    {
+        for(;;)
+        {
+            a = find(a);
+            b = find(b);
+            if(a == b)
+                return;
+            if(a < b)
+                std::swap(a, b);
+            // link the larger root beneath the smaller, retrying if another thread moved it first
+            int expected = a;
+            if(parent[a].compare_exchange_strong(expected, b, std::memory_order_relaxed))
+                return;
+        }
+    }
+};
+
+#endif
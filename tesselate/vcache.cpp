@@ -0,0 +1,194 @@
+//
+// VertexCacheOptimizer
+//
+
+#include "vcache.h"
+#include "mesh.h"
+#include <math.h>
+#include <algorithm>
+
+using namespace std;
+
+// tuning constants from Forsyth's description of the algorithm
+static const float lasttriscore = 0.75f;    // score of the vertices of the triangle just emitted
+static const float cachedecaypower = 1.5f;  // how quickly the score of a cached vertex falls with age
+static const float valenceboostscale = 2.0f;
+static const float valenceboostpower = 0.5f;
+static const int maxvalencetable = 64;
+
+VertexCacheOptimizer::VertexCacheOptimizer(int size)
+{
+    int i;
+
+    cachesize = max(size, 4);
+    cachescore.resize(cachesize);
+    for(i = 0; i < cachesize; i++)
+        cachescore[i] = i < 3 ? lasttriscore : powf(1.0f - (float) (i - 3) / (float) (cachesize - 3), cachedecaypower);
+    valencescore.resize(maxvalencetable);
+    valencescore[0] = 0.0f;
+    for(i = 1; i < maxvalencetable; i++)
+        valencescore[i] = valenceboostscale * powf((float) i, -valenceboostpower);
+}
+
+float VertexCacheOptimizer::vertexScore(int cachepos, int remaining) const
+{
+    float score = 0.0f;
+
+    if(remaining == 0) // nothing left to gain from this vertex
+        return -1.0f;
+    if(cachepos >= 0)
+        score = cachescore[cachepos];
+    if(remaining < maxvalencetable)
+        score += valencescore[remaining];
+    else
+        score += valenceboostscale * powf((float) remaining, -valenceboostpower);
+    return score;
+}
+
+void VertexCacheOptimizer::optimize(std::vector<Triangle> & tris, int nverts)
+{
+    int nt = (int) tris.size(), t, v, i, k, best = 0, cursor = 0;
+    float bestscore;
+
+    if(nt == 0)
+        return;
+
+    // triangles of each vertex, with those not yet emitted kept at the front of its range
+    std::vector<int> start(nverts + 1, 0), vtris(3 * nt), live(nverts, 0);
+    for(t = 0; t < nt; t++)
+        for(k = 0; k < 3; k++)
+            start[tris[t].v[k] + 1]++;
+    for(v = 0; v < nverts; v++)
+        start[v+1] += start[v];
+    for(t = 0; t < nt; t++)
+        for(k = 0; k < 3; k++)
+        {
+            v = tris[t].v[k];
+            vtris[start[v] + live[v]++] = t;
+        }
+
+    std::vector<int> cachepos(nverts, -1), cache, newcache;
+    std::vector<float> vscore(nverts), tscore(nt);
+    std::vector<char> added(nt, 0);
+    std::vector<Triangle> out;
+
+    for(v = 0; v < nverts; v++)
+        vscore[v] = vertexScore(-1, live[v]);
+    bestscore = -1.0f;
+    for(t = 0; t < nt; t++)
+    {
+        tscore[t] = vscore[tris[t].v[0]] + vscore[tris[t].v[1]] + vscore[tris[t].v[2]];
+        if(tscore[t] > bestscore)
+        {
+            bestscore = tscore[t];
+            best = t;
+        }
+    }
+
+    out.reserve(nt);
+    cache.reserve(cachesize + 3);
+    newcache.reserve(cachesize + 3);
+    while((int) out.size() < nt)
+    {
+        if(best < 0) // nothing in the cache has triangles left, so start afresh
+        {
+            while(added[cursor])
+                cursor++;
+            best = cursor;
+        }
+        t = best;
+        added[t] = 1;
+        out.push_back(tris[t]);
+
+        // retire the triangle and move its vertices to the front of the cache
+        newcache.clear();
+        for(k = 0; k < 3; k++)
+        {
+            v = tris[t].v[k];
+            for(i = start[v]; i < start[v] + live[v]; i++)
+                if(vtris[i] == t)
+                {
+                    std::swap(vtris[i], vtris[start[v] + live[v] - 1]);
+                    live[v]--;
+                    break;
+                }
+            if(std::find(newcache.begin(), newcache.end(), v) == newcache.end())
+                newcache.push_back(v);
+        }
+        for(int c : cache)
+            if(c != tris[t].v[0] && c != tris[t].v[1] && c != tris[t].v[2])
+                newcache.push_back(c);
+
+        // rescore, including vertices just pushed out, and pick the best triangle touching the cache
+        for(i = 0; i < (int) newcache.size(); i++)
+        {
+            v = newcache[i];
+            cachepos[v] = i < cachesize ? i : -1;
+            vscore[v] = vertexScore(cachepos[v], live[v]);
+        }
+        best = -1;
+        bestscore = -1.0f;
+        for(int c : newcache)
+            for(i = start[c]; i < start[c] + live[c]; i++)
+            {
+                int s = vtris[i];
+                tscore[s] = vscore[tris[s].v[0]] + vscore[tris[s].v[1]] + vscore[tris[s].v[2]];
+                if(tscore[s] > bestscore)
+                {
+                    bestscore = tscore[s];
+                    best = s;
+                }
+            }
+        if((int) newcache.size() > cachesize)
+            newcache.resize(cachesize);
+        cache.swap(newcache);
+    }
+    tris.swap(out);
+}
+
+void VertexCacheOptimizer::reorderVertices(std::vector<Triangle> & tris, int nverts, std::vector<int> & order)
+{
+    std::vector<int> remap(nverts, -1);
+    int v;
+
+    order.clear();
+    order.reserve(nverts);
+    for(Triangle & tri : tris)
+        for(int k = 0; k < 3; k++)
+        {
+            v = tri.v[k];
+            if(remap[v] < 0)
+            {
+                remap[v] = (int) order.size();
+                order.push_back(v);
+            }
+            tri.v[k] = remap[v];
+        }
+    for(v = 0; v < nverts; v++)
+        if(remap[v] < 0)
+        {
+            remap[v] = (int) order.size();
+            order.push_back(v);
+        }
+}
+
+float VertexCacheOptimizer::acmr(const std::vector<Triangle> & tris, int nverts) const
+{
+    std::vector<long> entered(nverts, -1); // count of misses when each vertex last entered the cache
+    long misses = 0;
+
+    if(tris.empty())
+        return 0.0f;
+    for(const Triangle & tri : tris)
+        for(int k = 0; k < 3; k++)
+        {
+            int v = tri.v[k];
+            // in a FIFO cache a vertex survives until cachesize further misses have pushed it out
+            if(entered[v] < 0 || misses - entered[v] >= cachesize)
+            {
+                entered[v] = misses;
+                misses++;
+            }
+        }
+    return (float) misses / (float) tris.size();
+}
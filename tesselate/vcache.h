@@ -0,0 +1,68 @@
+#ifndef _VCACHE
+#define _VCACHE
+/**
+ * @file
+ *
+ * Reordering of triangles and vertices for post-transform vertex cache reuse and memory locality.
+ */
+
+#include <vector>
+
+struct Triangle;
+
+/**
+ * Reorders an indexed triangle list following Forsyth's linear-speed vertex cache optimisation. Triangles are
+ * emitted greedily, each time choosing the highest scoring triangle among those using a vertex in a simulated LRU
+ * cache. Vertices score highly when recently used and when few of their triangles remain, so that fans are finished
+ * rather than left with isolated triangles. Vertices can then be renumbered in order of first use, so that vertex
+ * fetches also stream through memory in order. Results depend only on the input.
+ */
+class VertexCacheOptimizer
+{
+private:
+    int cachesize;                  ///< number of vertices held by the simulated cache
+    std::vector<float> cachescore;  ///< score for each position in the cache
+    std::vector<float> valencescore;    ///< bonus for vertices with few triangles left, by number of triangles
+
+    /**
+     * Score of a vertex
+     * @param cachepos  position in the cache, or -1 if not cached
+     * @param remaining number of its triangles still to be emitted
+     */
+    float vertexScore(int cachepos, int remaining) const;
+
+public:
+
+    /**
+     * Constructor
+     * @param size  number of vertices in the post-transform cache being targeted
+     */
+    VertexCacheOptimizer(int size = 32);
+
+    /**
+     * Reorder triangles in place for vertex cache reuse, keeping the winding of each
+     * @param tris      triangles to reorder
+     * @param nverts    number of vertices they index
+     */
+    void optimize(std::vector<Triangle> & tris, int nverts);
+
+    /**
+     * Renumber vertices in order of first use by the triangles, rewriting the triangles to match. Vertices no
+     * triangle uses follow in their original order.
+     * @param tris          triangles whose indices are rewritten
+     * @param nverts        number of vertices they index
+     * @param[out] order    for each new vertex index, the old index it takes its data from
+     */
+    void reorderVertices(std::vector<Triangle> & tris, int nverts, std::vector<int> & order);
+
+    /**
+     * Average cache miss ratio, the number of vertices transformed per triangle when drawing the triangles through
+     * a FIFO cache of the targeted size, as most hardware uses. It ranges from 3 with no reuse down to about 0.5
+     * for a regular mesh.
+     * @param tris      triangles in drawing order
+     * @param nverts    number of vertices they index
+     */
+    float acmr(const std::vector<Triangle> & tris, int nverts) const;
+};
+
+#endif
@@ -191,6 +191,41 @@ bool VoxelVolume::set(int x, int y, int z, bool setval)
     }
 }
 
+bool VoxelVolume::setSpan(int x0, int x1, int y, int z)
+{
+    int * row, w, w0, w1;
+    unsigned int head, tail;
+
+    if(y < 0 || y >= ydim || z < 0 || z >= zdim)
+    {
+        cerr << "Error VoxelVolume::setSpan: row request (" << y << ", " << z << ") out of bounds" << endl;
+        return false;
+    }
+    if(x0 < 0)
+        x0 = 0;
+    if(x1 > xdim)
+        x1 = xdim;
+    if(x0 >= x1)
+        return true;
+
+    // voxel x is bit 31 - x % 32, so the span covers the low bits of its first word and the high bits of its last
+    row = &voxgrid[z * (xspan * ydim) + y * xspan];
+    w0 = x0 / intsize;
+    w1 = (x1 - 1) / intsize;
+    head = 0xffffffffu >> (x0 % intsize);
+    tail = 0xffffffffu << (intsize - 1 - (x1 - 1) % intsize);
+    if(w0 == w1)
+    {
+        row[w0] |= (int) (head & tail);
+        return true;
+    }
+    row[w0] |= (int) head;
+    for(w = w0 + 1; w < w1; w++)
+        row[w] = ~0;
+    row[w1] |= (int) tail;
+    return true;
+}
+
 bool VoxelVolume::get(int x, int y, int z)
 {
     int intidx, bitidx;
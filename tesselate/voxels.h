@@ -110,6 +110,15 @@ public:
      */
     bool set(int x, int y, int z, bool setval);
 
+    /**
+     * Set a run of voxels along x to occupied, whole words at a time
+     * @param x0, x1    range [x0, x1) of voxels to set, clipped to the volume
+     * @param y, z      row location, zero indexed
+     * @retval true if the row is within volume bounds,
+     * @retval false otherwise.
+     */
+    bool setSpan(int x0, int x1, int y, int z);
+
     /**
      * Get the status of a single voxel element at the specified position
      * @param x, y, z   3D location, zero indexed
@@ -118,6 +127,13 @@ public:
      */
     bool get(int x, int y, int z);
 
+    /**
+     * Bit packed occupancy of a row of voxels along x, for processing 32 voxels at a time
+     * @param y, z   row location, zero indexed and within bounds
+     * @returns getXSpan() words, holding voxel x in bit 31 - x % 32 of word x / 32
+     */
+    const int * getRow(int y, int z){ return &voxgrid[z * (xspan * ydim) + y * xspan]; }
+
     /**
      * Find the world-space position of the centre of a voxel
      * @param x, y, z   3D location, zero indexed
@@ -0,0 +1,217 @@
+//
+// Vertex welding
+//
+
+#include "weld.h"
+#include <string.h>
+#include <math.h>
+#include <iostream>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace std;
+
+VertexWelder::VertexWelder(float tol)
+{
+    tolerance = tol;
+}
+
+void VertexWelder::radixSort(std::vector<uint64_t> & keys, int lobit, int hibit)
+{
+    long n = (long) keys.size();
+    int nthreads = 1;
+    uint64_t kand = ~0ULL, kor = 0;
+    std::vector<uint64_t> tmp(n);
+
+#ifdef _OPENMP
+    nthreads = std::max(1, std::min(omp_get_max_threads(), (int) (n / 65536)));
+#endif
+
+    // byte positions where every key has the same value do not need a pass
+    #pragma omp parallel for reduction(&:kand) reduction(|:kor) num_threads(nthreads)
+    for(long i = 0; i < n; i++)
+    {
+        kand &= keys[i];
+        kor |= keys[i];
+    }
+
+    // 11-bit digits keep the per-thread histograms within L1 while needing one pass fewer than bytes for 32 bits
+    const int digitbits = 11, radix = 1 << digitbits;
+    std::vector<long> counts(nthreads * radix);
+    for(int shift = lobit; shift < hibit; shift += digitbits)
+    {
+        uint64_t mask = (uint64_t) (radix - 1) & ((1ULL << (hibit - shift)) - 1);
+        if(((kand ^ kor) >> shift & mask) == 0)
+            continue;
+
+        std::fill(counts.begin(), counts.end(), 0);
+        #pragma omp parallel num_threads(nthreads)
+        {
+            int th = 0, team = 1;
+#ifdef _OPENMP
+            th = omp_get_thread_num();
+            team = omp_get_num_threads(); // may be fewer than requested
+#endif
+            long i0 = n * th / team, i1 = n * (th+1) / team;
+            long * cnt = &counts[th * radix];
+            for(long i = i0; i < i1; i++)
+                cnt[(keys[i] >> shift) & mask]++;
+
+            #pragma omp barrier
+            #pragma omp single
+            {
+                // digit-major, thread-minor offsets keep the sort stable
+                long sum = 0;
+                for(int d = 0; d < radix; d++)
+                    for(int t = 0; t < team; t++)
+                    {
+                        long c = counts[t * radix + d];
+                        counts[t * radix + d] = sum;
+                        sum += c;
+                    }
+            }
+
+            for(long i = i0; i < i1; i++)
+                tmp[cnt[(keys[i] >> shift) & mask]++] = keys[i];
+        }
+        keys.swap(tmp);
+    }
+}
+
+/// Mix the three cell coordinates of a point into a well distributed 32-bit key
+static inline uint32_t mixCells(const uint32_t * c)
+{
+    uint64_t h = ((uint64_t) c[0] << 32 | c[1]) * 0x9E3779B97F4A7C15ULL;
+    h ^= (h >> 29) ^ ((uint64_t) c[2] * 0xBF58476D1CE4E5B9ULL);
+    h ^= h >> 32;
+    h *= 0x94D049BB133111EBULL;
+    return (uint32_t) (h >> 32);
+}
+
+static inline bool sameCells(const uint32_t * c, const uint32_t * d)
+{
+    return c[0] == d[0] && c[1] == d[1] && c[2] == d[2];
+}
+
+int VertexWelder::weldCells(const std::vector<uint32_t> & cells, std::vector<int> & remap, std::vector<int> & leaders)
+{
+    long n = (long) cells.size() / 3, i;
+    int numwelded;
+    std::vector<uint64_t> keys(n);
+    std::vector<int> leader(n);
+    std::vector<uint32_t> misfits;
+
+    // Equal cells only need to end up adjacent, not in any particular order, so sort on a 32-bit hash of the cells.
+    // The point index rides in the low half of each key, which also leaves it ascending within a run.
+    #pragma omp parallel for if(n > 65536)
+    for(i = 0; i < n; i++)
+        keys[i] = (uint64_t) mixCells(&cells[i*3]) << 32 | (uint64_t) i;
+    radixSort(keys, 32, 64);
+
+    // provisionally assign every point to the first point of its hash run
+    #pragma omp parallel if(n > 65536)
+    {
+        int th = 0, team = 1;
+#ifdef _OPENMP
+        th = omp_get_thread_num();
+        team = omp_get_num_threads();
+#endif
+        long r0 = n * th / team, r1 = n * (th+1) / team, r;
+        // move chunk boundaries to the start of a run
+        while(r0 > 0 && r0 < n && (keys[r0] >> 32) == (keys[r0-1] >> 32))
+            r0++;
+        while(r1 > 0 && r1 < n && (keys[r1] >> 32) == (keys[r1-1] >> 32))
+            r1++;
+        int first = 0;
+        for(r = r0; r < r1; r++)
+        {
+            if(r == r0 || (keys[r] >> 32) != (keys[r-1] >> 32))
+                first = (int) (uint32_t) keys[r];
+            leader[(uint32_t) keys[r]] = first;
+        }
+    }
+
+    // Check against the run leader in input order, where leaders are usually close by. Points that differ from it
+    // share a hash with another cell and are grouped separately.
+    #pragma omp parallel if(n > 65536)
+    {
+        std::vector<uint32_t> local;
+        #pragma omp for nowait
+        for(i = 0; i < n; i++)
+            if(!sameCells(&cells[i*3], &cells[leader[i]*3]))
+                local.push_back((uint32_t) i);
+        #pragma omp critical
+        misfits.insert(misfits.end(), local.begin(), local.end());
+    }
+    if(!misfits.empty())
+    {
+        std::sort(misfits.begin(), misfits.end(), [&cells](uint32_t p, uint32_t q)
+        {
+            int cmp = memcmp(&cells[p*3], &cells[q*3], 12);
+            return cmp < 0 || (cmp == 0 && p < q);
+        });
+        for(size_t m = 0; m < misfits.size(); m++)
+            leader[misfits[m]] = (m > 0 && sameCells(&cells[misfits[m]*3], &cells[misfits[m-1]*3])) ? leader[misfits[m-1]] : (int) misfits[m];
+    }
+
+    // number welded vertices by first occurrence
+    leaders.clear();
+    remap.resize(n);
+    for(i = 0; i < n; i++)
+        if(leader[i] == (int) i)
+        {
+            remap[i] = (int) leaders.size();
+            leaders.push_back((int) i);
+        }
+    numwelded = (int) leaders.size();
+
+    #pragma omp parallel for if(n > 65536)
+    for(i = 0; i < n; i++)
+        remap[i] = remap[leader[i]];
+    return numwelded;
+}
+
+int VertexWelder::weld(const std::vector<cgp::Point> & pnts, std::vector<int> & remap, std::vector<cgp::Point> & welded)
+{
+    long n = (long) pnts.size(), i;
+    std::vector<uint32_t> cells(n * 3);
+    std::vector<int> leaders;
+    float bminx = HUGE_VALF, bminy = HUGE_VALF, bminz = HUGE_VALF;
+    float inv = (tolerance > 0.0f) ? 1.0f / tolerance : 0.0f;
+
+    if(tolerance > 0.0f)
+    {
+        #pragma omp parallel for reduction(min:bminx,bminy,bminz) if(n > 65536)
+        for(i = 0; i < n; i++)
+        {
+            bminx = std::min(bminx, pnts[i].x);
+            bminy = std::min(bminy, pnts[i].y);
+            bminz = std::min(bminz, pnts[i].z);
+        }
+    }
+
+    #pragma omp parallel for if(n > 65536)
+    for(i = 0; i < n; i++)
+    {
+        if(tolerance > 0.0f) // grid cell relative to the minimum corner
+        {
+            cells[i*3] = (uint32_t) std::min((pnts[i].x - bminx) * inv, 4.0e9f);
+            cells[i*3+1] = (uint32_t) std::min((pnts[i].y - bminy) * inv, 4.0e9f);
+            cells[i*3+2] = (uint32_t) std::min((pnts[i].z - bminz) * inv, 4.0e9f);
+        }
+        else // exact mode compares bit patterns, with negative zero folded onto zero
+        {
+            float c[3] = {pnts[i].x + 0.0f, pnts[i].y + 0.0f, pnts[i].z + 0.0f};
+            memcpy(&cells[i*3], c, 12);
+        }
+    }
+
+    weldCells(cells, remap, leaders);
+    welded.resize(leaders.size());
+    #pragma omp parallel for if(n > 65536)
+    for(i = 0; i < (long) leaders.size(); i++)
+        welded[i] = pnts[leaders[i]];
+    return (int) welded.size();
+}
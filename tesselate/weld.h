@@ -0,0 +1,66 @@
+#ifndef _WELD
+#define _WELD
+/**
+ * @file
+ *
+ * Parallel sort-based welding of coincident vertices.
+ */
+
+#include <vector>
+#include <stdint.h>
+#include "vecpnt.h"
+
+/**
+ * Welds vertices that fall into the same cell of a grid, or that have identical coordinates in exact mode.
+ * Rather than hashing into a node-based map, a triple of integer cell coordinates is derived for every vertex in
+ * parallel, keys packing a hash of the cells with the point index are sorted with a parallel LSD radix sort, and
+ * runs of equal cells are collapsed in a linear pass. Welded vertices are numbered in order of first occurrence, so results do not depend on the
+ * number of threads.
+ */
+class VertexWelder
+{
+private:
+    float tolerance;    ///< grid cell size, or 0 for exact matching of coordinates
+
+    /**
+     * Stable parallel LSD radix sort on a range of key bits, skipping digits in which all keys agree
+     * @param keys      sort keys, sorted in place
+     * @param lobit     least significant bit that takes part in the ordering
+     * @param hibit     one past the most significant bit that takes part in the ordering
+     */
+    void radixSort(std::vector<uint64_t> & keys, int lobit, int hibit);
+
+public:
+
+    /**
+     * Constructor
+     * @param tol   grid cell size for welding, or 0 to weld only vertices with identical coordinates
+     */
+    VertexWelder(float tol = 0.0f);
+
+    /// Set the grid cell size, with 0 selecting exact mode
+    void setTolerance(float tol){ tolerance = tol; }
+
+    /// Current grid cell size, 0 in exact mode
+    float getTolerance(){ return tolerance; }
+
+    /**
+     * Weld a list of points. In tolerance mode cells are aligned to the minimum corner of the bounding box of the points.
+     * @param pnts          points to weld
+     * @param[out] remap    for each input point, the index of its welded vertex
+     * @param[out] welded   welded vertices, each taking the position of its first occurrence in @a pnts
+     * @returns number of welded vertices
+     */
+    int weld(const std::vector<cgp::Point> & pnts, std::vector<int> & remap, std::vector<cgp::Point> & welded);
+
+    /**
+     * Weld by precomputed integer cell coordinates, for callers that quantise in their own way
+     * @param cells         3 cell coordinates per point
+     * @param[out] remap    for each point, the index of its welded vertex in order of first occurrence
+     * @param[out] leaders  for each welded vertex, the index of the point where it first occurs
+     * @returns number of welded vertices
+     */
+    int weldCells(const std::vector<uint32_t> & cells, std::vector<int> & remap, std::vector<int> & leaders);
+};
+
+#endif
@@ -0,0 +1,709 @@
+#if HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <test/testutil.h>
+#include "bench_mesh.h"
+#include "tesselate/timer.h"
+#include "tesselate/weld.h"
+#include "tesselate/pointarray.h"
+#include "tesselate/vcache.h"
+#include "tesselate/normals.h"
+#include "tesselate/slabvox.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/intersect.hpp>
+#include "common/flat_hash_map.h"
+#include <unordered_map>
+#include <algorithm>
+#include <random>
+#include <stdio.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+using namespace std;
+
+/**
+ * Write a wavy height field of 2 * res * res triangles as both binary and ASCII STL, so that the two
+ * formats hold exactly the same triangle soup
+ */
+static void writeHeightField(int res, const string &binname, const string &asciiname)
+{
+    FILE * bin = fopen(binname.c_str(), "wb");
+    FILE * ascii = fopen(asciiname.c_str(), "w");
+    char header[80] = "Height field benchmark";
+    unsigned int numt = 2 * res * res;
+    unsigned short attr = 0;
+
+    CPPUNIT_ASSERT(bin != NULL && ascii != NULL);
+    fwrite(header, 1, 80, bin);
+    fwrite(&numt, 4, 1, bin);
+    fprintf(ascii, "solid heightfield\n");
+
+    auto height = [res](int x, int y) { return 0.1f * sinf(x * 12.0f / res) * cosf(y * 12.0f / res); };
+    auto emit = [&](float (&v)[3][3])
+    {
+        float rec[12] = {0.0f, 0.0f, 1.0f};
+        for(int p = 0; p < 3; p++)
+            for(int k = 0; k < 3; k++)
+                rec[3+p*3+k] = v[p][k];
+        fwrite(rec, 4, 12, bin);
+        fwrite(&attr, 2, 1, bin);
+        fprintf(ascii, "  facet normal %e %e %e\n    outer loop\n", rec[0], rec[1], rec[2]);
+        for(int p = 0; p < 3; p++)
+            fprintf(ascii, "      vertex %e %e %e\n", v[p][0], v[p][1], v[p][2]);
+        fprintf(ascii, "    endloop\n  endfacet\n");
+    };
+
+    for(int x = 0; x < res; x++)
+        for(int y = 0; y < res; y++)
+        {
+            float x0 = (float) x / res, x1 = (float) (x+1) / res, y0 = (float) y / res, y1 = (float) (y+1) / res;
+            float a[3][3] = {{x0, y0, height(x, y)}, {x1, y0, height(x+1, y)}, {x1, y1, height(x+1, y+1)}};
+            float b[3][3] = {{x0, y0, height(x, y)}, {x1, y1, height(x+1, y+1)}, {x0, y1, height(x, y+1)}};
+            emit(a);
+            emit(b);
+        }
+    fprintf(ascii, "endsolid heightfield\n");
+    fclose(bin);
+    fclose(ascii);
+}
+
+/// Time a load of @a filename and report its throughput
+static float timeRead(Mesh * mesh, const string &filename)
+{
+    Timer timer;
+    struct stat results;
+    float mb, secs;
+
+    CPPUNIT_ASSERT(stat(filename.c_str(), &results) == 0);
+    mb = (float) results.st_size / (1024.0f * 1024.0f);
+    timer.start();
+    CPPUNIT_ASSERT(mesh->readSTL(filename));
+    timer.stop();
+    secs = timer.peek();
+    cerr << filename << ": " << mb << " MB in " << secs << "s = " << mb / secs << " MB/s" << endl;
+    return mb / secs;
+}
+
+void BenchMesh::setUp()
+{
+    mesh = new Mesh();
+}
+
+void BenchMesh::tearDown()
+{
+    delete mesh;
+}
+
+void BenchMesh::benchReadSTL()
+{
+    TempDirectory tmpdir("bench_mesh_tmp");
+    int res = 500, numv, numf;
+    float binrate, asciirate;
+
+    writeHeightField(res, "bench_mesh_tmp/field.stl", "bench_mesh_tmp/field_ascii.stl");
+
+    binrate = timeRead(mesh, "bench_mesh_tmp/field.stl");
+    numv = mesh->getNumVerts();
+    numf = mesh->getNumFaces();
+    CPPUNIT_ASSERT_EQUAL((res+1) * (res+1), numv);
+    CPPUNIT_ASSERT_EQUAL(2 * res * res, numf);
+
+    asciirate = timeRead(mesh, "bench_mesh_tmp/field_ascii.stl");
+    CPPUNIT_ASSERT_EQUAL(numv, mesh->getNumVerts());
+    CPPUNIT_ASSERT_EQUAL(numf, mesh->getNumFaces());
+    cerr << "ASCII STL loads at " << asciirate / binrate << " of binary throughput" << endl << endl;
+}
+
+void BenchMesh::benchArchive()
+{
+    TempDirectory tmpdir("bench_mesh_tmp");
+    Timer timer;
+    struct stat stlstat, tmzstat;
+    int res = 500, numv, numf;
+    float mb;
+
+    writeHeightField(res, "bench_mesh_tmp/field.stl", "bench_mesh_tmp/field_ascii.stl");
+    CPPUNIT_ASSERT(mesh->readSTL("bench_mesh_tmp/field.stl"));
+    numv = mesh->getNumVerts();
+    numf = mesh->getNumFaces();
+
+    timer.start();
+    CPPUNIT_ASSERT(mesh->writeArchive("bench_mesh_tmp/field.tmz", 16));
+    timer.stop();
+    cerr << "archive written in " << timer.peek() << "s" << endl;
+
+    timer.start();
+    CPPUNIT_ASSERT(mesh->readArchive("bench_mesh_tmp/field.tmz"));
+    timer.stop();
+    CPPUNIT_ASSERT_EQUAL(numv, mesh->getNumVerts());
+    CPPUNIT_ASSERT_EQUAL(numf, mesh->getNumFaces());
+
+    CPPUNIT_ASSERT(stat("bench_mesh_tmp/field.stl", &stlstat) == 0);
+    CPPUNIT_ASSERT(stat("bench_mesh_tmp/field.tmz", &tmzstat) == 0);
+    mb = (float) (numv * 12 + numf * 12) / (1024.0f * 1024.0f);
+    cerr << "archive is " << (float) stlstat.st_size / (float) tmzstat.st_size << "x smaller than STL, decoded "
+         << mb << " MB in " << timer.peek() << "s = " << mb / timer.peek() << " MB/s" << endl << endl;
+}
+
+void BenchMesh::benchWeld()
+{
+    Timer timer;
+    VertexWelder welder;
+    std::vector<cgp::Point> soup, welded;
+    std::vector<int> remap, hashremap;
+    std::unordered_map<long, int> lookup;
+    int res = 1000, x, y, k;
+    float mb;
+
+    // triangle soup of a grid, so that interior vertices are repeated six times
+    for(x = 0; x < res; x++)
+        for(y = 0; y < res; y++)
+        {
+            const int corners[6][2] = {{0, 0}, {1, 0}, {1, 1}, {0, 0}, {1, 1}, {0, 1}};
+            for(k = 0; k < 6; k++)
+                soup.push_back(cgp::Point((float) (x + corners[k][0]), (float) (y + corners[k][1]), 0.0f));
+        }
+    mb = (float) (soup.size() * sizeof(cgp::Point)) / (1024.0f * 1024.0f);
+
+    timer.start();
+    hashremap.resize(soup.size());
+    for(std::size_t i = 0; i < soup.size(); i++)
+    {
+        long key = (long) soup[i].x * (res+1) + (long) soup[i].y;
+        auto found = lookup.emplace(key, (int) lookup.size());
+        hashremap[i] = found.first->second;
+    }
+    timer.stop();
+    cerr << "hash map weld of " << soup.size() << " vertices in " << timer.peek() << "s = " << mb / timer.peek() << " MB/s" << endl;
+
+    timer.start();
+    welder.weld(soup, remap, welded);
+    timer.stop();
+    cerr << "radix sort weld of " << soup.size() << " vertices in " << timer.peek() << "s = " << mb / timer.peek() << " MB/s" << endl << endl;
+
+    CPPUNIT_ASSERT_EQUAL((res+1) * (res+1), (int) welded.size());
+    CPPUNIT_ASSERT(remap == hashremap);
+}
+
+/**
+ * Time inserting @a keys into a map, numbering them by first occurrence, and then looking every key up again
+ * @returns sum of the looked up values, so that the lookups cannot be optimised away
+ */
+template<typename Map> static long timeMap(const char * name, const vector<long> & keys, int lookups)
+{
+    Timer timer;
+    Map map;
+    long sum = 0;
+    double mops = (double) keys.size() / 1.0e6;
+
+    timer.start();
+    map.reserve(keys.size());
+    for(size_t i = 0; i < keys.size(); i++)
+        map.emplace(keys[i], (int) map.size());
+    timer.stop();
+    cerr << name << " insert " << mops / timer.peek() << " Mops/s";
+
+    timer.start();
+    for(int r = 0; r < lookups; r++)
+        for(size_t i = 0; i < keys.size(); i++)
+            sum += map.find(keys[i])->second;
+    timer.stop();
+    cerr << ", lookup " << mops * lookups / timer.peek() << " Mops/s" << endl;
+    return sum;
+}
+
+/// Time inserting @a keys into a multimap and then visiting every entry of each key through equal_range
+template<typename Map> static long timeMultimap(const char * name, const vector<long> & keys)
+{
+    Timer timer;
+    Map map;
+    long sum = 0;
+    double mops = (double) keys.size() / 1.0e6;
+
+    timer.start();
+    map.reserve(keys.size());
+    for(size_t i = 0; i < keys.size(); i++)
+        map.emplace(keys[i], (int) i);
+    timer.stop();
+    cerr << name << " insert " << mops / timer.peek() << " Mops/s";
+
+    timer.start();
+    for(size_t i = 0; i < keys.size(); i++)
+    {
+        auto range = map.equal_range(keys[i]);
+        for(auto it = range.first; it != range.second; ++it)
+            sum += it->second;
+    }
+    timer.stop();
+    cerr << ", equal_range " << mops / timer.peek() << " Mops/s" << endl;
+    return sum;
+}
+
+void BenchMesh::benchHashMap()
+{
+    vector<long> keys, tripkeys;
+    int res = 1000, x, y, k;
+
+    // vertex keys of a welded grid soup in the style of Mesh::hashVert, each repeated six times
+    for(x = 0; x < res; x++)
+        for(y = 0; y < res; y++)
+        {
+            const int corners[6][2] = {{0, 0}, {1, 0}, {1, 1}, {0, 0}, {1, 1}, {0, 1}};
+            for(k = 0; k < 6; k++)
+                keys.push_back(((long) (x + corners[k][0]) * 10000 + (long) (y + corners[k][1])) * 10000);
+        }
+
+    // vertex index sums of the same grid's triangles, a key that collides often
+    for(x = 0; x < res; x++)
+        for(y = 0; y < res; y++)
+        {
+            long v = (long) x * (res+1) + y;
+            tripkeys.push_back(v + (v + res + 2) + (v + 1));
+            tripkeys.push_back(v + (v + res + 1) + (v + res + 2));
+        }
+
+    // real soups are not ordered spatially, which would flatter the locality of identity hashing
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(1));
+    std::shuffle(tripkeys.begin(), tripkeys.end(), std::mt19937(2));
+
+    long stdsum = timeMap<std::unordered_map<long, int>>("std::unordered_map", keys, 4);
+    long flatsum = timeMap<uts::flat_hash_map<long, int>>("uts::flat_hash_map", keys, 4);
+    CPPUNIT_ASSERT_EQUAL(stdsum, flatsum);
+
+    stdsum = timeMultimap<std::unordered_multimap<long, int>>("std::unordered_multimap", tripkeys);
+    flatsum = timeMultimap<uts::flat_hash_multimap<long, int>>("uts::flat_hash_multimap", tripkeys);
+    cerr << endl;
+    CPPUNIT_ASSERT_EQUAL(stdsum, flatsum);
+}
+
+/// Fill @a mesh with an nu by nv torus wrapped in both directions, so every edge has two triangles
+static void buildTorus(Mesh * mesh, int nu, int nv)
+{
+    Triangle tri;
+    int u, v;
+    const float twopi = 6.2831853f;
+
+    for(u = 0; u < nu; u++)
+        for(v = 0; v < nv; v++)
+        {
+            float a = twopi * (float) u / (float) nu, b = twopi * (float) v / (float) nv;
+            mesh->getVerts()->push_back(cgp::Point((3.0f + cosf(b)) * cosf(a), (3.0f + cosf(b)) * sinf(a), sinf(b)));
+        }
+    for(u = 0; u < nu; u++)
+        for(v = 0; v < nv; v++)
+        {
+            int p00 = u * nv + v, p10 = ((u+1) % nu) * nv + v, p01 = u * nv + (v+1) % nv, p11 = ((u+1) % nu) * nv + (v+1) % nv;
+            tri.v[0] = p00; tri.v[1] = p10; tri.v[2] = p11;
+            mesh->getCubeTriangles()->push_back(tri);
+            tri.v[0] = p00; tri.v[1] = p11; tri.v[2] = p01;
+            mesh->getCubeTriangles()->push_back(tri);
+        }
+}
+
+void BenchMesh::benchManifold()
+{
+    Timer timer;
+    ManifoldReport report;
+    int nu = 2000, nv = 800;
+
+    buildTorus(mesh, nu, nv);
+
+    timer.start();
+    bool valid = mesh->manifoldValidity(report);
+    timer.stop();
+    cerr << "manifold validation of " << mesh->getNumFaces() << " triangles in " << timer.peek() << "s" << endl;
+    CPPUNIT_ASSERT(valid);
+
+    // a hole is reported in full
+    mesh->getCubeTriangles()->resize(mesh->getNumFaces() - 2 * nv);
+    timer.start();
+    valid = mesh->manifoldValidity(report);
+    timer.stop();
+    cerr << "with a cut, " << report.boundary.size() << " boundary edges found in " << timer.peek() << "s" << endl << endl;
+    CPPUNIT_ASSERT(!valid);
+    CPPUNIT_ASSERT_EQUAL(2 * nv, (int) report.boundary.size());
+}
+
+void BenchMesh::benchComponents()
+{
+    Timer timer;
+    MeshComponents comp;
+    Mesh part;
+    int nu = 2000, nv = 800, c;
+
+    // cut the torus into 20 rings by dropping every hundredth band of triangles
+    buildTorus(mesh, nu, nv);
+    std::vector<Triangle> * tris = mesh->getCubeTriangles();
+    std::vector<Triangle> kept;
+    for(int t = 0; t < (int) tris->size(); t++)
+        if((t / (2 * nv)) % 100 != 99)
+            kept.push_back((* tris)[t]);
+    tris->swap(kept);
+
+    timer.start();
+    mesh->findComponents(comp);
+    timer.stop();
+    cerr << "labelled " << comp.size() << " components of " << mesh->getNumFaces() << " triangles in " << timer.peek() << "s" << endl;
+    CPPUNIT_ASSERT_EQUAL(20, comp.size());
+
+    timer.start();
+    for(c = 0; c < comp.size(); c++)
+        mesh->extractComponent(comp, c, part);
+    timer.stop();
+    cerr << "extracted every component in " << timer.peek() << "s" << endl << endl;
+    CPPUNIT_ASSERT_EQUAL(99 * 2 * nv, part.getNumFaces());
+}
+
+void BenchMesh::benchPointArray()
+{
+    Timer timer;
+    PointArray arr;
+    std::vector<cgp::Point> * verts;
+    std::vector<cgp::Point> aos;
+    cgp::BoundBox bbox;
+    float aostime, soatime;
+    int v, n;
+
+    buildTorus(mesh, 2000, 800);
+    verts = mesh->getVerts();
+    n = (int) verts->size();
+    glm::mat4x4 tfm = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, 2.0f, 3.0f)), 0.4f, glm::vec3(0.0f, 0.0f, 1.0f));
+
+    // transform and bound one point at a time through glm, as the mesh code used to
+    timer.start();
+    aos.resize(n);
+    for(v = 0; v < n; v++)
+    {
+        glm::vec4 p = tfm * glm::vec4((* verts)[v].x, (* verts)[v].y, (* verts)[v].z, 1.0f);
+        aos[v] = cgp::Point(p.x, p.y, p.z);
+        bbox.includePnt(aos[v]);
+    }
+    timer.stop();
+    aostime = timer.peek();
+
+    arr.load(* verts);
+    timer.start();
+    arr.transform(tfm);
+    cgp::BoundBox soabox = arr.bounds();
+    timer.stop();
+    soatime = timer.peek();
+    cerr << "transform and bound " << n << " points: per point " << aostime << "s, structure of arrays " << soatime << "s" << endl << endl;
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(bbox.min.x, soabox.min.x, 1e-5f);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(bbox.max.z, soabox.max.z, 1e-5f);
+}
+
+void BenchMesh::benchSimplify()
+{
+    Timer timer;
+    Mesh par;
+    int nu = 1000, nv = 400, target = nu * nv / 5;
+
+    buildTorus(mesh, nu, nv);
+    timer.start();
+    mesh->simplify(target);
+    timer.stop();
+    cerr << "simplified " << 2 * nu * nv << " triangles to " << mesh->getNumFaces() << " in " << timer.peek() << "s" << endl;
+    CPPUNIT_ASSERT_EQUAL(target, mesh->getNumFaces());
+
+    buildTorus(&par, nu, nv);
+    timer.start();
+    par.simplifyParallel(target);
+    timer.stop();
+    cerr << "simplified in parallel slabs to " << par.getNumFaces() << " in " << timer.peek() << "s" << endl << endl;
+    CPPUNIT_ASSERT(par.getNumFaces() <= target);
+    CPPUNIT_ASSERT(par.manifoldValidity());
+}
+
+void BenchMesh::benchOptimizeLocality()
+{
+    Timer timer;
+    VertexCacheOptimizer vco;
+    std::mt19937 rng(1);
+    float shuffledtime, orderedtime;
+    int v, nv;
+
+    // shuffle triangles and vertices, as in a mesh read from an unordered triangle soup
+    buildTorus(mesh, 2000, 800);
+    std::vector<Triangle> * tris = mesh->getCubeTriangles();
+    std::vector<cgp::Point> * verts = mesh->getVerts();
+    nv = (int) verts->size();
+    std::vector<int> perm(nv);
+    std::vector<cgp::Point> moved(nv);
+    for(v = 0; v < nv; v++)
+        perm[v] = v;
+    std::shuffle(perm.begin(), perm.end(), rng);
+    for(v = 0; v < nv; v++)
+        moved[perm[v]] = (* verts)[v];
+    verts->swap(moved);
+    for(Triangle & tri : * tris)
+        for(int k = 0; k < 3; k++)
+            tri.v[k] = perm[tri.v[k]];
+    std::shuffle(tris->begin(), tris->end(), rng);
+
+    Mesh ordered(* mesh);
+    timer.start();
+    ordered.optimizeLocality();
+    timer.stop();
+    cerr << "reordered " << mesh->getNumFaces() << " triangles in " << timer.peek() << "s, ACMR "
+         << vco.acmr(* tris, nv) << " shuffled, " << vco.acmr(* ordered.getCubeTriangles(), nv) << " reordered" << endl;
+    CPPUNIT_ASSERT(vco.acmr(* ordered.getCubeTriangles(), nv) < 1.0f);
+
+    timer.start();
+    mesh->laplacianSmooth(3, 0.5f);
+    timer.stop();
+    shuffledtime = timer.peek();
+    timer.start();
+    ordered.laplacianSmooth(3, 0.5f);
+    timer.stop();
+    orderedtime = timer.peek();
+    cerr << "laplacian smoothing: shuffled " << shuffledtime << "s, reordered " << orderedtime << "s" << endl;
+
+    timer.start();
+    mesh->pointContainment(cgp::Point(3.0f, 0.0f, 0.0f));
+    timer.stop();
+    shuffledtime = timer.peek();
+    timer.start();
+    ordered.pointContainment(cgp::Point(3.0f, 0.0f, 0.0f));
+    timer.stop();
+    orderedtime = timer.peek();
+    cerr << "point containment: shuffled " << shuffledtime << "s, reordered " << orderedtime << "s" << endl << endl;
+}
+
+void BenchMesh::benchNormals()
+{
+    Timer timer;
+    NormalEngine engine;
+    std::vector<cgp::Vector> norms, scalar;
+    cgp::Vector evec[2];
+    float scalartime;
+    int t;
+
+    buildTorus(mesh, 2000, 800);
+    std::vector<cgp::Point> & verts = * mesh->getVerts();
+    std::vector<Triangle> & tris = * mesh->getCubeTriangles();
+    const MeshAdjacency & adj = mesh->getAdjacency();
+
+    // normalised edges and cross product per triangle, as the mesh used to
+    scalar.resize(tris.size());
+    timer.start();
+    for(t = 0; t < (int) tris.size(); t++)
+    {
+        evec[0].diff(verts[tris[t].v[0]], verts[tris[t].v[1]]);
+        evec[1].diff(verts[tris[t].v[0]], verts[tris[t].v[2]]);
+        evec[0].normalize();
+        evec[1].normalize();
+        scalar[t].cross(evec[0], evec[1]);
+        scalar[t].normalize();
+    }
+    timer.stop();
+    scalartime = timer.peek();
+    timer.start();
+    engine.faceNormals(verts, tris);
+    timer.stop();
+    cerr << "face normals of " << tris.size() << " triangles: per triangle " << scalartime << "s, batched " << timer.peek() << "s" << endl;
+    for(t = 0; t < (int) tris.size(); t += 997)
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(1.0f, tris[t].n.dot(scalar[t]), 1e-5f);
+
+    const char * names[3] = {"uniform", "area", "angle"};
+    NormalWeight weights[3] = {NormalWeight::UNIFORM, NormalWeight::AREA, NormalWeight::ANGLE};
+    for(int w = 0; w < 3; w++)
+    {
+        engine.setWeighting(weights[w]);
+        timer.start();
+        engine.vertexNormals(verts, tris, adj, norms);
+        timer.stop();
+        cerr << names[w] << " vertex normals in " << timer.peek() << "s" << endl;
+    }
+    cerr << endl;
+}
+
+void BenchMesh::benchIncrementalFFD()
+{
+    Timer timer;
+    ffd lat(4, 4, 4, cgp::Point(2.0f, -4.5f, -1.5f), cgp::Vector(2.5f, 4.5f, 3.0f));
+    std::vector<cgp::Point> base, full;
+    cgp::Point pnt;
+    float fulltime = 0.0f, inctime = 0.0f;
+    int v, step, nsteps = 10;
+
+    // the lattice covers about a sixth of the torus
+    buildTorus(mesh, 2000, 800);
+    base = * mesh->getVerts();
+    mesh->applyFFD(&lat);
+
+    for(step = 0; step < nsteps; step++)
+    {
+        pnt = lat.getCP(2, 1, 2);
+        lat.setCP(2, 1, 2, cgp::Point(pnt.x + 0.1f, pnt.y, pnt.z + 0.05f));
+
+        // every vertex from its base, one at a time, as applyFFD used to
+        full = base;
+        timer.start();
+        for(v = 0; v < (int) full.size(); v++)
+            lat.deform(full[v]);
+        timer.stop();
+        fulltime += timer.peek();
+
+        timer.start();
+        mesh->applyFFD(&lat);
+        timer.stop();
+        inctime += timer.peek();
+    }
+    cerr << "ffd of " << base.size() << " vertices per control point move: full " << fulltime / (float) nsteps
+         << "s without normals, incremental " << inctime / (float) nsteps << "s with normals" << endl;
+    std::vector<cgp::Point> & verts = * mesh->getVerts();
+    for(v = 0; v < (int) verts.size(); v += 997)
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(full[v].y, verts[v].y, 1e-3f);
+    cerr << endl;
+}
+
+void BenchMesh::benchFFDKernel()
+{
+    Timer timer;
+    std::vector<cgp::Point> pnts, batch;
+    cgp::Point p;
+    float pointtime;
+    int d, i, j, k, v;
+
+    buildTorus(mesh, 1250, 800);
+    pnts = * mesh->getVerts();
+    for(d = 3; d <= 4; d++)
+    {
+        ffd lat(d, d, d, cgp::Point(-4.5f, -4.5f, -1.5f), cgp::Vector(9.0f, 9.0f, 3.0f));
+        for(i = 0; i < d; i++)
+            for(j = 0; j < d; j++)
+                for(k = 0; k < d; k++)
+                {
+                    p = lat.getCP(i, j, k);
+                    lat.setCP(i, j, k, cgp::Point(p.x * (1.0f + 0.1f * (float) k), p.y, p.z + 0.3f * (float) i));
+                }
+
+        batch = pnts;
+        timer.start();
+        for(v = 0; v < (int) batch.size(); v++)
+            lat.deform(batch[v]);
+        timer.stop();
+        pointtime = timer.peek();
+        timer.start();
+        lat.deform(pnts, batch);
+        timer.stop();
+        cerr << d << "x" << d << "x" << d << " ffd of " << pnts.size() << " vertices: per point " << pointtime
+             << "s, batched " << timer.peek() << "s" << endl;
+
+        for(v = 0; v < (int) pnts.size(); v += 997)
+        {
+            p = pnts[v];
+            lat.deform(p);
+            CPPUNIT_ASSERT_DOUBLES_EQUAL(p.z, batch[v].z, 1e-4f);
+        }
+    }
+
+    // a fine B-spline lattice costs the same per vertex as a 4x4x4 Bezier one, however many control points it has
+    for(d = 8; d <= 32; d *= 4)
+    {
+        ffd lat(d, d, d, cgp::Point(-4.5f, -4.5f, -1.5f), cgp::Vector(9.0f, 9.0f, 3.0f), FFDBasis::BSPLINE);
+        p = lat.getCP(d/2, d/2, d/2);
+        lat.setCP(d/2, d/2, d/2, cgp::Point(p.x, p.y, p.z + 1.0f));
+        timer.start();
+        lat.deform(pnts, batch);
+        timer.stop();
+        cerr << d << "x" << d << "x" << d << " b-spline ffd of " << pnts.size() << " vertices: " << timer.peek() << "s" << endl;
+    }
+    cerr << endl;
+}
+
+void BenchMesh::benchContainment()
+{
+    Timer timer;
+    std::vector<cgp::Point> pnts;
+    std::mt19937 gen(11);
+    std::uniform_real_distribution<float> across(-4.5f, 4.5f), up(-1.2f, 1.2f);
+    glm::vec3 v[3], ray(1.0f, 0.0f, 0.0f);
+    glm::vec2 bary;
+    float d, brutetime;
+    int i, t, p, hits, inside = 0, brute = 20, queries = 100000;
+    std::vector<bool> parity;
+
+    buildTorus(mesh, 1000, 400);
+    for(i = 0; i < queries; i++)
+        pnts.push_back(cgp::Point(across(gen), across(gen), up(gen)));
+
+    // the previous approach, every triangle against every ray
+    std::vector<cgp::Point> & verts = * mesh->getVerts();
+    std::vector<Triangle> & tris = * mesh->getCubeTriangles();
+    timer.start();
+    for(i = 0; i < brute; i++)
+    {
+        glm::vec3 origin(pnts[i].x, pnts[i].y, pnts[i].z);
+        for(t = 0, hits = 0; t < (int) tris.size(); t++)
+        {
+            for(p = 0; p < 3; p++)
+                v[p] = glm::vec3(verts[tris[t].v[p]].x, verts[tris[t].v[p]].y, verts[tris[t].v[p]].z);
+            if(glm::intersectRayTriangle(origin, ray, v[0], v[1], v[2], bary, d) && d > 0.0f)
+                hits++;
+        }
+        parity.push_back(hits % 2 == 1);
+    }
+    timer.stop();
+    brutetime = timer.peek() / (float) brute;
+
+    timer.start();
+    mesh->pointContainment(pnts[0]);
+    timer.stop();
+    cerr << "hierarchy over " << mesh->getNumFaces() << " triangles built in " << timer.peek() << "s" << endl;
+    for(i = 0; i < brute; i++)
+        CPPUNIT_ASSERT_EQUAL((bool) parity[i], mesh->pointContainment(pnts[i]));
+
+    timer.start();
+    for(i = 0; i < queries; i++)
+        if(mesh->pointContainment(pnts[i]))
+            inside++;
+    timer.stop();
+    cerr << "containment per point: all triangles " << brutetime << "s, through hierarchy " << timer.peek() / (float) queries
+         << "s (" << inside << " of " << queries << " inside)" << endl << endl;
+}
+
+void BenchMesh::benchColumnVoxelise()
+{
+    Timer timer;
+    VoxelVolume vox(256, 256, 256, cgp::Point(-4.2f, -4.2f, -1.2f), cgp::Vector(8.4f, 8.4f, 2.4f));
+    std::vector<float> tris;
+    float pointtime;
+    int x, y, z, dx, dy, dz, layers = 4, mismatched = 0;
+
+    buildTorus(mesh, 1000, 400);
+    vox.getDim(dx, dy, dz);
+    mesh->pointContainment(cgp::Point(0.0f, 0.0f, 0.0f)); // build the triangle hierarchy outside the timing
+
+    // the previous walk, every voxel centre on its own
+    timer.start();
+    for(z = dz / 2; z < dz / 2 + layers; z++)
+        #pragma omp parallel for private(x)
+        for(y = 0; y < dy; y++)
+            for(x = 0; x < dx; x++)
+                vox.set(x, y, z, mesh->pointContainment(vox.getVoxelPos(x, y, z)));
+    timer.stop();
+    pointtime = timer.peek() * (float) dz / (float) layers;
+
+    VoxelVolume cols(256, 256, 256, cgp::Point(-4.2f, -4.2f, -1.2f), cgp::Vector(8.4f, 8.4f, 2.4f));
+    timer.start();
+    mesh->getWorldTriangles(tris);
+    cols.fill(false);
+    scanConvertTriangles(tris, &cols, 0, dz);
+    timer.stop();
+    cerr << dx << "x" << dy << "x" << dz << " voxelisation of " << mesh->getNumFaces() << " triangles: per voxel about "
+         << pointtime << "s, by column " << timer.peek() << "s" << endl;
+
+    for(z = dz / 2; z < dz / 2 + layers; z++)
+        for(y = 0; y < dy; y++)
+            for(x = 0; x < dx; x++)
+                if(vox.get(x, y, z) != cols.get(x, y, z))
+                    mismatched++;
+    cerr << mismatched << " voxels differ over the compared layers" << endl << endl;
+    CPPUNIT_ASSERT(mismatched < dx * dy * layers / 10000);
+}
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(BenchMesh, TestSet::perNightly());
@@ -0,0 +1,119 @@
+#ifndef TILER_BENCH_MESH_H
+#define TILER_BENCH_MESH_H
+
+#include <string>
+#include <cppunit/extensions/HelperMacros.h>
+#include "tesselate/mesh.h"
+
+/// Throughput benchmarks for @ref Mesh file handling. These are slow, so run nightly rather than per build.
+class BenchMesh : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(BenchMesh);
+    CPPUNIT_TEST(benchReadSTL);
+    CPPUNIT_TEST(benchArchive);
+    CPPUNIT_TEST(benchWeld);
+    CPPUNIT_TEST(benchHashMap);
+    CPPUNIT_TEST(benchManifold);
+    CPPUNIT_TEST(benchComponents);
+    CPPUNIT_TEST(benchPointArray);
+    CPPUNIT_TEST(benchSimplify);
+    CPPUNIT_TEST(benchOptimizeLocality);
+    CPPUNIT_TEST(benchNormals);
+    CPPUNIT_TEST(benchIncrementalFFD);
+    CPPUNIT_TEST(benchFFDKernel);
+    CPPUNIT_TEST(benchContainment);
+    CPPUNIT_TEST(benchColumnVoxelise);
+    CPPUNIT_TEST_SUITE_END();
+
+private:
+    Mesh * mesh;
+
+public:
+
+    /// Initialization before benchmarks
+    void setUp();
+
+    /// Tidying up after benchmarks
+    void tearDown();
+
+    /**
+     * Compare load throughput in MB/s of binary and ASCII STL files describing the same large
+     * height field, and check that both produce the same welded mesh
+     */
+    void benchReadSTL();
+
+    /**
+     * Report compression ratio against binary STL and decode throughput, in MB/s of vertex and index data,
+     * of the compressed mesh archive
+     */
+    void benchArchive();
+
+    /**
+     * Compare welding a large triangle soup by radix sort against the node based hash map approach
+     */
+    void benchWeld();
+
+    /**
+     * Compare insert and lookup throughput of the open-addressing hash map and multimap against the standard
+     * node based containers, on keys like those produced by mesh welding and validation
+     */
+    void benchHashMap();
+
+    /**
+     * Time manifold validation of a closed torus with millions of triangles, including building the adjacency
+     */
+    void benchManifold();
+
+    /**
+     * Time component labelling and extraction on a torus cut into rings
+     */
+    void benchComponents();
+
+    /**
+     * Time an affine transform and bounding box of a large point set, one glm point at a time against the
+     * structure-of-arrays kernels
+     */
+    void benchPointArray();
+
+    /**
+     * Time quadric decimation of a large torus to a tenth of its triangles, serially and in parallel slabs
+     */
+    void benchSimplify();
+
+    /**
+     * Report the cache miss ratio of a shuffled torus before and after reordering, with the time taken by smoothing
+     * and point containment on each order
+     */
+    void benchOptimizeLocality();
+
+    /**
+     * Time face normals one triangle at a time against the SIMD batches, and vertex normals under each weighting
+     */
+    void benchNormals();
+
+    /**
+     * Time dragging one control point of a lattice over a large torus, reapplying the whole deformation against
+     * moving only the vertices it influences
+     */
+    void benchIncrementalFFD();
+
+    /**
+     * Time deforming a million vertex torus one point at a time against the batched kernel, with 3x3x3 and 4x4x4
+     * lattices, then with 8x8x8 and 32x32x32 B-spline lattices
+     */
+    void benchFFDKernel();
+
+    /**
+     * Time point containment on a torus with 800k triangles by testing every triangle against building the triangle
+     * hierarchy once and querying through it
+     */
+    void benchContainment();
+
+    /**
+     * Time voxelising a torus with 800k triangles into a 256^3 volume by column parity, against per-voxel point
+     * containment over a few layers scaled up to the whole volume
+     */
+    void benchColumnVoxelise();
+};
+
+#endif /* !TILER_BENCH_MESH_H */
@@ -134,6 +134,118 @@ void TestFFD::testIdentity()
     cerr << "FFD IDENTITY TEST PASSED" << endl << endl;
 }
 
+void TestFFD::testBatch()
+{
+    ffd * lats[3] = {linearffd, cubicffd, mixffd};
+    std::vector<cgp::Point> pnts, batch, inplace;
+    cgp::Point p;
+    int dim[3], i, j, k, l, n = 1003; // not a whole number of batches or SIMD lanes
+
+    srand(7);
+    for(i = 0; i < n; i++) // points within the unit lattices and a margin around them
+        pnts.push_back(cgp::Point((float) (rand()%1000) / 700.0f - 0.2f, (float) (rand()%1000) / 700.0f - 0.2f,
+                                  (float) (rand()%1000) / 700.0f - 0.2f));
+    pnts.push_back(cgp::Point(1.0f, 1.0f, 1.0f));
+
+    for(l = 0; l < 3; l++)
+    {
+        lats[l]->getDim(dim[0], dim[1], dim[2]);
+        for(i = 0; i < dim[0]; i++)
+            for(j = 0; j < dim[1]; j++)
+                for(k = 0; k < dim[2]; k++)
+                {
+                    p = lats[l]->getCP(i, j, k);
+                    lats[l]->setCP(i, j, k, cgp::Point(p.x + 0.1f * (float) j, p.y - 0.2f * (float) (k * i), p.z + 0.05f * (float) i));
+                }
+
+        lats[l]->deform(pnts, batch);
+        CPPUNIT_ASSERT_EQUAL((int) pnts.size(), (int) batch.size());
+        for(i = 0; i < (int) pnts.size(); i++)
+        {
+            p = pnts[i];
+            lats[l]->deform(p);
+            CPPUNIT_ASSERT_DOUBLES_EQUAL(p.x, batch[i].x, 1e-5f);
+            CPPUNIT_ASSERT_DOUBLES_EQUAL(p.y, batch[i].y, 1e-5f);
+            CPPUNIT_ASSERT_DOUBLES_EQUAL(p.z, batch[i].z, 1e-5f);
+        }
+
+        // in place
+        inplace = pnts;
+        lats[l]->deform(inplace, inplace);
+        for(i = 0; i < (int) pnts.size(); i++)
+            CPPUNIT_ASSERT(inplace[i].x == batch[i].x && inplace[i].y == batch[i].y && inplace[i].z == batch[i].z);
+    }
+    cerr << "FFD BATCH TEST PASSED" << endl << endl;
+}
+
+void TestFFD::testBSpline()
+{
+    ffd spline(32, 32, 32, cgp::Point(0.0f, 0.0f, 0.0f), cgp::Vector(1.0f, 1.0f, 1.0f), FFDBasis::BSPLINE);
+    ffd small(4, 4, 4, cgp::Point(0.0f, 0.0f, 0.0f), cgp::Vector(1.0f, 1.0f, 1.0f), FFDBasis::BSPLINE);
+    std::vector<cgp::Point> pnts, batch, moved;
+    std::vector<int> touched;
+    FFDEmbedding emb;
+    cgp::Point p, d1 = cgp::Point(-1.0f, -1.0f, -1.0f);
+    float lo, hi;
+    int dim[3], i, j, k, n = 2000;
+
+    spline.getDim(dim[0], dim[1], dim[2]);
+    CPPUNIT_ASSERT_EQUAL(32, dim[0]);
+    CPPUNIT_ASSERT(spline.getBasis() == FFDBasis::BSPLINE);
+
+    // identity by linear precision
+    srand(11);
+    for(i = 0; i < n; i++)
+        pnts.push_back(cgp::Point((float) (rand()%1001) / 1000.0f, (float) (rand()%1001) / 1000.0f, (float) (rand()%1001) / 1000.0f));
+    spline.deform(pnts, batch);
+    for(i = 0; i < n; i++)
+        CPPUNIT_ASSERT(batch[i] == pnts[i]);
+
+    // clamped ends interpolate the corner control points
+    spline.setCP(0, 0, 0, d1);
+    p = cgp::Point(0.0f, 0.0f, 0.0f); spline.deform(p);
+    CPPUNIT_ASSERT(p == d1);
+
+    // a control point moves only the points inside its support of 4 knot spans along each axis
+    spline.embed(pnts, emb);
+    moved = batch;
+    p = spline.getCP(16, 10, 20);
+    spline.setCP(16, 10, 20, cgp::Point(p.x + 0.5f, p.y + 0.5f, p.z));
+    CPPUNIT_ASSERT_EQUAL(1, spline.updateEmbedded(emb, moved, touched));
+    CPPUNIT_ASSERT(!touched.empty() && (int) touched.size() < n / 100);
+    spline.deform(pnts, batch);
+    for(i = 0; i < n; i++)
+    {
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(batch[i].x, moved[i].x, 1e-5f);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(batch[i].y, moved[i].y, 1e-5f);
+        p = pnts[i];
+        spline.deform(p);
+        CPPUNIT_ASSERT(p == batch[i]);
+    }
+    lo = (16.0f - 3.0f) / 29.0f; hi = (16.0f + 1.0f) / 29.0f;
+    for(int t : touched)
+        CPPUNIT_ASSERT(pnts[t].x >= lo && pnts[t].x <= hi);
+
+    // a single span is a cubic Bezier
+    for(i = 0; i < 4; i++)
+        for(j = 0; j < 4; j++)
+            for(k = 0; k < 4; k++)
+            {
+                p = cubicffd->getCP(i, j, k);
+                CPPUNIT_ASSERT(p == small.getCP(i, j, k));
+                p = cgp::Point(p.x * p.y + 0.1f * (float) k, p.y - 0.3f * p.z, p.z + 0.2f * (float) (i * j));
+                cubicffd->setCP(i, j, k, p);
+                small.setCP(i, j, k, p);
+            }
+    for(i = 0; i < n; i += 7)
+    {
+        p = pnts[i]; cubicffd->deform(p);
+        cgp::Point q = pnts[i]; small.deform(q);
+        CPPUNIT_ASSERT(p == q);
+    }
+    cerr << "FFD BSPLINE TEST PASSED" << endl << endl;
+}
+
 //#if 0 /* Disabled since it crashes the whole test suite */
 CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(TestFFD, TestSet::perBuild());
 //#endif
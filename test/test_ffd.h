@@ -12,6 +12,8 @@ class TestFFD : public CppUnit::TestFixture
     CPPUNIT_TEST(testCorners);
     CPPUNIT_TEST(testCenter);
     CPPUNIT_TEST(testIdentity);
+    CPPUNIT_TEST(testBatch);
+    CPPUNIT_TEST(testBSpline);
     CPPUNIT_TEST_SUITE_END();
 
 private:
@@ -39,6 +41,19 @@ public:
      * Place random points in an undeformed FFD lattice and make sure that they are return unchanged
      */
     void testIdentity();
+
+    /**
+     * Check that deforming points in batches matches deforming them one at a time, inside and outside distorted
+     * lattices of each degree
+     */
+    void testBatch();
+
+    /**
+     * Check that a large B-spline lattice is the identity until distorted, that corners track their control points,
+     * that moving a control point only affects points within its support, and that a 4x4x4 B-spline lattice
+     * deforms as a cubic Bezier lattice does
+     */
+    void testBSpline();
 };
 
 #endif /* !TILER_TEST_FFD_H */
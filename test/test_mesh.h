@@ -5,12 +5,33 @@
 #include <string>
 #include <cppunit/extensions/HelperMacros.h>
 #include "tesselate/mesh.h"
+#include "tesselate/weld.h"
 
 /// Test code for @ref Mesh
 class TestMesh : public CppUnit::TestFixture
 {
     CPPUNIT_TEST_SUITE(TestMesh);
 //    CPPUNIT_TEST(testMeshing);
+    CPPUNIT_TEST(testReadSTL);
+    CPPUNIT_TEST(testReadASCIISTL);
+    CPPUNIT_TEST(testReadSTLCached);
+    CPPUNIT_TEST(testWriteIndexed);
+    CPPUNIT_TEST(testArchive);
+    CPPUNIT_TEST(testLargeArchive);
+    CPPUNIT_TEST(testWeld);
+    CPPUNIT_TEST(testAdjacency);
+    CPPUNIT_TEST(testHalfEdge);
+    CPPUNIT_TEST(testManifoldReport);
+    CPPUNIT_TEST(testComponents);
+    CPPUNIT_TEST(testPointArray);
+    CPPUNIT_TEST(testInstance);
+    CPPUNIT_TEST(testSimplify);
+    CPPUNIT_TEST(testGreedyMesh);
+    CPPUNIT_TEST(testOptimizeLocality);
+    CPPUNIT_TEST(testNormals);
+    CPPUNIT_TEST(testIncrementalFFD);
+    CPPUNIT_TEST(testBVH);
+    CPPUNIT_TEST(testFlatHashMap);
     CPPUNIT_TEST_SUITE_END();
 
 private:
@@ -29,6 +50,121 @@ public:
      * @pre bunny.stl must be located in the project root directory
      */
     void testMeshing();
+
+    /**
+     * Round trip a tetrahedron through binary STL and check that truncated files are rejected
+     */
+    void testReadSTL();
+
+    /**
+     * Load a hand-written ASCII tetrahedron, check that malformed text is rejected and that binary files
+     * whose header starts with "solid" are still read as binary
+     */
+    void testReadASCIISTL();
+
+    /**
+     * Check that a sidecar cache is created on first load, reused while the STL is unchanged and ignored once it changes
+     */
+    void testReadSTLCached();
+
+    /**
+     * Export a welded tetrahedron as PLY and OBJ and check that vertices are stored once with their normals
+     */
+    void testWriteIndexed();
+
+    /**
+     * Round trip a tetrahedron through a compressed archive and check topology and quantisation error
+     */
+    void testArchive();
+
+    /**
+     * Archive a torus large enough for the parallel triangle ordering, with one thread and with several, and check
+     * that the files are identical and round trip
+     */
+    void testLargeArchive();
+
+    /**
+     * Weld points in exact and tolerance modes and check numbering by first occurrence against a brute force hash
+     */
+    void testWeld();
+
+    /**
+     * Check vertex to triangle and vertex to vertex adjacency against a brute force scan, on a tetrahedron and on a
+     * grid large enough to be built in parallel, and that it is rebuilt after the triangles change
+     */
+    void testAdjacency();
+
+    /**
+     * Check twin links, boundaries and vertex fans of the half-edge structure on closed, open and non-manifold
+     * tetrahedra, and that edge flips keep it consistent with a fresh build
+     */
+    void testHalfEdge();
+
+    /**
+     * Check that the manifold report lists every defect of each kind on the broken tetrahedra
+     */
+    void testManifoldReport();
+
+    /**
+     * Label thousands of interleaved tetrahedra and a stray triangle as components, extract one of them and
+     * remove the debris
+     */
+    void testComponents();
+
+    /**
+     * Check the structure-of-arrays transform, normalisation and bounding box kernels against per-point glm and
+     * cgp arithmetic, on a length that leaves a scalar remainder, and that boxFit still centres and scales the mesh
+     */
+    void testPointArray();
+
+    /**
+     * Place two instances of a shared tetrahedron and check containment through their placements, the geometry
+     * they generate and that the shared mesh is released with the last instance
+     */
+    void testInstance();
+
+    /**
+     * Decimate a closed torus to a target count serially and in slabs, checking it stays a single manifold, and
+     * reduce a flat grid under a zero error bound without moving its border
+     */
+    void testSimplify();
+
+    /**
+     * Mesh a stepped block with an internal cavity from its voxels and check the result is closed, encloses
+     * exactly the occupied voxels and uses far fewer triangles than one pair per exposed face
+     */
+    void testGreedyMesh();
+
+    /**
+     * Scramble the triangle and vertex order of a torus, then check that reordering restores good cache reuse,
+     * numbers vertices by first use and leaves the same surface
+     */
+    void testOptimizeLocality();
+
+    /**
+     * Check face normals of a voxel cube, that angle weighting points every corner normal along the diagonal, and
+     * that area weighting leans towards the larger of two triangles
+     */
+    void testNormals();
+
+    /**
+     * Check that moving control points of an applied lattice deforms a torus it half covers as a full deformation
+     * would, leaves the uncovered half alone and keeps face normals current
+     */
+    void testIncrementalFFD();
+
+    /**
+     * Check that containment through the triangle hierarchy counts the same ray crossings as testing every triangle,
+     * and that the hierarchy follows changes to the transformation and to the vertices
+     */
+    void testBVH();
+
+    /**
+     * Check the flat hash map and multimap against std::unordered_map and std::unordered_multimap under random
+     * inserts and erases by key and by iterator, through growth from an empty table, with both a mixing and a
+     * clustering hash
+     */
+    void testFlatHashMap();
 };
 
 #endif /* !TILER_TEST_MESH_H */
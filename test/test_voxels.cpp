@@ -4,9 +4,13 @@
 
 #include <test/testutil.h>
 #include "test_voxels.h"
+#include "tesselate/slabvox.h"
+#include "tesselate/mesh.h"
 #include <stdio.h>
 #include <cstdint>
 #include <sstream>
+#include <math.h>
+#include <fstream>
 #include <stdlib.h>
 #include <time.h>
 #include <cppunit/extensions/TestFactoryRegistry.h>
@@ -87,6 +91,151 @@ void TestVoxels::testVoxelRegistration()
     cerr << "VOXEL REGISTRATION PASSED" << endl << endl;
 }
 
+/**
+ * Signed distance of @a pnt from the plane through corners @a i, @a j, @a k of a tetrahedron, positive on the side of the fourth corner
+ */
+static float tetPlaneDist(const cgp::Point * corners, int i, int j, int k, int l, cgp::Point pnt)
+{
+    cgp::Vector u, v, n, w, opp;
+    u.diff(corners[i], corners[j]);
+    v.diff(corners[i], corners[k]);
+    n.cross(u, v);
+    n.normalize();
+    w.diff(corners[i], pnt);
+    opp.diff(corners[i], corners[l]);
+    return (n.dot(opp) > 0.0f) ? n.dot(w) : -n.dot(w);
+}
+
+// no face is axis aligned, so voxel centres on the bounding planes cannot lie on the surface
+static const cgp::Point tetcorners[4] = {cgp::Point(0.0f, 0.0f, 0.0f), cgp::Point(1.0f, 0.2f, 0.1f),
+                                         cgp::Point(0.3f, 1.0f, 0.2f), cgp::Point(0.2f, 0.3f, 1.0f)};
+static const int tetfaces[4][4] = {{0, 2, 1, 3}, {0, 1, 3, 2}, {0, 3, 2, 1}, {1, 2, 3, 0}}; // face corners, then the opposite corner
+
+/// Write the test tetrahedron as an ASCII STL file
+static void writeTetSTL(const std::string & filename)
+{
+    std::ofstream text(filename);
+    text << "solid tet\n";
+    for(int f = 0; f < 4; f++)
+    {
+        text << "facet normal 0 0 0\nouter loop\n";
+        for(int p = 0; p < 3; p++)
+            text << "vertex " << tetcorners[tetfaces[f][p]].x << " " << tetcorners[tetfaces[f][p]].y << " " << tetcorners[tetfaces[f][p]].z << "\n";
+        text << "endloop\nendfacet\n";
+    }
+    text << "endsolid tet\n";
+}
+
+void TestVoxels::testSlabVoxelise()
+{
+    TempDirectory tmpdir("test_voxels_tmp");
+    SlabVoxeliser slabber(3, 4); // tiny batches and slabs so that streaming and binning are exercised
+    Mesh tet;
+    int dx, dy, dz, x, y, z, f, occupied = 0, checked = 0, mismatched = 0;
+    const cgp::Point * corners = tetcorners;
+    const int (* faces)[4] = tetfaces;
+
+    writeTetSTL("test_voxels_tmp/tet_ascii.stl");
+    CPPUNIT_ASSERT(tet.readSTL("test_voxels_tmp/tet_ascii.stl"));
+    CPPUNIT_ASSERT(tet.writeSTL("test_voxels_tmp/tet.stl"));
+
+    CPPUNIT_ASSERT(slabber.voxelise("test_voxels_tmp/tet.stl", 0.05f, vox));
+    vox->getDim(dx, dy, dz);
+    CPPUNIT_ASSERT(dy >= 21 && dz >= 21);
+
+    // compare against an exact inside test, skipping voxel centres that lie on a face plane
+    for(x = 0; x < dx; x++)
+        for(y = 0; y < dy; y++)
+            for(z = 0; z < dz; z++)
+            {
+                cgp::Point pnt = vox->getVoxelPos(x, y, z);
+                bool inside = true, onplane = false;
+                for(f = 0; f < 4; f++)
+                {
+                    float dist = tetPlaneDist(corners, faces[f][0], faces[f][1], faces[f][2], faces[f][3], pnt);
+                    inside = inside && dist > 0.0f;
+                    onplane = onplane || fabs(dist) < 1e-4f;
+                }
+                if(vox->get(x, y, z))
+                    occupied++;
+                if(onplane)
+                    continue;
+                checked++;
+                if(inside != vox->get(x, y, z))
+                    mismatched++;
+            }
+
+    // the tetrahedron has volume 0.146, which is 1169 voxels
+    CPPUNIT_ASSERT(occupied > 1100 && occupied < 1250);
+    CPPUNIT_ASSERT(checked > dx * dy * dz - 100);
+    CPPUNIT_ASSERT_EQUAL(0, mismatched);
+    CPPUNIT_ASSERT(!slabber.voxelise("test_voxels_tmp/missing.stl", 0.05f, vox));
+    cerr << "SLAB VOXELISE TEST PASSED" << endl << endl;
+}
+
+void TestVoxels::testVoxelSpan()
+{
+    const int spans[5][2] = {{3, 9}, {30, 70}, {96, 128}, {-5, 1}, {120, 200}}; // the last two are clipped
+    int x, s;
+
+    vox->setDim(130, 2, 2);
+    vox->setFrame(cgp::Point(0.0f, 0.0f, 0.0f), cgp::Vector(1.0f, 1.0f, 1.0f));
+    vox->fill(false);
+    for(s = 0; s < 5; s++)
+        CPPUNIT_ASSERT(vox->setSpan(spans[s][0], spans[s][1], 1, 0));
+    CPPUNIT_ASSERT(vox->setSpan(50, 50, 0, 1)); // empty
+    CPPUNIT_ASSERT(!vox->setSpan(0, 4, 2, 0));
+
+    for(x = 0; x < 130; x++)
+    {
+        bool inside = false;
+        for(s = 0; s < 5; s++)
+            inside = inside || (x >= spans[s][0] && x < spans[s][1]);
+        CPPUNIT_ASSERT_EQUAL(inside, vox->get(x, 1, 0));
+        CPPUNIT_ASSERT(!vox->get(x, 0, 0));
+        CPPUNIT_ASSERT(!vox->get(x, 0, 1));
+    }
+    cerr << "VOXEL SPAN TEST PASSED" << endl << endl;
+}
+
+void TestVoxels::testMeshColumns()
+{
+    TempDirectory tmpdir("test_voxels_tmp");
+    Mesh tet;
+    std::vector<float> tris;
+    int dx, dy, dz, x, y, z, occupied = 0, mismatched = 0;
+
+    writeTetSTL("test_voxels_tmp/tet_ascii.stl");
+    CPPUNIT_ASSERT(tet.readSTL("test_voxels_tmp/tet_ascii.stl"));
+    tet.setScale(8.0f);
+    tet.setRotations(0.3f, -0.2f, 0.5f);
+    tet.setTranslation(cgp::Vector(-3.0f, -2.5f, -3.5f));
+
+    vox->setDim(64, 36, 36);
+    vox->setFrame(cgp::Point(-9.0f, -9.0f, -9.0f), cgp::Vector(18.0f, 18.0f, 18.0f));
+    vox->fill(false);
+    tet.getWorldTriangles(tris);
+    CPPUNIT_ASSERT_EQUAL(4 * 9, (int) tris.size());
+    vox->getDim(dx, dy, dz);
+    scanConvertTriangles(tris, vox, 0, dz);
+
+    for(x = 0; x < dx; x++)
+        for(y = 0; y < dy; y++)
+            for(z = 0; z < dz; z++)
+            {
+                bool inside = tet.pointContainment(vox->getVoxelPos(x, y, z));
+                if(vox->get(x, y, z))
+                    occupied++;
+                if(inside != vox->get(x, y, z))
+                    mismatched++;
+            }
+
+    // the tetrahedron has volume 0.146 * 8^3 = 75, which is about 990 voxels at this spacing
+    CPPUNIT_ASSERT(occupied > 900 && occupied < 1080);
+    CPPUNIT_ASSERT_EQUAL(0, mismatched);
+    cerr << "MESH COLUMNS TEST PASSED" << endl << endl;
+}
+
 //#if 0 /* Disabled since it crashes the whole test suite */
 CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(TestVoxels, TestSet::perBuild());
 //#endif
@@ -12,6 +12,9 @@ class TestVoxels : public CppUnit::TestFixture
     CPPUNIT_TEST_SUITE(TestVoxels);
     CPPUNIT_TEST(testVoxelSet);
     CPPUNIT_TEST(testVoxelRegistration);
+    CPPUNIT_TEST(testSlabVoxelise);
+    CPPUNIT_TEST(testVoxelSpan);
+    CPPUNIT_TEST(testMeshColumns);
     CPPUNIT_TEST_SUITE_END();
 
 private:
@@ -34,6 +37,22 @@ public:
      * Check correspondence of voxel elements to 3D position
      */
     void testVoxelRegistration();
+
+    /**
+     * Voxelise a tetrahedron out of core through many small slabs and batches and compare against mesh point containment
+     */
+    void testSlabVoxelise();
+
+    /**
+     * Set runs of voxels within a word, across words and clipped at the ends of a row, and check them bit by bit
+     */
+    void testVoxelSpan();
+
+    /**
+     * Voxelise a placed tetrahedron mesh by column parity, as the csg walk does, and compare against mesh point
+     * containment at every voxel centre
+     */
+    void testMeshColumns();
 };
 
 #endif /* !TILER_TEST_VOXEL_H */